@@ -0,0 +1,139 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+#include "collector.h"
+
+namespace fancontrol {
+
+Collector::Collector(
+    Transport& bus, std::vector<uint8_t> addrs, Options opts,
+    CollectorOptions copts
+)
+    : poller_(bus, std::move(addrs), opts), copts_(std::move(copts)),
+      boards_(new Board_[poller_.addrs().size()]())
+{
+}
+
+std::string Collector::path(const std::string& dir, uint8_t addr)
+{
+    char name[sizeof("board-00.ring")];
+
+    (void)snprintf(name, sizeof(name), "board-%02x.ring", addr);
+
+    return dir + "/" + name;
+}
+
+int Collector::open()
+{
+    for (size_t i = 0; i < poller_.addrs().size(); i++) {
+        uint8_t addr = poller_.addrs()[i];
+
+        int ret =
+            boards_[i].ring.create(path(copts_.dir, addr), copts_.capacity);
+        if (ret != 0) {
+            return ret;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Temperature of the zone of fan @p fan of board @p b, in 0.1 C
+ */
+int16_t Collector::temp_(const Board_& b, unsigned fan) const
+{
+    if (!b.fans_valid || b.fans.zone[fan] >= ZONE_COUNT) {
+        return SAMPLE_NO_TEMP;
+    }
+
+    int32_t temp = b.zones.temp[b.fans.zone[fan]];
+
+    if (temp == NO_TEMP) {
+        return SAMPLE_NO_TEMP;
+    }
+
+    temp /= 100;
+
+    if (temp <= INT16_MIN) {
+        return INT16_MIN + 1;
+    }
+
+    return temp > INT16_MAX ? INT16_MAX : temp;
+}
+
+size_t Collector::cycle()
+{
+    size_t count = poller_.addrs().size();
+    size_t appended = 0;
+
+    if (cycles_++ % copts_.fans_every == 0) {
+        (void)poller_.query(Cmd::FANS, {}, FANS_SIZE, replies_);
+
+        for (size_t i = 0; i < count; i++) {
+            if (replies_[i].status == 0) {
+                decode(replies_[i].data.data(), boards_[i].fans);
+                boards_[i].fans_valid = true;
+            }
+        }
+    }
+
+    /* Boards that miss one of these keep the values from the last cycle,
+     * except for temperatures, which are then unknown */
+    (void)poller_.query(Cmd::FAULTS, {}, FAULTS_SIZE, replies_);
+
+    for (size_t i = 0; i < count; i++) {
+        if (replies_[i].status == 0) {
+            decode(replies_[i].data.data(), boards_[i].faults);
+        }
+    }
+
+    (void)poller_.query(Cmd::ZONES, {}, ZONES_SIZE, replies_);
+
+    for (size_t i = 0; i < count; i++) {
+        if (replies_[i].status == 0) {
+            decode(replies_[i].data.data(), boards_[i].zones);
+        } else {
+            std::fill_n(boards_[i].zones.temp, ZONE_COUNT, NO_TEMP);
+        }
+    }
+
+    /* Speeds last, so they are as fresh as possible when stamped */
+    (void)poller_.query(Cmd::REPORT, {}, REPORT_SIZE, replies_);
+
+    auto since_epoch = std::chrono::system_clock::now().time_since_epoch();
+    uint64_t now =
+        std::chrono::duration_cast<std::chrono::milliseconds>(since_epoch)
+            .count();
+
+    for (size_t i = 0; i < count; i++) {
+        Board_& b = boards_[i];
+        Report report;
+
+        if (replies_[i].status != 0) {
+            continue;
+        }
+
+        decode(replies_[i].data.data(), report);
+
+        for (unsigned f = 0; f < FAN_COUNT; f++) {
+            Sample& s = b.samples[f];
+
+            s.time_ms = now;
+            s.rpm = report.rpm[f];
+            s.temp = temp_(b, f);
+            s.board = poller_.addrs()[i];
+            s.fan = f;
+            s.duty = b.fans_valid ? b.fans.duty[f] : SAMPLE_NO_DUTY;
+            s.faults = b.faults.flags[f];
+        }
+
+        b.ring.append(b.samples, FAN_COUNT);
+        appended += FAN_COUNT;
+    }
+
+    return appended;
+}
+
+} // namespace fancontrol
@@ -0,0 +1,79 @@
+#ifndef COLLECTOR_H__
+#define COLLECTOR_H__
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "fancontrol.h"
+#include "ringfile.h"
+
+namespace fancontrol {
+
+struct CollectorOptions {
+    /* Directory holding the ring file of every board */
+    std::string dir = ".";
+    /* Samples held by a newly created ring file */
+    uint32_t capacity = 1 << 20;
+    /* Duty cycles and zone assignments change rarely, and are only read every
+     * this many cycles */
+    unsigned fans_every = 10;
+};
+
+/**
+ * @brief Polls a set of boards and appends one sample per fan of every board
+ * to the board's ring file. Once the ring files are open, collecting does
+ * not allocate.
+ */
+class Collector {
+public:
+    Collector(
+        Transport& bus, std::vector<uint8_t> addrs, Options opts = {},
+        CollectorOptions copts = {}
+    );
+
+    /**
+     * @brief Create or open the ring file of every board
+     */
+    int open();
+
+    /**
+     * @brief Poll every board once and append its samples
+     *
+     * A cycle issues three commands, and a fourth every fans_every cycles,
+     * each followed by the settle time of the options. On real boards that
+     * settle has to cover the 500 ms between two commands handled by
+     * cmd_tick, so a cycle takes about 1.7 s, and one bus of 112 boards
+     * yields about 540 samples per second.
+     *
+     * @return size_t Number of samples appended
+     */
+    size_t cycle();
+
+    /**
+     * @brief Path of the ring file of board @p addr in directory @p dir
+     */
+    static std::string path(const std::string& dir, uint8_t addr);
+
+private:
+    struct Board_ {
+        RingFile ring;
+        Fans fans;
+        bool fans_valid;
+        Faults faults;
+        Zones zones;
+        Sample samples[FAN_COUNT];
+    };
+
+    int16_t temp_(const Board_& b, unsigned fan) const;
+
+    Poller poller_;
+    CollectorOptions copts_;
+    std::unique_ptr<Board_[]> boards_;
+    std::vector<Reply> replies_;
+    unsigned cycles_ = 0;
+};
+
+} // namespace fancontrol
+
+#endif /* COLLECTOR_H__ */
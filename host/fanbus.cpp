@@ -0,0 +1,356 @@
+/* Client for fancontrol boards sharing an RS-485 bus in RS-485 console mode
+ * (see src/rs485.h), which needs firmware built with RS485_ENABLE.
+ *
+ * Build from the repository root with:
+ *
+ *   g++ -std=c++17 -O2 -Wall -Ihost -o fanbus host/fanbus.cpp \
+ *       host/fancontrol.cpp
+ *   ./fanbus [-d <device>] [-b <baud>] [-t <timeout ms>] poll <ids> [<rounds>]
+ *   ./fanbus [-d <device>] [-b <baud>] [-t <timeout ms>] cmd <id> <line>
+ *
+ * poll sends the binary status query to every node ID in the list, such as
+ * 1-20,30, one after the other, and prints the speeds of every board that
+ * replied, reporting the rate achieved. cmd sends one shell line to a board
+ * and prints its reply. The bus defaults to /dev/ttyUSB0 at 9600 baud.
+ */
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "fancontrol.h"
+
+using namespace fancontrol;
+
+/* Framing bytes, as in src/rs485.h */
+#define QUERY_ (0x01)
+#define REPLY_ (0x02)
+#define EOT_ (0x04)
+
+/* Size of `struct rs485_status` */
+#define STATUS_SIZE_ (2 * FAN_COUNT + 2 * FAN_COUNT + 4 * ZONE_COUNT + 3)
+
+struct Status_ {
+    uint16_t rpm[FAN_COUNT];
+    uint8_t duty[FAN_COUNT];
+    uint8_t faults[FAN_COUNT];
+    int32_t temp[ZONE_COUNT];
+    uint8_t alert_events;
+    uint16_t alert_fans;
+};
+
+static int fd_ = -1;
+static int timeout_ms_ = 200;
+
+static void usage_(const char* name)
+{
+    (void)fprintf(
+        stderr,
+        "Usage: %s [-d <device>] [-b <baud>] [-t <timeout ms>] "
+        "poll <ids> [<rounds>] | cmd <id> <line>\n",
+        name
+    );
+    exit(2);
+}
+
+static unsigned long number_(const char* arg, unsigned long max)
+{
+    char* end;
+    unsigned long v = strtoul(arg, &end, 0);
+
+    if (*arg == '\0' || *end != '\0' || v > max) {
+        (void)fprintf(stderr, "Invalid number: %s\n", arg);
+        exit(2);
+    }
+
+    return v;
+}
+
+static speed_t speed_(unsigned long baud)
+{
+    switch (baud) {
+    case 9600:
+        return B9600;
+    case 19200:
+        return B19200;
+    case 38400:
+        return B38400;
+    case 57600:
+        return B57600;
+    case 115200:
+        return B115200;
+    default:
+        (void)fprintf(stderr, "Unsupported baud rate: %lu\n", baud);
+        exit(2);
+    }
+}
+
+static int open_(const char* path, unsigned long baud)
+{
+    struct termios tio;
+
+    fd_ = open(path, O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (fd_ < 0 || tcgetattr(fd_, &tio) != 0) {
+        return -errno;
+    }
+
+    cfmakeraw(&tio);
+    (void)cfsetispeed(&tio, speed_(baud));
+    (void)cfsetospeed(&tio, speed_(baud));
+    tio.c_cflag |= CLOCAL | CREAD;
+
+    if (tcsetattr(fd_, TCSANOW, &tio) != 0) {
+        return -errno;
+    }
+
+    return tcflush(fd_, TCIOFLUSH) == 0 ? 0 : -errno;
+}
+
+static int write_(const void* data, size_t size)
+{
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+
+    while (size > 0) {
+        ssize_t n = write(fd_, p, size);
+        if (n < 0) {
+            return -errno;
+        }
+
+        p += n;
+        size -= n;
+    }
+
+    return tcdrain(fd_) == 0 ? 0 : -errno;
+}
+
+/**
+ * @brief Read one byte, waiting at most until @p deadline
+ *
+ * @return int The byte, or a negative errno value
+ * @retval -ETIMEDOUT Nothing arrived in time
+ */
+static int read_(std::chrono::steady_clock::time_point deadline)
+{
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+        deadline - std::chrono::steady_clock::now()
+    );
+    struct pollfd pfd = {fd_, POLLIN, 0};
+    uint8_t c;
+
+    if (left.count() <= 0 || poll(&pfd, 1, left.count()) == 0) {
+        return -ETIMEDOUT;
+    }
+
+    ssize_t n = read(fd_, &c, 1);
+    if (n < 0) {
+        return -errno;
+    } else if (n == 0) {
+        return -EIO;
+    }
+
+    return c;
+}
+
+static uint8_t crc8_(uint8_t crc, const uint8_t* data, size_t size)
+{
+    while (size--) {
+        crc ^= *data++;
+
+        for (unsigned i = 0; i < 8; i++) {
+            crc = crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1;
+        }
+    }
+
+    return crc;
+}
+
+/**
+ * @brief Query the status of node @p id. Bytes ahead of the reply, such as
+ * the query echoed by the transceiver, are skipped.
+ *
+ * @return int
+ * @retval -ETIMEDOUT No complete reply in time
+ * @retval -EBADMSG The reply was corrupted
+ */
+static int query_(uint8_t id, Status_& out)
+{
+    const uint8_t query[] = {QUERY_, id, (uint8_t)~id};
+    uint8_t frame[3 + STATUS_SIZE_ + 1];
+    size_t len = 0;
+
+    int ret = write_(query, sizeof(query));
+    if (ret != 0) {
+        return ret;
+    }
+
+    auto deadline = std::chrono::steady_clock::now() +
+                    std::chrono::milliseconds(timeout_ms_);
+
+    while (len < sizeof(frame)) {
+        int c = read_(deadline);
+        if (c < 0) {
+            return c;
+        }
+
+        frame[len++] = c;
+
+        /* Resynchronize until the head of the expected reply is seen */
+        if ((len == 1 && c != REPLY_) || (len == 2 && c != id) ||
+            (len == 3 && c != STATUS_SIZE_)) {
+            len = c == REPLY_ ? 1 : 0;
+            frame[0] = c;
+        }
+    }
+
+    if (crc8_(0, frame, sizeof(frame) - 1) != frame[sizeof(frame) - 1]) {
+        return -EBADMSG;
+    }
+
+    const uint8_t* p = frame + 3;
+
+    memcpy(out.rpm, p, sizeof(out.rpm));
+    p += sizeof(out.rpm);
+    memcpy(out.duty, p, sizeof(out.duty));
+    p += sizeof(out.duty);
+    memcpy(out.faults, p, sizeof(out.faults));
+    p += sizeof(out.faults);
+    memcpy(out.temp, p, sizeof(out.temp));
+    p += sizeof(out.temp);
+    out.alert_events = *p++;
+    memcpy(&out.alert_fans, p, sizeof(out.alert_fans));
+
+    return 0;
+}
+
+static int poll_(char** args, int count)
+{
+    std::vector<uint8_t> ids;
+    unsigned long rounds = count > 1 ? number_(args[1], ULONG_MAX) : 1;
+    unsigned long ok = 0;
+    unsigned long failed = 0;
+
+    if (parse_addrs(args[0], ids) != 0) {
+        (void)fprintf(stderr, "Invalid node ID list: %s\n", args[0]);
+        exit(2);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (unsigned long n = 0; n < rounds; n++) {
+        for (uint8_t id : ids) {
+            Status_ s;
+            int ret = query_(id, s);
+
+            if (ret == -ETIMEDOUT || ret == -EBADMSG) {
+                (void)printf("%3u: %s\n", id, strerror(-ret));
+                failed++;
+                continue;
+            } else if (ret != 0) {
+                return ret;
+            }
+
+            (void)printf("%3u:", id);
+            for (unsigned i = 0; i < FAN_COUNT; i++) {
+                (void)printf(" %5u%s", s.rpm[i], s.faults[i] ? "!" : "");
+            }
+            (void)printf(" RPM\n");
+            ok++;
+        }
+    }
+
+    std::chrono::duration<double> took =
+        std::chrono::steady_clock::now() - start;
+
+    (void)fprintf(
+        stderr, "%lu replies, %lu failed in %.3f s, %.1f boards/s\n", ok,
+        failed, took.count(), (ok + failed) / took.count()
+    );
+
+    return 0;
+}
+
+static int cmd_(uint8_t id, const char* line)
+{
+    std::string frame = "@" + std::to_string(id) + " " + line + "\r";
+
+    int ret = write_(frame.data(), frame.size());
+    if (ret != 0) {
+        return ret;
+    }
+
+    auto deadline = std::chrono::steady_clock::now() +
+                    std::chrono::milliseconds(timeout_ms_);
+
+    for (;;) {
+        int c = read_(deadline);
+        if (c < 0) {
+            return c;
+        } else if (c == EOT_) {
+            return 0;
+        }
+
+        (void)putchar(c);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const char* device = "/dev/ttyUSB0";
+    unsigned long baud = 9600;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:b:t:")) != -1) {
+        switch (opt) {
+        case 'd':
+            device = optarg;
+            break;
+        case 'b':
+            baud = number_(optarg, ULONG_MAX);
+            break;
+        case 't':
+            timeout_ms_ = number_(optarg, 60000);
+            break;
+        default:
+            usage_(argv[0]);
+        }
+    }
+
+    if (optind + 2 > argc) {
+        usage_(argv[0]);
+    }
+
+    std::string cmd = argv[optind];
+    char** args = argv + optind + 1;
+    int count = argc - optind - 1;
+    int ret;
+
+    ret = open_(device, baud);
+    if (ret != 0) {
+        (void)fprintf(stderr, "%s: %s\n", device, strerror(-ret));
+        return 1;
+    }
+
+    if (cmd == "poll") {
+        ret = poll_(args, count);
+    } else if (cmd == "cmd" && count >= 2) {
+        ret = cmd_(number_(args[0], 0x7F), args[1]);
+    } else {
+        usage_(argv[0]);
+    }
+
+    if (ret != 0) {
+        (void)fprintf(stderr, "%s: %s\n", cmd.c_str(), strerror(-ret));
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,213 @@
+/* Collector daemon, appending the state of every fan of a set of boards to
+ * per-board ring files at a fixed cadence. Read them back with fanquery.
+ *
+ * Build from the repository root with:
+ *
+ *   g++ -std=c++17 -O2 -Wall -Ihost -o fancollect host/fancollect.cpp \
+ *       host/collector.cpp host/fancontrol.cpp host/i2cdev.cpp \
+ *       host/mock.cpp host/ringfile.cpp
+ *   ./fancollect [-d <device>] [-m <boards>] [-D <dir>] [-c <capacity>]
+ *       [-i <interval ms>] [-n <cycles>] [-s <settle ms>] [-o <offset>]
+ *       <addrs>
+ *
+ * Every cycle reads the faults, zone temperatures and speeds of every board
+ * in the address list (such as 8-40,50), and every 10th cycle their duty
+ * cycles and zone assignments. A cycle takes at least one settle time per
+ * command, and a cycle that overruns the interval starts the next one right
+ * away. It runs until interrupted, or for the given number of cycles, and
+ * then reports the samples written.
+ *
+ * The settle time is bound by the firmware, which handles at most one
+ * command every 500 ms, so a cycle on real boards takes about 1.7 s
+ * whatever the interval. That caps one bus at about 540 samples per second
+ * with all 112 addresses in use, and at about 5 per second per board.
+ *
+ * With -m the boards are mocks at addresses 8 and up, whose speeds wander a
+ * little every cycle, and which reply without delay.
+ */
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "collector.h"
+#include "i2cdev.h"
+#include "mock.h"
+
+using namespace fancontrol;
+
+#define MOCK_FIRST_ (8)
+
+static volatile sig_atomic_t stop_;
+
+static void on_signal_(int sig)
+{
+    (void)sig;
+    stop_ = 1;
+}
+
+static void usage_(const char* name)
+{
+    (void)fprintf(
+        stderr,
+        "Usage: %s [-d <device>] [-m <boards>] [-D <dir>] [-c <capacity>] "
+        "[-i <interval ms>] [-n <cycles>] [-s <settle ms>] [-o <offset>] "
+        "<addrs>\n",
+        name
+    );
+    exit(2);
+}
+
+static unsigned long number_(const char* arg, unsigned long max)
+{
+    char* end;
+    unsigned long v = strtoul(arg, &end, 0);
+
+    if (*arg == '\0' || *end != '\0' || v > max) {
+        (void)fprintf(stderr, "Invalid number: %s\n", arg);
+        exit(2);
+    }
+
+    return v;
+}
+
+/**
+ * @brief Move the speeds of the mock boards a little, so the samples are not
+ * all the same
+ */
+static void wander_(MockBus& bus, unsigned long boards, unsigned long cycle)
+{
+    for (unsigned long i = 0; i < boards; i++) {
+        MockBoard* b = bus.board(MOCK_FIRST_ + i);
+
+        for (unsigned f = 0; f < FAN_COUNT; f++) {
+            b->report.rpm[f] = 1000 + 10 * i + f + (cycle * (f + 1)) % 50;
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const char* device = "/dev/i2c-1";
+    unsigned long mock = 0;
+    unsigned long interval_ms = 1000;
+    unsigned long cycles = 0;
+    Options opts;
+    CollectorOptions copts;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:m:D:c:i:n:s:o:")) != -1) {
+        switch (opt) {
+        case 'd':
+            device = optarg;
+            break;
+        case 'm':
+            mock = number_(optarg, 0x78 - MOCK_FIRST_);
+            break;
+        case 'D':
+            copts.dir = optarg;
+            break;
+        case 'c':
+            copts.capacity = number_(optarg, UINT32_MAX);
+            break;
+        case 'i':
+            interval_ms = number_(optarg, 86400000);
+            break;
+        case 'n':
+            cycles = number_(optarg, ULONG_MAX);
+            break;
+        case 's':
+            opts.settle = std::chrono::milliseconds(number_(optarg, 60000));
+            break;
+        case 'o':
+            opts.reply_offset = number_(optarg, 16);
+            break;
+        default:
+            usage_(argv[0]);
+        }
+    }
+
+    std::vector<uint8_t> addrs;
+
+    if (optind + 1 != argc || parse_addrs(argv[optind], addrs) != 0) {
+        usage_(argv[0]);
+    }
+
+    I2cDev dev;
+    MockBus mock_bus(opts.reply_offset);
+    Transport* bus = &dev;
+
+    if (mock > 0) {
+        for (unsigned long i = 0; i < mock; i++) {
+            MockBoard& b = mock_bus.add(MOCK_FIRST_ + i);
+
+            std::fill_n(b.duty, FAN_COUNT, 40);
+            std::fill_n(b.zones.temp, ZONE_COUNT, 30000 + 100 * i);
+        }
+
+        opts.settle = std::chrono::microseconds(0);
+        bus = &mock_bus;
+    } else {
+        int ret = dev.open(device);
+        if (ret != 0) {
+            (void)fprintf(stderr, "%s: %s\n", device, strerror(-ret));
+            return 1;
+        }
+    }
+
+    Collector collector(*bus, addrs, opts, copts);
+
+    int ret = collector.open();
+    if (ret != 0) {
+        (void)fprintf(stderr, "%s: %s\n", copts.dir.c_str(), strerror(-ret));
+        return 1;
+    }
+
+    (void)signal(SIGINT, on_signal_);
+    (void)signal(SIGTERM, on_signal_);
+
+    auto interval = std::chrono::milliseconds(interval_ms);
+    auto start = std::chrono::steady_clock::now();
+    auto next = start;
+    unsigned long n = 0;
+    unsigned long overruns = 0;
+    unsigned long long samples = 0;
+
+    while (!stop_ && (cycles == 0 || n < cycles)) {
+        if (mock > 0) {
+            wander_(mock_bus, mock, n);
+        }
+
+        samples += collector.cycle();
+        n++;
+
+        next += interval;
+
+        auto now = std::chrono::steady_clock::now();
+        if (interval_ms > 0 && now > next) {
+            /* Skip the slots that were missed rather than bursting */
+            overruns++;
+            next = now;
+            continue;
+        }
+
+        std::this_thread::sleep_until(next);
+    }
+
+    std::chrono::duration<double> took =
+        std::chrono::steady_clock::now() - start;
+
+    (void)fprintf(
+        stderr, "%lu cycles, %lu overran, %llu samples in %.3f s, %.1f/s\n",
+        n, overruns, samples, took.count(), samples / took.count()
+    );
+
+    return 0;
+}
@@ -0,0 +1,510 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <utility>
+
+#include "fancontrol.h"
+
+namespace fancontrol {
+
+/* The board is little endian, and its replies are packed */
+static uint16_t le16_(const uint8_t*& p)
+{
+    uint16_t v = p[0] | (p[1] << 8);
+
+    p += 2;
+    return v;
+}
+
+static uint32_t le32_(const uint8_t*& p)
+{
+    uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+
+    p += 4;
+    return v;
+}
+
+void decode(const uint8_t* buf, Report& out)
+{
+    for (unsigned i = 0; i < FAN_COUNT; i++) {
+        out.rpm[i] = le16_(buf);
+    }
+}
+
+void decode(const uint8_t* buf, Faults& out)
+{
+    for (unsigned i = 0; i < FAN_COUNT; i++) {
+        out.flags[i] = *buf++;
+    }
+
+    for (unsigned i = 0; i < FAN_COUNT; i++) {
+        out.stalls[i] = le16_(buf);
+        out.underspeeds[i] = le16_(buf);
+        out.recoveries[i] = le16_(buf);
+    }
+}
+
+void decode(const uint8_t* buf, Alert& out)
+{
+    out.events = *buf++;
+    out.fans = le16_(buf);
+}
+
+void decode(const uint8_t* buf, Zones& out)
+{
+    for (unsigned i = 0; i < ZONE_COUNT; i++) {
+        out.temp[i] = (int32_t)le32_(buf);
+    }
+
+    for (unsigned i = 0; i < ZONE_COUNT; i++) {
+        out.age[i] = le16_(buf);
+    }
+}
+
+void decode(const uint8_t* buf, FanStats& out)
+{
+    out.min = le16_(buf);
+    out.max = le16_(buf);
+    out.mean = le16_(buf);
+    out.variance = le32_(buf);
+    out.captures = le32_(buf);
+    out.stalls = le16_(buf);
+    out.rotation_ms = le32_(buf);
+
+    for (unsigned i = 0; i < FANSTATS_BUCKETS; i++) {
+        out.hist[i] = le16_(buf);
+    }
+}
+
+void decode(const uint8_t* buf, Snapshot& out)
+{
+    out.stamp = le32_(buf);
+    decode(buf, out.stats);
+}
+
+void decode(const uint8_t* buf, HistoryChunk& out)
+{
+    out.offset = le32_(buf);
+
+    uint8_t len = *buf++;
+
+    if (len > HISTORY_CHUNK) {
+        len = HISTORY_CHUNK;
+    }
+
+    out.data.assign(buf, buf + len);
+    out.next = out.offset + len;
+}
+
+void decode(const uint8_t* buf, Fans& out)
+{
+    std::copy(buf, buf + FAN_COUNT, out.duty);
+    std::copy(buf + FAN_COUNT, buf + 2 * FAN_COUNT, out.zone);
+}
+
+/**
+ * @brief Parse the address at @p p, advancing @p p past it
+ */
+static int addr_(const char*& p, unsigned long& out)
+{
+    char* end;
+
+    if (*p < '0' || *p > '9') {
+        return -EINVAL;
+    }
+
+    out = strtoul(p, &end, 0);
+    p = end;
+
+    return out > 0x7F ? -EINVAL : 0;
+}
+
+int parse_addrs(const char* list, std::vector<uint8_t>& out)
+{
+    const char* p = list;
+
+    out.clear();
+
+    for (;;) {
+        unsigned long first;
+        unsigned long last;
+
+        if (addr_(p, first) != 0) {
+            return -EINVAL;
+        }
+
+        last = first;
+
+        if (*p == '-') {
+            p++;
+
+            if (addr_(p, last) != 0 || last < first) {
+                return -EINVAL;
+            }
+        }
+
+        for (unsigned long a = first; a <= last; a++) {
+            out.push_back(a);
+        }
+
+        if (*p == '\0') {
+            return 0;
+        }
+
+        if (*p++ != ',') {
+            return -EINVAL;
+        }
+    }
+}
+
+void decode(const uint8_t* buf, EventChunk& out)
+{
+    uint8_t count = std::min<size_t>(buf[0], LOG_CHUNK);
+
+    out.remaining = buf[1];
+    buf += 2;
+    out.dropped = le16_(buf);
+    out.events.resize(count);
+
+    for (Event& e : out.events) {
+        e.stamp = le32_(buf);
+        e.sys = (EventSys)*buf++;
+        e.code = (EventCode)*buf++;
+        e.a = le16_(buf);
+        e.b = le16_(buf);
+        e.repeats = le16_(buf);
+    }
+}
+
+Poller::Poller(Transport& bus, std::vector<uint8_t> addrs, Options opts)
+    : bus_(bus), addrs_(std::move(addrs)), opts_(opts)
+{
+}
+
+/**
+ * @brief Run @p msgs in batches as large as the bus allows, setting the
+ * status of each message in @p status. If a batch fails and @p retry is set,
+ * its messages are run again one at a time to find the ones that failed.
+ * This may repeat messages that made it through before the failure, so it
+ * must only be used for writes of commands that the board drains together.
+ */
+int Poller::run_(std::vector<Msg>& msgs, std::vector<int>& status, bool retry)
+{
+    size_t batch = bus_.max_batch();
+
+    status.assign(msgs.size(), 0);
+
+    for (size_t i = 0; i < msgs.size(); i += batch) {
+        size_t count = std::min(batch, msgs.size() - i);
+        int ret = bus_.transfer(&msgs[i], count);
+
+        if (ret == 0) {
+            continue;
+        }
+
+        for (size_t j = i; j < i + count; j++) {
+            status[j] = retry ? bus_.transfer(&msgs[j], 1) : ret;
+        }
+    }
+
+    return 0;
+}
+
+int Poller::query(
+    Cmd cmd, const std::vector<uint8_t>& args, size_t reply_len,
+    std::vector<Reply>& out
+)
+{
+    if (args.size() > UINT8_MAX) {
+        return -EINVAL;
+    }
+
+    packet_.assign({(uint8_t)cmd, (uint8_t)args.size()});
+    packet_.insert(packet_.end(), args.begin(), args.end());
+
+    out.resize(addrs_.size());
+    msgs_.clear();
+
+    for (size_t i = 0; i < addrs_.size(); i++) {
+        out[i].addr = addrs_[i];
+        msgs_.push_back({addrs_[i], false, packet_.data(),
+                         (uint16_t)packet_.size()});
+    }
+
+    (void)run_(msgs_, status_, true);
+    auto sent = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < out.size(); i++) {
+        out[i].status = status_[i];
+        out[i].data.assign(opts_.reply_offset + reply_len, 0);
+    }
+
+    if (reply_len == 0) {
+        return 0;
+    }
+
+    /* Only read back from the boards that took the command */
+    index_.clear();
+    msgs_.clear();
+
+    for (size_t i = 0; i < out.size(); i++) {
+        if (out[i].status != 0) {
+            continue;
+        }
+
+        index_.push_back(i);
+        msgs_.push_back({out[i].addr, true, out[i].data.data(),
+                         (uint16_t)out[i].data.size()});
+    }
+
+    std::this_thread::sleep_until(sent + opts_.settle);
+
+    /* A read that fails is not repeated, as part of the reply may already
+     * have been taken from the board */
+    (void)run_(msgs_, status_, false);
+
+    for (size_t i = 0; i < index_.size(); i++) {
+        Reply& r = out[index_[i]];
+
+        r.status = status_[i];
+        r.data.erase(r.data.begin(), r.data.begin() + opts_.reply_offset);
+    }
+
+    for (Reply& r : out) {
+        if (r.status != 0) {
+            r.data.clear();
+        }
+    }
+
+    return 0;
+}
+
+int Poller::poll(std::vector<Report>& out, std::vector<int>& status)
+{
+    int ret = query(Cmd::REPORT, {}, REPORT_SIZE, replies_);
+
+    if (ret != 0) {
+        return ret;
+    }
+
+    out.resize(replies_.size());
+    status.resize(replies_.size());
+
+    for (size_t i = 0; i < replies_.size(); i++) {
+        status[i] = replies_[i].status;
+
+        if (status[i] == 0) {
+            decode(replies_[i].data.data(), out[i]);
+        }
+    }
+
+    return 0;
+}
+
+Board::Board(Transport& bus, uint8_t addr, Options opts)
+    : bus_(bus), addr_(addr), opts_(opts)
+{
+}
+
+int Board::send_(Cmd cmd, const uint8_t* args, uint8_t len)
+{
+    uint8_t packet[2 + UINT8_MAX] = {(uint8_t)cmd, len};
+    Msg msg = {addr_, false, packet, (uint16_t)(2 + len)};
+
+    if (len > 0) {
+        memcpy(packet + 2, args, len);
+    }
+
+    return bus_.transfer(&msg, 1);
+}
+
+int Board::query_(
+    Cmd cmd, const uint8_t* args, uint8_t len, uint8_t* reply,
+    size_t reply_len
+)
+{
+    std::vector<uint8_t> buf(opts_.reply_offset + reply_len);
+    Msg msg = {addr_, true, buf.data(), (uint16_t)buf.size()};
+
+    if (addr_ == BROADCAST) {
+        return -EINVAL;
+    }
+
+    int ret = send_(cmd, args, len);
+    if (ret != 0) {
+        return ret;
+    }
+
+    std::this_thread::sleep_for(opts_.settle);
+
+    ret = bus_.transfer(&msg, 1);
+    if (ret != 0) {
+        return ret;
+    }
+
+    memcpy(reply, buf.data() + opts_.reply_offset, reply_len);
+
+    return 0;
+}
+
+int Board::hello()
+{
+    uint8_t reply[HELLO_SIZE];
+
+    int ret = query_(Cmd::HELLO, nullptr, 0, reply, sizeof(reply));
+    if (ret != 0) {
+        return ret;
+    }
+
+    return memcmp(reply, "hey", sizeof(reply)) == 0 ? 0 : -EPROTO;
+}
+
+int Board::report(Report& out)
+{
+    uint8_t reply[REPORT_SIZE];
+
+    int ret = query_(Cmd::REPORT, nullptr, 0, reply, sizeof(reply));
+    if (ret == 0) {
+        decode(reply, out);
+    }
+
+    return ret;
+}
+
+int Board::faults(Faults& out)
+{
+    uint8_t reply[FAULTS_SIZE];
+
+    int ret = query_(Cmd::FAULTS, nullptr, 0, reply, sizeof(reply));
+    if (ret == 0) {
+        decode(reply, out);
+    }
+
+    return ret;
+}
+
+int Board::alert(Alert& out)
+{
+    uint8_t reply[ALERT_SIZE];
+
+    int ret = query_(Cmd::ALERT, nullptr, 0, reply, sizeof(reply));
+    if (ret == 0) {
+        decode(reply, out);
+    }
+
+    return ret;
+}
+
+int Board::zones(Zones& out)
+{
+    uint8_t reply[ZONES_SIZE];
+
+    int ret = query_(Cmd::ZONES, nullptr, 0, reply, sizeof(reply));
+    if (ret == 0) {
+        decode(reply, out);
+    }
+
+    return ret;
+}
+
+int Board::fanstats(uint8_t fan, FanStats& out)
+{
+    uint8_t reply[FANSTATS_SIZE];
+
+    if (fan >= FAN_COUNT) {
+        return -EINVAL;
+    }
+
+    int ret = query_(Cmd::FANSTATS, &fan, 1, reply, sizeof(reply));
+    if (ret == 0) {
+        decode(reply, out);
+    }
+
+    return ret;
+}
+
+int Board::fanstats_reset()
+{
+    uint8_t all = 0xFF;
+
+    return send_(Cmd::FANSTATS, &all, 1);
+}
+
+int Board::set_duty(uint8_t duty)
+{
+    if (duty > 100) {
+        return -EINVAL;
+    }
+
+    return send_(Cmd::SET_DUTY, &duty, 1);
+}
+
+int Board::set_target(uint16_t rpm)
+{
+    uint8_t args[] = {(uint8_t)rpm, (uint8_t)(rpm >> 8)};
+
+    return send_(Cmd::SET_TARGET, args, sizeof(args));
+}
+
+int Board::snapshot()
+{
+    return send_(Cmd::SNAPSHOT, nullptr, 0);
+}
+
+int Board::snapshot_get(uint8_t fan, Snapshot& out)
+{
+    uint8_t reply[SNAPSHOT_SIZE];
+
+    if (fan >= FAN_COUNT) {
+        return -EINVAL;
+    }
+
+    int ret = query_(Cmd::SNAPSHOT_GET, &fan, 1, reply, sizeof(reply));
+    if (ret == 0) {
+        decode(reply, out);
+    }
+
+    return ret;
+}
+
+int Board::history(uint32_t offset, HistoryChunk& out)
+{
+    uint8_t args[] = {(uint8_t)offset, (uint8_t)(offset >> 8),
+                      (uint8_t)(offset >> 16), (uint8_t)(offset >> 24)};
+    uint8_t reply[HISTORY_SIZE];
+
+    int ret = query_(Cmd::HISTORY, args, sizeof(args), reply, sizeof(reply));
+    if (ret == 0) {
+        decode(reply, out);
+    }
+
+    return ret;
+}
+
+int Board::fans(Fans& out)
+{
+    uint8_t reply[FANS_SIZE];
+
+    int ret = query_(Cmd::FANS, nullptr, 0, reply, sizeof(reply));
+    if (ret == 0) {
+        decode(reply, out);
+    }
+
+    return ret;
+}
+
+int Board::log(EventChunk& out)
+{
+    uint8_t reply[LOG_SIZE];
+
+    int ret = query_(Cmd::LOG, nullptr, 0, reply, sizeof(reply));
+    if (ret == 0) {
+        decode(reply, out);
+    }
+
+    return ret;
+}
+
+} // namespace fancontrol
@@ -0,0 +1,307 @@
+/* Host side client of the fancontrol I2C command protocol (see src/cmd.c).
+ *
+ * A command is a write of the command ID, the argument length and the
+ * arguments. The board handles it on its next command tick, which may take
+ * up to 500 ms, and queues the reply for the next read. Replies carry no
+ * length or checksum, so the reader must know the size of every reply, and
+ * must read each reply in full to keep the next one aligned.
+ *
+ * Every function returns 0 or a negative errno value.
+ */
+#ifndef FANCONTROL_H__
+#define FANCONTROL_H__
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace fancontrol {
+
+constexpr unsigned FAN_COUNT = 8;
+constexpr unsigned ZONE_COUNT = 4;
+constexpr unsigned FANSTATS_BUCKETS = 8;
+/* Bytes of history carried by one reply */
+constexpr size_t HISTORY_CHUNK = 64;
+/* Address that reaches every board with general call enabled */
+constexpr uint8_t BROADCAST = 0;
+
+enum class Cmd : uint8_t {
+    REPORT = 0,
+    HELLO,
+    FAULTS,
+    ALERT,
+    ZONES,
+    FANSTATS,
+    PERF,
+    SET_DUTY,
+    SET_TARGET,
+    SNAPSHOT,
+    SNAPSHOT_GET,
+    HISTORY,
+    FANS,
+    LOG,
+};
+
+/* Bits of Faults::flags, as `enum fault_flag` */
+constexpr uint8_t FAULT_STALL = 1 << 0;
+constexpr uint8_t FAULT_UNDERSPEED = 1 << 1;
+
+/* Bits of Alert::events, as `enum alert_event` */
+constexpr uint8_t ALERT_FAULT = 1 << 0;
+constexpr uint8_t ALERT_TEMP = 1 << 1;
+constexpr uint8_t ALERT_RPM = 1 << 2;
+
+/* Zone temperature of a zone without data */
+constexpr int32_t NO_TEMP = INT32_MIN;
+
+struct Report {
+    uint16_t rpm[FAN_COUNT];
+};
+
+struct Faults {
+    uint8_t flags[FAN_COUNT];
+    uint16_t stalls[FAN_COUNT];
+    uint16_t underspeeds[FAN_COUNT];
+    uint16_t recoveries[FAN_COUNT];
+};
+
+struct Alert {
+    uint8_t events;
+    uint16_t fans;
+};
+
+struct Zones {
+    /* Temperature in mC, or NO_TEMP */
+    int32_t temp[ZONE_COUNT];
+    /* Age of the temperature in ms, saturated to 0xFFFF */
+    uint16_t age[ZONE_COUNT];
+};
+
+struct FanStats {
+    uint16_t min;
+    uint16_t max;
+    uint16_t mean;
+    uint32_t variance;
+    uint32_t captures;
+    uint16_t stalls;
+    uint32_t rotation_ms;
+    uint16_t hist[FANSTATS_BUCKETS];
+};
+
+struct Snapshot {
+    /* Board time the snapshot was taken, in ms */
+    uint32_t stamp;
+    FanStats stats;
+};
+
+struct Fans {
+    /* Duty cycle in percent */
+    uint8_t duty[FAN_COUNT];
+    /* Zone the fan is assigned to */
+    uint8_t zone[FAN_COUNT];
+};
+
+/* Subsystems and codes of logged events, as `enum evlog_sys` and
+ * `enum evlog_code` */
+enum class EventSys : uint8_t { FAN = 0, CMD, ZONE };
+enum class EventCode : uint8_t {
+    FAN_STALL = 0,
+    FAN_UNDERSPEED,
+    FAN_RECOVERED,
+    CMD_DROPPED,
+    ZONE_POLL,
+};
+
+struct Event {
+    /* Board time of the first occurrence, in ms */
+    uint32_t stamp;
+    EventSys sys;
+    EventCode code;
+    uint16_t a;
+    uint16_t b;
+    /* Further occurrences merged into this event */
+    uint16_t repeats;
+};
+
+struct EventChunk {
+    /* Events still in the log after this chunk */
+    uint8_t remaining;
+    /* Events lost to a full log since the last chunk */
+    uint16_t dropped;
+    std::vector<Event> events;
+};
+
+struct HistoryChunk {
+    /* Offset the data was read from, and the offset to read next */
+    uint32_t offset;
+    uint32_t next;
+    std::vector<uint8_t> data;
+};
+
+/* Size of the reply to each command, without the leading byte */
+constexpr size_t REPORT_SIZE = 2 * FAN_COUNT;
+constexpr size_t HELLO_SIZE = 4;
+constexpr size_t FAULTS_SIZE = 7 * FAN_COUNT;
+constexpr size_t ALERT_SIZE = 3;
+constexpr size_t ZONES_SIZE = 6 * ZONE_COUNT;
+constexpr size_t FANSTATS_SIZE = 20 + 2 * FANSTATS_BUCKETS;
+constexpr size_t SNAPSHOT_SIZE = 4 + FANSTATS_SIZE;
+constexpr size_t HISTORY_SIZE = 5 + HISTORY_CHUNK;
+constexpr size_t FANS_SIZE = 2 * FAN_COUNT;
+/* Events carried by one log reply */
+constexpr size_t LOG_CHUNK = 6;
+constexpr size_t EVENT_SIZE = 12;
+constexpr size_t LOG_SIZE = 4 + LOG_CHUNK * EVENT_SIZE;
+
+void decode(const uint8_t* buf, Report& out);
+void decode(const uint8_t* buf, Faults& out);
+void decode(const uint8_t* buf, Alert& out);
+void decode(const uint8_t* buf, Zones& out);
+void decode(const uint8_t* buf, FanStats& out);
+void decode(const uint8_t* buf, Snapshot& out);
+void decode(const uint8_t* buf, HistoryChunk& out);
+void decode(const uint8_t* buf, Fans& out);
+void decode(const uint8_t* buf, EventChunk& out);
+
+/**
+ * @brief Parse a list of 7-bit addresses and ranges such as "8-40,50"
+ *
+ * @return int
+ * @retval 0 Success
+ * @retval -EINVAL Malformed list
+ */
+int parse_addrs(const char* list, std::vector<uint8_t>& out);
+
+/**
+ * @brief One message of a bus transaction
+ */
+struct Msg {
+    uint8_t addr;
+    bool read;
+    uint8_t* buf;
+    uint16_t len;
+};
+
+/**
+ * @brief Access to an I2C bus
+ */
+class Transport {
+public:
+    virtual ~Transport() = default;
+
+    /**
+     * @brief Run @p count messages as one transaction, with a repeated start
+     * between messages. Stops at the first message that is not acknowledged,
+     * so on failure an unknown number of the messages have been run.
+     *
+     * @return int
+     * @retval 0 Every message was acknowledged
+     * @retval -ENXIO A message was not acknowledged
+     */
+    virtual int transfer(Msg* msgs, size_t count) = 0;
+
+    /**
+     * @brief Largest number of messages `transfer` accepts at once
+     */
+    virtual size_t max_batch() const = 0;
+};
+
+struct Options {
+    /* Time the board is given to handle a command before its reply is read */
+    std::chrono::microseconds settle{550000};
+    /* Bytes the board sends ahead of every reply, which are discarded */
+    size_t reply_offset = 1;
+};
+
+/**
+ * @brief Reply of one board to a batched query
+ */
+struct Reply {
+    uint8_t addr;
+    int status;
+    std::vector<uint8_t> data;
+};
+
+/**
+ * @brief Sends the same command to many boards at once. Every command is
+ * written before any reply is read, so the boards handle their commands in
+ * parallel, and the time waiting for them is paid once per batch.
+ */
+class Poller {
+public:
+    Poller(Transport& bus, std::vector<uint8_t> addrs, Options opts = {});
+
+    /**
+     * @brief Send @p cmd with @p args to every board and read a reply of
+     * @p reply_len bytes from every board that acknowledged the command.
+     * @p out holds one reply per board, in the order of the addresses.
+     *
+     * @return int
+     * @retval 0 The batch was run, see the status of each reply
+     */
+    int query(
+        Cmd cmd, const std::vector<uint8_t>& args, size_t reply_len,
+        std::vector<Reply>& out
+    );
+
+    /**
+     * @brief Read the speeds of every board. Boards that failed have their
+     * status set in @p status and their report left untouched.
+     */
+    int poll(std::vector<Report>& out, std::vector<int>& status);
+
+    const std::vector<uint8_t>& addrs() const { return addrs_; }
+
+private:
+    int run_(std::vector<Msg>& msgs, std::vector<int>& status, bool retry);
+
+    Transport& bus_;
+    std::vector<uint8_t> addrs_;
+    Options opts_;
+    /* Kept across batches, so polling does not allocate once warmed up */
+    std::vector<uint8_t> packet_;
+    std::vector<Msg> msgs_;
+    std::vector<int> status_;
+    std::vector<size_t> index_;
+    std::vector<Reply> replies_;
+};
+
+/**
+ * @brief Client of a single board. With the address BROADCAST only the
+ * commands without a reply may be used.
+ */
+class Board {
+public:
+    Board(Transport& bus, uint8_t addr, Options opts = {});
+
+    int hello();
+    int report(Report& out);
+    int faults(Faults& out);
+    int alert(Alert& out);
+    int zones(Zones& out);
+    int fanstats(uint8_t fan, FanStats& out);
+    int fanstats_reset();
+    int set_duty(uint8_t duty);
+    int set_target(uint16_t rpm);
+    int snapshot();
+    int snapshot_get(uint8_t fan, Snapshot& out);
+    int history(uint32_t offset, HistoryChunk& out);
+    int fans(Fans& out);
+    int log(EventChunk& out);
+
+private:
+    int send_(Cmd cmd, const uint8_t* args, uint8_t len);
+    int query_(
+        Cmd cmd, const uint8_t* args, uint8_t len, uint8_t* reply,
+        size_t reply_len
+    );
+
+    Transport& bus_;
+    uint8_t addr_;
+    Options opts_;
+};
+
+} // namespace fancontrol
+
+#endif /* FANCONTROL_H__ */
@@ -0,0 +1,370 @@
+/* Command line client for fancontrol boards on a Linux I2C bus.
+ *
+ * Build from the repository root with:
+ *
+ *   g++ -std=c++17 -O2 -Wall -Ihost -o fanctl host/fanctl.cpp \
+ *       host/fancontrol.cpp host/i2cdev.cpp host/mock.cpp
+ *   ./fanctl [-d <device>] [-m <boards>] [-s <settle ms>] [-o <offset>]
+ *       <command> [<args>]
+ *
+ * Commands:
+ *
+ *   hello <addr>
+ *   report <addr>
+ *   faults <addr>
+ *   alert <addr>
+ *   zones <addr>
+ *   fans <addr>
+ *   log <addr>
+ *   stats <addr> <fan>|reset
+ *   snapshot <addr>
+ *   snapshot_get <addr> <fan>
+ *   duty <addr> <percent>
+ *   target <addr> <rpm>
+ *   history <addr> [<offset>]
+ *   poll <addrs> [<rounds>]
+ *
+ * The address 0 sends duty, target and snapshot to every board through a
+ * general call. poll takes a list of addresses and ranges such as 8-40,50,
+ * and polls the speeds of all of them together for the given number of
+ * rounds, reporting the rate achieved.
+ *
+ * With -m the commands go to the given number of mock boards at addresses
+ * 8 and up instead of a bus, which reply without delay.
+ */
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "fancontrol.h"
+#include "i2cdev.h"
+#include "mock.h"
+
+using namespace fancontrol;
+
+#define MOCK_FIRST_ (8)
+
+static void usage_(const char* name)
+{
+    (void)fprintf(
+        stderr,
+        "Usage: %s [-d <device>] [-m <boards>] [-s <settle ms>] "
+        "[-o <offset>] <command> [<args>]\n",
+        name
+    );
+    exit(2);
+}
+
+static void check_(int ret, const char* what)
+{
+    if (ret == 0) {
+        return;
+    }
+
+    (void)fprintf(stderr, "%s: %s\n", what, strerror(-ret));
+    exit(1);
+}
+
+static unsigned long number_(const char* arg, unsigned long max)
+{
+    char* end;
+    unsigned long v = strtoul(arg, &end, 0);
+
+    if (*arg == '\0' || *end != '\0' || v > max) {
+        (void)fprintf(stderr, "Invalid number: %s\n", arg);
+        exit(2);
+    }
+
+    return v;
+}
+
+static void print_report_(uint8_t addr, const Report& r)
+{
+    (void)printf("0x%02x:", addr);
+
+    for (unsigned i = 0; i < FAN_COUNT; i++) {
+        (void)printf(" %5u", r.rpm[i]);
+    }
+
+    (void)printf(" RPM\n");
+}
+
+static void print_stats_(const FanStats& s)
+{
+    (void)printf(
+        "min %u max %u mean %u variance %u captures %u stalls %u "
+        "rotation %u ms\nhist",
+        s.min, s.max, s.mean, s.variance, s.captures, s.stalls,
+        s.rotation_ms
+    );
+
+    for (unsigned i = 0; i < FANSTATS_BUCKETS; i++) {
+        (void)printf(" %u", s.hist[i]);
+    }
+
+    (void)printf("\n");
+}
+
+static int history_(Board& board, uint32_t offset)
+{
+    HistoryChunk chunk;
+
+    do {
+        int ret = board.history(offset, chunk);
+        if (ret != 0) {
+            return ret;
+        }
+
+        for (size_t i = 0; i < chunk.data.size(); i++) {
+            if (i % 16 == 0) {
+                (void)printf(
+                    "%s%08x:", i ? "\n" : "", (unsigned)(chunk.offset + i)
+                );
+            }
+            (void)printf(" %02x", chunk.data[i]);
+        }
+
+        if (!chunk.data.empty()) {
+            (void)printf("\n");
+        }
+
+        offset = chunk.next;
+    } while (!chunk.data.empty());
+
+    return 0;
+}
+
+static int log_(Board& board)
+{
+    static const char* const sys[] = {"fan", "cmd", "zone"};
+    static const char* const codes[] = {"stall", "underspeed", "recovered",
+                                        "dropped", "poll failed"};
+    EventChunk chunk;
+
+    do {
+        int ret = board.log(chunk);
+        if (ret != 0) {
+            return ret;
+        }
+
+        if (chunk.dropped != 0) {
+            (void)printf("%u events dropped\n", chunk.dropped);
+        }
+
+        for (const Event& e : chunk.events) {
+            unsigned s = (unsigned)e.sys;
+            unsigned c = (unsigned)e.code;
+
+            (void)printf(
+                "%u ms %s %s %u %u", e.stamp, s < 3 ? sys[s] : "?",
+                c < 5 ? codes[c] : "?", e.a, e.b
+            );
+
+            if (e.repeats != 0) {
+                (void)printf(" (repeated %u)", e.repeats);
+            }
+
+            (void)printf("\n");
+        }
+    } while (chunk.remaining != 0);
+
+    return 0;
+}
+
+static int poll_(Transport& bus, const Options& opts, char** args, int count)
+{
+    std::vector<uint8_t> addrs;
+
+    if (parse_addrs(args[0], addrs) != 0) {
+        (void)fprintf(stderr, "Invalid address list: %s\n", args[0]);
+        exit(2);
+    }
+
+    Poller poller(bus, addrs, opts);
+    unsigned long rounds = count > 1 ? number_(args[1], ULONG_MAX) : 1;
+    std::vector<Report> reports;
+    std::vector<int> status;
+    unsigned long ok = 0;
+    unsigned long failed = 0;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (unsigned long n = 0; n < rounds; n++) {
+        int ret = poller.poll(reports, status);
+        if (ret != 0) {
+            return ret;
+        }
+
+        for (size_t i = 0; i < reports.size(); i++) {
+            uint8_t addr = poller.addrs()[i];
+
+            if (status[i] != 0) {
+                (void)printf("0x%02x: %s\n", addr, strerror(-status[i]));
+                failed++;
+                continue;
+            }
+
+            print_report_(addr, reports[i]);
+            ok++;
+        }
+    }
+
+    std::chrono::duration<double> took =
+        std::chrono::steady_clock::now() - start;
+
+    (void)fprintf(
+        stderr, "%lu replies, %lu failed in %.3f s, %.1f boards/s\n", ok,
+        failed, took.count(), (ok + failed) / took.count()
+    );
+
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    const char* device = "/dev/i2c-1";
+    unsigned long mock = 0;
+    Options opts;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:m:s:o:")) != -1) {
+        switch (opt) {
+        case 'd':
+            device = optarg;
+            break;
+        case 'm':
+            mock = number_(optarg, 0x78 - MOCK_FIRST_);
+            break;
+        case 's':
+            opts.settle = std::chrono::milliseconds(number_(optarg, 60000));
+            break;
+        case 'o':
+            opts.reply_offset = number_(optarg, 16);
+            break;
+        default:
+            usage_(argv[0]);
+        }
+    }
+
+    if (optind + 2 > argc) {
+        usage_(argv[0]);
+    }
+
+    std::string cmd = argv[optind];
+    char** args = argv + optind + 1;
+    int count = argc - optind - 1;
+
+    I2cDev dev;
+    MockBus mock_bus(opts.reply_offset);
+    Transport* bus = &dev;
+
+    if (mock > 0) {
+        for (unsigned long i = 0; i < mock; i++) {
+            MockBoard& b = mock_bus.add(MOCK_FIRST_ + i);
+
+            b.gcall = true;
+            for (unsigned f = 0; f < FAN_COUNT; f++) {
+                b.report.rpm[f] = 1000 + 10 * i + f;
+            }
+        }
+
+        opts.settle = std::chrono::microseconds(0);
+        bus = &mock_bus;
+    } else {
+        check_(dev.open(device), device);
+    }
+
+    if (cmd == "poll") {
+        check_(poll_(*bus, opts, args, count), "poll");
+        return 0;
+    }
+
+    Board board(*bus, number_(args[0], 0x7F), opts);
+
+    if (cmd == "hello") {
+        check_(board.hello(), "hello");
+        (void)printf("hey\n");
+    } else if (cmd == "report") {
+        Report r;
+
+        check_(board.report(r), "report");
+        print_report_(number_(args[0], 0x7F), r);
+    } else if (cmd == "faults") {
+        Faults f;
+
+        check_(board.faults(f), "faults");
+        for (unsigned i = 0; i < FAN_COUNT; i++) {
+            (void)printf(
+                "%u:%s%s stalls %u underspeeds %u recoveries %u\n", i,
+                f.flags[i] & FAULT_STALL ? " stall" : "",
+                f.flags[i] & FAULT_UNDERSPEED ? " underspeed" : "",
+                f.stalls[i], f.underspeeds[i], f.recoveries[i]
+            );
+        }
+    } else if (cmd == "alert") {
+        Alert a;
+
+        check_(board.alert(a), "alert");
+        (void)printf("events 0x%02x fans 0x%04x\n", a.events, a.fans);
+    } else if (cmd == "zones") {
+        Zones z;
+
+        check_(board.zones(z), "zones");
+        for (unsigned i = 0; i < ZONE_COUNT; i++) {
+            if (z.temp[i] == NO_TEMP) {
+                (void)printf("%u: none\n", i);
+            } else {
+                (void)printf(
+                    "%u: %d mC, %u ms old\n", i, z.temp[i], z.age[i]
+                );
+            }
+        }
+    } else if (cmd == "fans") {
+        Fans f;
+
+        check_(board.fans(f), "fans");
+        for (unsigned i = 0; i < FAN_COUNT; i++) {
+            (void)printf("%u: %u%%, zone %u\n", i, f.duty[i], f.zone[i]);
+        }
+    } else if (cmd == "log") {
+        check_(log_(board), "log");
+    } else if (cmd == "stats" && count >= 2) {
+        if (strcmp(args[1], "reset") == 0) {
+            check_(board.fanstats_reset(), "stats");
+        } else {
+            FanStats s;
+
+            check_(board.fanstats(number_(args[1], 0xFF), s), "stats");
+            print_stats_(s);
+        }
+    } else if (cmd == "snapshot") {
+        check_(board.snapshot(), "snapshot");
+    } else if (cmd == "snapshot_get" && count >= 2) {
+        Snapshot s;
+
+        check_(
+            board.snapshot_get(number_(args[1], 0xFF), s), "snapshot_get"
+        );
+        (void)printf("taken at %u ms\n", s.stamp);
+        print_stats_(s.stats);
+    } else if (cmd == "duty" && count >= 2) {
+        check_(board.set_duty(number_(args[1], 100)), "duty");
+    } else if (cmd == "target" && count >= 2) {
+        check_(board.set_target(number_(args[1], UINT16_MAX)), "target");
+    } else if (cmd == "history") {
+        uint32_t offset = count >= 2 ? number_(args[1], UINT32_MAX) : 0;
+
+        check_(history_(board, offset), "history");
+    } else {
+        usage_(argv[0]);
+    }
+
+    return 0;
+}
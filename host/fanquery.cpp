@@ -0,0 +1,298 @@
+/* Query tool for the ring files written by fancollect.
+ *
+ * Build from the repository root with:
+ *
+ *   g++ -std=c++17 -O2 -Wall -Ihost -o fanquery host/fanquery.cpp \
+ *       host/collector.cpp host/fancontrol.cpp host/ringfile.cpp
+ *   ./fanquery [-D <dir>] [-b <addrs>] [-f <fan>] [-s <start>] [-e <end>]
+ *       dump|stats
+ *
+ * dump prints every sample in the range as CSV, and stats prints, for every
+ * fan, the number of samples, the minimum, mean and maximum speed, the mean
+ * duty cycle, the highest temperature and the number of samples with a fault.
+ *
+ * Boards default to every ring file in the directory. Times are in seconds
+ * since the epoch, or relative to now when 0 or negative, and default to the
+ * whole file. It may run while the collector is appending.
+ */
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <dirent.h>
+#include <unistd.h>
+
+#include "collector.h"
+#include "ringfile.h"
+
+using namespace fancontrol;
+
+/* Samples copied out of a ring file at once */
+#define CHUNK_ (4096)
+
+struct Aggregate_ {
+    uint64_t count;
+    uint16_t rpm_min;
+    uint16_t rpm_max;
+    uint64_t rpm_total;
+    uint64_t duty_total;
+    uint64_t duty_count;
+    int16_t temp_max;
+    uint64_t faulted;
+};
+
+static void usage_(const char* name)
+{
+    (void)fprintf(
+        stderr,
+        "Usage: %s [-D <dir>] [-b <addrs>] [-f <fan>] [-s <start>] "
+        "[-e <end>] dump|stats\n",
+        name
+    );
+    exit(2);
+}
+
+/**
+ * @brief Parse time @p arg into ms since the epoch
+ */
+static uint64_t time_(const char* arg)
+{
+    char* end;
+    long long t = strtoll(arg, &end, 0);
+
+    if (*arg == '\0' || *end != '\0') {
+        (void)fprintf(stderr, "Invalid time: %s\n", arg);
+        exit(2);
+    }
+
+    if (t <= 0) {
+        auto now = std::chrono::system_clock::now().time_since_epoch();
+
+        t += std::chrono::duration_cast<std::chrono::seconds>(now).count();
+    }
+
+    return t < 0 ? 0 : t * 1000ULL;
+}
+
+/**
+ * @brief Find the boards that have a ring file in @p dir
+ */
+static std::vector<uint8_t> boards_(const char* dir)
+{
+    std::vector<uint8_t> out;
+    DIR* d = opendir(dir);
+
+    if (d == nullptr) {
+        (void)fprintf(stderr, "%s: %s\n", dir, strerror(errno));
+        exit(1);
+    }
+
+    for (struct dirent* e; (e = readdir(d)) != nullptr;) {
+        unsigned addr;
+        char end;
+
+        if (sscanf(e->d_name, "board-%2x.ring%c", &addr, &end) == 1 &&
+            strlen(e->d_name) == sizeof("board-00.ring") - 1) {
+            out.push_back(addr);
+        }
+    }
+
+    (void)closedir(d);
+
+    std::sort(out.begin(), out.end());
+
+    return out;
+}
+
+static void print_sample_(const Sample& s)
+{
+    (void)printf(
+        "%llu,0x%02x,%u,%u,", (unsigned long long)s.time_ms, s.board, s.fan,
+        s.rpm
+    );
+
+    if (s.duty != SAMPLE_NO_DUTY) {
+        (void)printf("%u", s.duty);
+    }
+    (void)printf(",");
+
+    if (s.temp != SAMPLE_NO_TEMP) {
+        (void)printf("%d.%d", s.temp / 10, abs(s.temp % 10));
+    }
+
+    (void)printf(",%u\n", s.faults);
+}
+
+static void add_(Aggregate_& a, const Sample& s)
+{
+    if (a.count == 0 || s.rpm < a.rpm_min) {
+        a.rpm_min = s.rpm;
+    }
+    if (a.count == 0 || s.rpm > a.rpm_max) {
+        a.rpm_max = s.rpm;
+    }
+
+    a.count++;
+    a.rpm_total += s.rpm;
+
+    if (s.duty != SAMPLE_NO_DUTY) {
+        a.duty_total += s.duty;
+        a.duty_count++;
+    }
+
+    if (s.temp != SAMPLE_NO_TEMP && s.temp > a.temp_max) {
+        a.temp_max = s.temp;
+    }
+
+    if (s.faults != 0) {
+        a.faulted++;
+    }
+}
+
+static void print_aggregate_(uint8_t board, unsigned fan, const Aggregate_& a)
+{
+    if (a.count == 0) {
+        return;
+    }
+
+    (void)printf(
+        "0x%02x %3u %8llu %6u %6llu %6u ", board, fan,
+        (unsigned long long)a.count, a.rpm_min,
+        (unsigned long long)(a.rpm_total / a.count), a.rpm_max
+    );
+
+    if (a.duty_count > 0) {
+        (void)printf(
+            "%5llu%% ", (unsigned long long)(a.duty_total / a.duty_count)
+        );
+    } else {
+        (void)printf("%6s ", "-");
+    }
+
+    if (a.temp_max != SAMPLE_NO_TEMP) {
+        (void)printf("%5d.%d ", a.temp_max / 10, abs(a.temp_max % 10));
+    } else {
+        (void)printf("%7s ", "-");
+    }
+
+    (void)printf("%8llu\n", (unsigned long long)a.faulted);
+}
+
+int main(int argc, char** argv)
+{
+    static Sample buf[CHUNK_];
+
+    const char* dir = ".";
+    const char* addr_list = nullptr;
+    int fan = -1;
+    uint64_t start = 0;
+    uint64_t end = UINT64_MAX;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "D:b:f:s:e:")) != -1) {
+        switch (opt) {
+        case 'D':
+            dir = optarg;
+            break;
+        case 'b':
+            addr_list = optarg;
+            break;
+        case 'f':
+            fan = atoi(optarg);
+            break;
+        case 's':
+            start = time_(optarg);
+            break;
+        case 'e':
+            end = time_(optarg);
+            break;
+        default:
+            usage_(argv[0]);
+        }
+    }
+
+    if (optind + 1 != argc) {
+        usage_(argv[0]);
+    }
+
+    bool dump = strcmp(argv[optind], "dump") == 0;
+
+    if (!dump && strcmp(argv[optind], "stats") != 0) {
+        usage_(argv[0]);
+    }
+
+    std::vector<uint8_t> addrs;
+
+    if (addr_list == nullptr) {
+        addrs = boards_(dir);
+    } else if (parse_addrs(addr_list, addrs) != 0) {
+        usage_(argv[0]);
+    }
+
+    if (dump) {
+        (void)printf("time_ms,board,fan,rpm,duty,temp,faults\n");
+    } else {
+        (void)printf(
+            "board fan  samples    min   mean    max   duty    temp  faulted\n"
+        );
+    }
+
+    for (uint8_t addr : addrs) {
+        RingFile ring;
+        Aggregate_ agg[FAN_COUNT] = {};
+
+        int ret = ring.open(Collector::path(dir, addr));
+        if (ret != 0) {
+            (void)fprintf(
+                stderr, "%s: %s\n", Collector::path(dir, addr).c_str(),
+                strerror(-ret)
+            );
+            continue;
+        }
+
+        for (auto& a : agg) {
+            a.temp_max = SAMPLE_NO_TEMP;
+        }
+
+        uint64_t next = ring.seek(start);
+        bool done = false;
+
+        while (!done) {
+            size_t count = ring.read(next, buf, CHUNK_);
+
+            if (count == 0) {
+                break;
+            }
+
+            for (size_t i = 0; i < count; i++) {
+                const Sample& s = buf[i];
+
+                if (s.time_ms >= end) {
+                    done = true;
+                    break;
+                }
+
+                if (s.time_ms < start || s.fan >= FAN_COUNT ||
+                    (fan >= 0 && s.fan != fan)) {
+                    continue;
+                }
+
+                if (dump) {
+                    print_sample_(s);
+                } else {
+                    add_(agg[s.fan], s);
+                }
+            }
+        }
+
+        for (unsigned f = 0; !dump && f < FAN_COUNT; f++) {
+            print_aggregate_(addr, f, agg[f]);
+        }
+    }
+
+    return 0;
+}
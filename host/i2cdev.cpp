@@ -0,0 +1,87 @@
+#include <cerrno>
+
+#include <fcntl.h>
+#include <linux/i2c-dev.h>
+#include <linux/i2c.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "i2cdev.h"
+
+namespace fancontrol {
+
+I2cDev::~I2cDev()
+{
+    if (fd_ >= 0) {
+        (void)close(fd_);
+    }
+}
+
+int I2cDev::open(const std::string& path)
+{
+    unsigned long funcs;
+
+    int fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0) {
+        return -errno;
+    }
+
+    if (ioctl(fd, I2C_FUNCS, &funcs) < 0) {
+        int err = errno;
+
+        (void)close(fd);
+        return -err;
+    }
+
+    if (!(funcs & I2C_FUNC_I2C)) {
+        (void)close(fd);
+        return -EOPNOTSUPP;
+    }
+
+    if (fd_ >= 0) {
+        (void)close(fd_);
+    }
+
+    fd_ = fd;
+
+    return 0;
+}
+
+int I2cDev::transfer(Msg* msgs, size_t count)
+{
+    struct i2c_msg kmsgs[I2C_RDWR_IOCTL_MAX_MSGS];
+    struct i2c_rdwr_ioctl_data data = {kmsgs, (__u32)count};
+
+    if (fd_ < 0) {
+        return -EBADF;
+    }
+
+    if (count == 0 || count > I2C_RDWR_IOCTL_MAX_MSGS) {
+        return -EINVAL;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        kmsgs[i].addr = msgs[i].addr;
+        kmsgs[i].flags = msgs[i].read ? I2C_M_RD : 0;
+        kmsgs[i].len = msgs[i].len;
+        kmsgs[i].buf = msgs[i].buf;
+    }
+
+    if (ioctl(fd_, I2C_RDWR, &data) < 0) {
+        /* Adapters differ in how they report a missing acknowledge */
+        if (errno == EREMOTEIO || errno == EIO) {
+            return -ENXIO;
+        }
+
+        return -errno;
+    }
+
+    return 0;
+}
+
+size_t I2cDev::max_batch() const
+{
+    return I2C_RDWR_IOCTL_MAX_MSGS;
+}
+
+} // namespace fancontrol
@@ -0,0 +1,37 @@
+#ifndef I2CDEV_H__
+#define I2CDEV_H__
+
+#include <string>
+
+#include "fancontrol.h"
+
+namespace fancontrol {
+
+/**
+ * @brief Transport over a Linux i2c-dev bus (/dev/i2c-*). A batch of
+ * messages is handed to the kernel in a single I2C_RDWR call.
+ */
+class I2cDev : public Transport {
+public:
+    ~I2cDev() override;
+
+    /**
+     * @brief Open bus @p path
+     *
+     * @return int
+     * @retval 0 The bus was opened
+     * @retval -errno The bus could not be opened, or does not support plain
+     * I2C transfers
+     */
+    int open(const std::string& path);
+
+    int transfer(Msg* msgs, size_t count) override;
+    size_t max_batch() const override;
+
+private:
+    int fd_ = -1;
+};
+
+} // namespace fancontrol
+
+#endif /* I2CDEV_H__ */
@@ -0,0 +1,283 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "mock.h"
+
+namespace fancontrol {
+
+static void put16_(std::vector<uint8_t>& out, uint16_t v)
+{
+    out.push_back(v);
+    out.push_back(v >> 8);
+}
+
+static void put32_(std::vector<uint8_t>& out, uint32_t v)
+{
+    put16_(out, v);
+    put16_(out, v >> 16);
+}
+
+static void put_stats_(std::vector<uint8_t>& out, const FanStats& s)
+{
+    put16_(out, s.min);
+    put16_(out, s.max);
+    put16_(out, s.mean);
+    put32_(out, s.variance);
+    put32_(out, s.captures);
+    put16_(out, s.stalls);
+    put32_(out, s.rotation_ms);
+
+    for (unsigned i = 0; i < FANSTATS_BUCKETS; i++) {
+        put16_(out, s.hist[i]);
+    }
+}
+
+void MockBoard::reply_(const std::vector<uint8_t>& data)
+{
+    tx.insert(tx.end(), data.begin(), data.end());
+}
+
+void MockBoard::handle(const uint8_t* packet, size_t len, bool gcall)
+{
+    std::vector<uint8_t> out;
+
+    if (len < 2) {
+        return;
+    }
+
+    Cmd cmd = (Cmd)packet[0];
+    const uint8_t* args = packet + 2;
+    size_t arg_len = std::min<size_t>(packet[1], len - 2);
+
+    if (gcall && cmd != Cmd::SET_DUTY && cmd != Cmd::SET_TARGET &&
+        cmd != Cmd::SNAPSHOT) {
+        return;
+    }
+
+    commands++;
+
+    switch (cmd) {
+    case Cmd::REPORT:
+        for (unsigned i = 0; i < FAN_COUNT; i++) {
+            put16_(out, report.rpm[i]);
+        }
+        break;
+    case Cmd::HELLO:
+        out.assign({'h', 'e', 'y', 0});
+        break;
+    case Cmd::FAULTS:
+        out.assign(faults.flags, faults.flags + FAN_COUNT);
+
+        for (unsigned i = 0; i < FAN_COUNT; i++) {
+            put16_(out, faults.stalls[i]);
+            put16_(out, faults.underspeeds[i]);
+            put16_(out, faults.recoveries[i]);
+        }
+        break;
+    case Cmd::ALERT:
+        out.push_back(alert.events);
+        put16_(out, alert.fans);
+        alert = {};
+        break;
+    case Cmd::ZONES:
+        for (unsigned i = 0; i < ZONE_COUNT; i++) {
+            put32_(out, zones.temp[i]);
+        }
+        for (unsigned i = 0; i < ZONE_COUNT; i++) {
+            put16_(out, zones.age[i]);
+        }
+        break;
+    case Cmd::FANSTATS:
+        if (arg_len < 1) {
+            return;
+        }
+        if (args[0] == 0xFF) {
+            std::fill(stats, stats + FAN_COUNT, FanStats{});
+            return;
+        }
+        if (args[0] >= FAN_COUNT) {
+            return;
+        }
+        put_stats_(out, stats[args[0]]);
+        break;
+    case Cmd::SET_DUTY:
+        if (arg_len < 1 || args[0] > 100) {
+            return;
+        }
+        std::fill(duty, duty + FAN_COUNT, args[0]);
+        std::fill(target, target + FAN_COUNT, 0);
+        return;
+    case Cmd::SET_TARGET:
+        if (arg_len < 2) {
+            return;
+        }
+        std::fill(target, target + FAN_COUNT, args[0] | (args[1] << 8));
+        return;
+    case Cmd::SNAPSHOT:
+        std::copy(stats, stats + FAN_COUNT, snap_);
+        snap_stamp_ = clock_ms;
+        return;
+    case Cmd::SNAPSHOT_GET:
+        if (arg_len < 1 || args[0] >= FAN_COUNT) {
+            return;
+        }
+        put32_(out, snap_stamp_);
+        put_stats_(out, snap_[args[0]]);
+        break;
+    case Cmd::HISTORY: {
+        if (arg_len < 4) {
+            return;
+        }
+
+        uint32_t offset = args[0] | (args[1] << 8) | (args[2] << 16) |
+                          ((uint32_t)args[3] << 24);
+        size_t len = 0;
+
+        if (offset < history.size()) {
+            len = std::min(HISTORY_CHUNK, history.size() - offset);
+        }
+
+        put32_(out, offset);
+        out.push_back(len);
+        out.insert(
+            out.end(), history.begin() + offset,
+            history.begin() + offset + len
+        );
+        out.resize(HISTORY_SIZE, 0);
+        break;
+    }
+    case Cmd::FANS:
+        out.assign(duty, duty + FAN_COUNT);
+        out.insert(out.end(), zone, zone + FAN_COUNT);
+        break;
+    case Cmd::LOG: {
+        size_t count = std::min(LOG_CHUNK, events.size());
+
+        out.push_back(count);
+        out.push_back(std::min<size_t>(events.size() - count, UINT8_MAX));
+        put16_(out, 0);
+
+        for (size_t i = 0; i < count; i++) {
+            const Event& e = events.front();
+
+            put32_(out, e.stamp);
+            out.push_back((uint8_t)e.sys);
+            out.push_back((uint8_t)e.code);
+            put16_(out, e.a);
+            put16_(out, e.b);
+            put16_(out, e.repeats);
+            events.pop_front();
+        }
+
+        out.resize(LOG_SIZE, 0);
+        break;
+    }
+    default:
+        return;
+    }
+
+    reply_(out);
+}
+
+MockBus::MockBus(size_t reply_offset, std::chrono::microseconds latency)
+    : reply_offset_(reply_offset), latency_(latency)
+{
+}
+
+MockBoard& MockBus::add(uint8_t addr)
+{
+    Node_& node = nodes_[addr];
+
+    node = Node_{};
+    return node.board;
+}
+
+MockBoard* MockBus::board(uint8_t addr)
+{
+    auto it = nodes_.find(addr);
+
+    return it == nodes_.end() ? nullptr : &it->second.board;
+}
+
+/**
+ * @brief Let the board of @p node handle its received command, once it has
+ * had the time to. Like the firmware, everything received since the last
+ * command is taken at once, and only the first packet in it is handled.
+ */
+void MockBus::run_pending_(Node_& node)
+{
+    if (node.rx.empty() ||
+        std::chrono::steady_clock::now() < node.rx_at + latency_) {
+        return;
+    }
+
+    node.board.handle(node.rx.data(), node.rx.size(), node.rx_gcall);
+    node.rx.clear();
+}
+
+int MockBus::transfer(Msg* msgs, size_t count)
+{
+    transfers++;
+
+    if (count == 0 || count > max_batch()) {
+        return -EINVAL;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        Msg& m = msgs[i];
+        std::vector<Node_*> targets;
+
+        messages++;
+
+        if (m.addr == BROADCAST && !m.read) {
+            for (auto& it : nodes_) {
+                if (it.second.board.gcall) {
+                    targets.push_back(&it.second);
+                }
+            }
+        } else if (nodes_.count(m.addr)) {
+            targets.push_back(&nodes_[m.addr]);
+        }
+
+        if (targets.empty()) {
+            return -ENXIO;
+        }
+
+        for (Node_* node : targets) {
+            run_pending_(*node);
+
+            if (!m.read) {
+                if (node->rx.empty()) {
+                    node->rx_at = std::chrono::steady_clock::now();
+                    node->rx_gcall = m.addr == BROADCAST;
+                }
+
+                node->rx.insert(node->rx.end(), m.buf, m.buf + m.len);
+                continue;
+            }
+
+            /* An empty transmit buffer leaves the bus high */
+            for (size_t j = 0; j < m.len; j++) {
+                std::deque<uint8_t>& tx = node->board.tx;
+
+                if (j < reply_offset_ || tx.empty()) {
+                    m.buf[j] = 0xFF;
+                } else {
+                    m.buf[j] = tx.front();
+                    tx.pop_front();
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+
+size_t MockBus::max_batch() const
+{
+    /* Same as the i2c-dev limit */
+    return 42;
+}
+
+} // namespace fancontrol
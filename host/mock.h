@@ -0,0 +1,102 @@
+#ifndef MOCK_H__
+#define MOCK_H__
+
+#include <chrono>
+#include <deque>
+#include <map>
+#include <vector>
+
+#include "fancontrol.h"
+
+namespace fancontrol {
+
+/**
+ * @brief In-process model of one board, answering commands the way src/cmd.c
+ * does. Its state may be set freely by the test driving it.
+ */
+struct MockBoard {
+    /* Accept commands sent to the general call address */
+    bool gcall = false;
+
+    Report report = {};
+    Faults faults = {};
+    Alert alert = {};
+    Zones zones = {};
+    FanStats stats[FAN_COUNT] = {};
+    uint8_t duty[FAN_COUNT] = {};
+    uint16_t target[FAN_COUNT] = {};
+    uint8_t zone[FAN_COUNT] = {};
+    /* Board time, used to stamp snapshots */
+    uint32_t clock_ms = 0;
+    std::vector<uint8_t> history;
+    /* Events not yet taken by the bus master */
+    std::deque<Event> events;
+
+    /* Number of commands handled */
+    unsigned commands = 0;
+
+    /**
+     * @brief Handle the command @p packet of @p len bytes, queueing its reply
+     *
+     * @param gcall The command was sent to the general call address
+     */
+    void handle(const uint8_t* packet, size_t len, bool gcall);
+
+    /* Bytes queued for the bus master to read */
+    std::deque<uint8_t> tx;
+
+private:
+    void reply_(const std::vector<uint8_t>& data);
+
+    FanStats snap_[FAN_COUNT] = {};
+    uint32_t snap_stamp_ = 0;
+};
+
+/**
+ * @brief Transport connected to a set of mock boards rather than a bus
+ */
+class MockBus : public Transport {
+public:
+    /**
+     * @param reply_offset Bytes sent ahead of every reply, as
+     * `Options::reply_offset`
+     * @param latency Time a board takes to handle a command. A read before
+     * then finds no reply queued.
+     */
+    explicit MockBus(
+        size_t reply_offset = 1,
+        std::chrono::microseconds latency = std::chrono::microseconds(0)
+    );
+
+    /**
+     * @brief Add a board at @p addr, replacing any board already there
+     */
+    MockBoard& add(uint8_t addr);
+
+    MockBoard* board(uint8_t addr);
+
+    int transfer(Msg* msgs, size_t count) override;
+    size_t max_batch() const override;
+
+    /* Number of transfers, and of messages in them */
+    unsigned transfers = 0;
+    unsigned messages = 0;
+
+private:
+    struct Node_ {
+        MockBoard board;
+        std::vector<uint8_t> rx;
+        bool rx_gcall;
+        std::chrono::steady_clock::time_point rx_at;
+    };
+
+    void run_pending_(Node_& node);
+
+    std::map<uint8_t, Node_> nodes_;
+    size_t reply_offset_;
+    std::chrono::microseconds latency_;
+};
+
+} // namespace fancontrol
+
+#endif /* MOCK_H__ */
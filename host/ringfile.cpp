@@ -0,0 +1,211 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ringfile.h"
+
+namespace fancontrol {
+
+#define MAGIC_ "FCRING1"
+
+struct RingFile::Header_ {
+    char magic[8];
+    uint32_t sample_size;
+    uint32_t capacity;
+    /* Only accessed atomically, as it is shared with the other processes
+     * mapping the file */
+    uint64_t written;
+    uint8_t reserved[40];
+};
+
+RingFile::~RingFile()
+{
+    if (header_ != nullptr) {
+        (void)munmap(header_, size_);
+    }
+}
+
+/**
+ * @brief Map the ring file open at @p fd, checking its header
+ */
+int RingFile::map_(int fd, bool write)
+{
+    static_assert(sizeof(Header_) == 64, "Header is part of the file format");
+
+    struct stat st;
+
+    if (fstat(fd, &st) < 0) {
+        return -errno;
+    }
+
+    if ((size_t)st.st_size < sizeof(Header_)) {
+        return -EINVAL;
+    }
+
+    void* p = mmap(
+        nullptr, st.st_size, write ? PROT_READ | PROT_WRITE : PROT_READ,
+        MAP_SHARED, fd, 0
+    );
+    if (p == MAP_FAILED) {
+        return -errno;
+    }
+
+    Header_* h = (Header_*)p;
+
+    if (memcmp(h->magic, MAGIC_, sizeof(h->magic)) != 0 ||
+        h->sample_size != sizeof(Sample) || h->capacity == 0 ||
+        (size_t)st.st_size < sizeof(Header_) + h->capacity * sizeof(Sample)) {
+        (void)munmap(p, st.st_size);
+        return -EINVAL;
+    }
+
+    if (header_ != nullptr) {
+        (void)munmap(header_, size_);
+    }
+
+    header_ = h;
+    samples_ = (Sample*)(h + 1);
+    size_ = st.st_size;
+
+    return 0;
+}
+
+int RingFile::create(const std::string& path, uint32_t capacity)
+{
+    if (capacity == 0) {
+        return -EINVAL;
+    }
+
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return -errno;
+    }
+
+    struct stat st;
+    int ret = 0;
+
+    if (fstat(fd, &st) < 0) {
+        ret = -errno;
+    } else if (st.st_size == 0) {
+        Header_ h = {};
+
+        memcpy(h.magic, MAGIC_, sizeof(h.magic));
+        h.sample_size = sizeof(Sample);
+        h.capacity = capacity;
+
+        /* The samples are left as a hole, which reads back as zeros */
+        if (pwrite(fd, &h, sizeof(h), 0) != sizeof(h) ||
+            ftruncate(fd, sizeof(h) + (off_t)capacity * sizeof(Sample)) < 0) {
+            ret = errno ? -errno : -EIO;
+        }
+    }
+
+    if (ret == 0) {
+        ret = map_(fd, true);
+    }
+
+    (void)close(fd);
+
+    return ret;
+}
+
+int RingFile::open(const std::string& path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -errno;
+    }
+
+    int ret = map_(fd, false);
+
+    (void)close(fd);
+
+    return ret;
+}
+
+void RingFile::append(const Sample* samples, size_t count)
+{
+    uint64_t n = __atomic_load_n(&header_->written, __ATOMIC_RELAXED);
+
+    /* Each sample is published on its own, so a reader never takes a slot
+     * that is being overwritten as valid */
+    for (size_t i = 0; i < count; i++, n++) {
+        samples_[n % header_->capacity] = samples[i];
+        __atomic_store_n(&header_->written, n + 1, __ATOMIC_RELEASE);
+    }
+}
+
+uint64_t RingFile::written() const
+{
+    return __atomic_load_n(&header_->written, __ATOMIC_ACQUIRE);
+}
+
+uint32_t RingFile::capacity() const
+{
+    return header_->capacity;
+}
+
+size_t RingFile::read(uint64_t& first, Sample* out, size_t count) const
+{
+    uint64_t end = written();
+    uint32_t cap = header_->capacity;
+
+    if (first + cap < end + 1) {
+        /* Older samples are gone, and the oldest slot may be being
+         * overwritten by now */
+        first = end + 1 - cap;
+    }
+
+    if (first >= end) {
+        return 0;
+    }
+
+    if (count > end - first) {
+        count = end - first;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        out[i] = samples_[(first + i) % cap];
+    }
+
+    /* Drop whatever the writer overtook while copying. Sample n may be
+     * overwritten from the moment n + capacity is being written. */
+    uint64_t now = written();
+    size_t skip = 0;
+
+    if (first + cap < now + 1) {
+        skip = std::min<uint64_t>(count, now + 1 - cap - first);
+        memmove(out, out + skip, (count - skip) * sizeof(Sample));
+    }
+
+    first += count;
+
+    return count - skip;
+}
+
+uint64_t RingFile::seek(uint64_t time_ms) const
+{
+    uint64_t end = written();
+    uint32_t cap = header_->capacity;
+    uint64_t lo = end + 1 > cap ? end + 1 - cap : 0;
+    uint64_t hi = end;
+
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+
+        if (samples_[mid % cap].time_ms < time_ms) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+} // namespace fancontrol
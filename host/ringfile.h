@@ -0,0 +1,107 @@
+/* Fixed-width sample storage in memory-mapped ring files, one file per board.
+ *
+ * A file holds a header followed by `capacity` samples. The writer fills the
+ * slot of the next sample and then publishes it by advancing `written`, the
+ * total number of samples ever appended. Readers map the same file and may
+ * run while the writer appends.
+ */
+#ifndef RINGFILE_H__
+#define RINGFILE_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace fancontrol {
+
+/* Temperature of a sample whose zone had no fresh reading */
+constexpr int16_t SAMPLE_NO_TEMP = INT16_MIN;
+/* Duty cycle of a sample whose duty cycle is not known */
+constexpr uint8_t SAMPLE_NO_DUTY = 0xFF;
+
+/**
+ * @brief One fan at one moment
+ */
+struct __attribute__((packed)) Sample {
+    /* Host time of the sample, in ms since the epoch */
+    uint64_t time_ms;
+    uint16_t rpm;
+    /* Temperature of the fan's zone in 0.1 C, or SAMPLE_NO_TEMP */
+    int16_t temp;
+    uint8_t board;
+    uint8_t fan;
+    /* Duty cycle in percent, or SAMPLE_NO_DUTY */
+    uint8_t duty;
+    /* Bitmap of FAULT_* flags */
+    uint8_t faults;
+};
+
+static_assert(sizeof(Sample) == 16, "Sample is part of the file format");
+
+class RingFile {
+public:
+    RingFile() = default;
+    RingFile(const RingFile&) = delete;
+    RingFile& operator=(const RingFile&) = delete;
+    ~RingFile();
+
+    /**
+     * @brief Open the ring file at @p path for appending, creating it with
+     * room for @p capacity samples if it does not exist. An existing file
+     * keeps its own capacity.
+     *
+     * @return int
+     * @retval 0 Success
+     * @retval -EINVAL The file exists but is not a ring file
+     * @retval -errno The file could not be created or mapped
+     */
+    int create(const std::string& path, uint32_t capacity);
+
+    /**
+     * @brief Open an existing ring file at @p path for reading
+     */
+    int open(const std::string& path);
+
+    /**
+     * @brief Append @p count samples, overwriting the oldest ones once full
+     */
+    void append(const Sample* samples, size_t count);
+
+    /**
+     * @brief Total number of samples ever appended. Sample n is held while
+     * n + capacity() > written().
+     */
+    uint64_t written() const;
+
+    uint32_t capacity() const;
+
+    /**
+     * @brief Copy samples starting at sample number @p first into @p out.
+     * Samples that have been overwritten are skipped.
+     *
+     * @param first Sample number, advanced past the samples returned
+     * @return size_t Number of samples copied, at most @p count
+     */
+    size_t read(uint64_t& first, Sample* out, size_t count) const;
+
+    /**
+     * @brief Find the first sample held taken at or after @p time_ms, assuming
+     * samples are appended in time order
+     *
+     * @return uint64_t Sample number, written() if there is none
+     */
+    uint64_t seek(uint64_t time_ms) const;
+
+private:
+    struct Header_;
+
+    int map_(int fd, bool write);
+
+    Header_* header_ = nullptr;
+    Sample* samples_ = nullptr;
+    size_t size_ = 0;
+};
+
+} // namespace fancontrol
+
+#endif /* RINGFILE_H__ */
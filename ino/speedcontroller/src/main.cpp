@@ -3,57 +3,210 @@
 
 #define CONTROLLER_ (1)
 
+#define CMD_REPORT_ (0x0)
+#define FAN_COUNT_ (8)
+/* The reply is preceded by one byte that is not part of the report */
+#define REPORT_SIZE_ (1 + FAN_COUNT_ * 2)
+
+/* Maximum time a single transaction may hold the bus before it is aborted */
+#define TIMEOUT_US_ (5000UL)
+/* Time to wait after sending a command before reading its reply. The
+ * firmware only handles commands about every 500 ms, and a board that is
+ * polled faster than that overflows its receive buffer. */
+#define SETTLE_MS_ (550UL)
+/* Time after sending a command by which the reply must have been read */
+#define DEADLINE_MS_ (1000UL)
+#define STATS_INTERVAL_MS_ (1000UL)
+
+/* Addresses of the fancontrol boards to poll */
+static const uint8_t addrs_[] = {9};
+
+#define BOARD_COUNT_ (sizeof(addrs_) / sizeof(addrs_[0]))
+
 struct __attribute__((packed)) packet_ {
     uint8_t cmd;
     uint8_t arg_len;
 };
 
-void setup()
+struct stats_ {
+    uint32_t polls;
+    uint32_t nacks;
+    uint32_t timeouts;
+    uint32_t short_reads;
+    uint32_t lat_min;
+    uint32_t lat_max;
+    uint32_t lat_total;
+};
+
+enum state_ {
+    /* Ready to send the next command */
+    STATE_IDLE_,
+    /* Command sent, waiting for the reply to be ready */
+    STATE_SETTLING_,
+};
+
+static struct board_ {
+    uint16_t rpm[FAN_COUNT_];
+    enum state_ state;
+    /* Time the last command was sent, in ms and in us */
+    uint32_t sent_ms;
+    uint32_t sent_us;
+    struct stats_ stats;
+} boards_[BOARD_COUNT_];
+
+/**
+ * @brief Check, and clear, the timeout flag of the last transaction
+ */
+static bool timed_out_(void)
 {
-    Wire.begin();
-    Serial.begin(9600);
+    bool flag = Wire.getWireTimeoutFlag();
+
+    Wire.clearWireTimeoutFlag();
+
+    return flag;
 }
 
-void loop()
+/**
+ * @brief Send the report command to board @p b
+ */
+static void request_(struct board_ *b, uint8_t addr)
 {
-    delay(5000);
-
     struct packet_ p = {
-        0x0,
+        CMD_REPORT_,
         0,
     };
 
-    Serial.println("Reading speeds");
-    Wire.beginTransmission(9);
+    b->stats.polls++;
+    b->sent_ms = millis();
+    b->sent_us = micros();
+
+    Wire.beginTransmission(addr);
     Wire.write((uint8_t *)&p, sizeof(p));
-    Wire.endTransmission();
-    delay(100);
+    uint8_t status = Wire.endTransmission();
+
+    if (timed_out_()) {
+        b->stats.timeouts++;
+    } else if (status != 0) {
+        b->stats.nacks++;
+    } else {
+        b->state = STATE_SETTLING_;
+    }
+}
+
+/**
+ * @brief Read the reply to a previously sent report command from board @p b
+ */
+static void collect_(struct board_ *b, uint8_t addr)
+{
+    uint8_t buf[REPORT_SIZE_];
+
+    b->state = STATE_IDLE_;
 
-    Wire.requestFrom(9, 17);
-    delay(100);
+    /* The reply was not read in time, and may have been overtaken by the
+     * board handling later commands */
+    if (millis() - b->sent_ms > DEADLINE_MS_) {
+        b->stats.timeouts++;
+        return;
+    }
+
+    uint8_t len = Wire.requestFrom(addr, (uint8_t)sizeof(buf));
+
+    for (uint8_t i = 0; i < len; i++) {
+        buf[i] = Wire.read();
+    }
+
+    if (timed_out_()) {
+        b->stats.timeouts++;
+        return;
+    }
+    if (len < sizeof(buf)) {
+        b->stats.short_reads++;
+        return;
+    }
 
-    uint16_t arr[8] = {0};
+    uint32_t latency = micros() - b->sent_us;
 
-    for (uint8_t i = 0; Wire.available(); i++) {
-        delay(20);
-        int c = Wire.read();
-        if (c == -1) {
+    if (b->stats.lat_min == 0 || latency < b->stats.lat_min) {
+        b->stats.lat_min = latency;
+    }
+    if (latency > b->stats.lat_max) {
+        b->stats.lat_max = latency;
+    }
+    b->stats.lat_total += latency;
+
+    memcpy(b->rpm, buf + 1, sizeof(b->rpm));
+}
+
+static void print_board_(struct board_ *b, uint8_t addr)
+{
+    struct stats_ *s = &b->stats;
+    uint32_t ok = s->polls - s->nacks - s->timeouts - s->short_reads;
+
+    Serial.print("Board ");
+    Serial.print((unsigned int)addr);
+    Serial.print(":");
+
+    for (uint8_t i = 0; i < FAN_COUNT_; i++) {
+        Serial.print(" ");
+        Serial.print((unsigned int)b->rpm[i]);
+    }
+
+    Serial.println(" RPM");
+
+    Serial.print("\tpolls=");
+    Serial.print(s->polls);
+    Serial.print(" nack=");
+    Serial.print(s->nacks);
+    Serial.print(" timeout=");
+    Serial.print(s->timeouts);
+    Serial.print(" short=");
+    Serial.print(s->short_reads);
+    Serial.print(" latency min/avg/max=");
+    Serial.print(s->lat_min);
+    Serial.print("/");
+    Serial.print(ok > 0 ? s->lat_total / ok : 0);
+    Serial.print("/");
+    Serial.print(s->lat_max);
+    Serial.println(" us");
+
+    memset(s, 0, sizeof(*s));
+}
+
+void setup()
+{
+    Wire.begin();
+    Wire.setWireTimeout(TIMEOUT_US_, true);
+    Serial.begin(115200);
+}
+
+void loop()
+{
+    static uint32_t last_print;
+
+    /* Every board is polled on its own, so that the time each one needs to
+     * prepare its reply overlaps with the others. */
+    for (uint8_t i = 0; i < BOARD_COUNT_; i++) {
+        struct board_ *b = &boards_[i];
+
+        switch (b->state) {
+        case STATE_IDLE_:
+            request_(b, addrs_[i]);
+            break;
+        case STATE_SETTLING_:
+            if (millis() - b->sent_ms >= SETTLE_MS_) {
+                collect_(b, addrs_[i]);
+            }
             break;
         }
-        if (i == 0) {
-            continue;
-        }
-        arr[(i - 1) >> 1] |= ((i - 1) & 1) ? (c << 8) : c;
     }
 
-    Serial.println("Fan\tSpeed");
+    if (millis() - last_print >= STATS_INTERVAL_MS_) {
+        last_print = millis();
 
-    for (uint8_t i = 0; i < 8; i++) {
-        Serial.print((unsigned int)i);
-        Serial.print("\t");
-        Serial.print((unsigned int)arr[i]);
-        Serial.println(" RPM");
-    }
+        for (uint8_t i = 0; i < BOARD_COUNT_; i++) {
+            print_board_(&boards_[i], addrs_[i]);
+        }
 
-    Serial.println();
+        Serial.println();
+    }
 }
@@ -1,37 +1,174 @@
 #include <Arduino.h>
 #include <Wire.h>
+#include <avr/pgmspace.h>
 
 #define R_25 (10000UL)
 
-static uint32_t read_temp_(void)
+/* Number of ADC samples summed into one reading. The sum is used directly as
+ * an ADC code with 4 extra bits of resolution. */
+#define OVERSAMPLE_ (16)
+
+/* One table entry per 16 ADC codes, which is 256 units of the oversampled
+ * code */
+#define LUT_SHIFT_ (8)
+
+static const uint8_t pins_[] = {A0, A1, A2, A3, A4, A5};
+
+#define CHANNELS_ (sizeof(pins_) / sizeof(pins_[0]))
+
+/**
+ * @brief Register map served over I2C. A master writes a single byte offset
+ * into the map, and then reads from that offset up to the end of the map
+ * using a repeated start. A read without an offset starts at 0, which keeps
+ * the first 4 bytes compatible with the old single-channel reply.
+ */
+struct __attribute__((packed)) regs_ {
+    /* Temperature of each channel in mC */
+    int32_t temp[CHANNELS_];
+    /* Incremented every time all channels have been sampled */
+    uint32_t seq;
+};
+
+/**
+ * @brief Temperature in mC for 10-bit ADC codes 0, 16, ..., 1024, using the
+ * same divider and beta model (B = 4000, R25 = 10k) that used to be evaluated
+ * at runtime:
+ *
+ *   V = code * 5000 / 1024, R = (5000 - V) * R25 / V
+ *   T = 4000 * 298 / (4000 + 298 * ln(R / R25)) - 273
+ *
+ * The end points are evaluated at codes 1 and 1023, as the model is undefined
+ * at the rails.
+ */
+static const int32_t lut_[] PROGMEM = {
+    -78381, -45308, -35731, -29644,
+    -25055, -21312, -18114, -15298,
+    -12732, -10415, -8268, -6258,
+    -4360, -2556, -830, 831,
+    2454, 4011, 5526, 7006,
+    8457, 9884, 11291, 12681,
+    14075, 15442, 16802, 18160,
+    19515, 20871, 22234, 23604,
+    25000, 26394, 27801, 29227,
+    30679, 32151, 33656, 35196,
+    36789, 38410, 40078, 41801,
+    43588, 45445, 47383, 49406,
+    51567, 53824, 56222, 58776,
+    61530, 64519, 67801, 71420,
+    75538, 80181, 85595, 92118,
+    100299, 111135, 127271, 157679,
+    340961,
+};
+
+/* Registers being filled by the sampler, and the last complete set that is
+ * shared with the I2C handlers */
+static struct regs_ next_;
+static volatile struct regs_ regs_;
+static volatile uint8_t pointer_;
+
+/**
+ * @brief Convert the oversampled ADC code @p code to a temperature in mC,
+ * interpolating linearly between the two closest table entries
+ */
+static int32_t code_to_temp_(uint16_t code)
 {
-    uint32_t voltage, resistance, temp;
+    uint8_t index = code >> LUT_SHIFT_;
+    int32_t frac = code & ((1 << LUT_SHIFT_) - 1);
+    int32_t lo = pgm_read_dword(&lut_[index]);
+    int32_t hi = pgm_read_dword(&lut_[index + 1]);
+
+    return lo + ((hi - lo) * frac) / (1 << LUT_SHIFT_);
+}
+
+/**
+ * @brief Take one ADC sample of the current channel. Once a channel has enough
+ * samples the sampler moves on to the next, and once every channel has been
+ * converted the new set is published.
+ */
+static void sample_(void)
+{
+    static uint16_t sum;
+    static uint8_t samples;
+    static uint8_t channel;
+
+    uint16_t code = analogRead(pins_[channel]);
+
+    /* The first conversion after switching channel is discarded, to give the
+     * sample and hold capacitor time to settle */
+    if (samples++ == 0) {
+        return;
+    }
+
+    sum += code;
+
+    if (samples <= OVERSAMPLE_) {
+        return;
+    }
 
-    voltage = (analogRead(A0) * 5000UL) >> 10;
-    resistance = ((5000 - voltage) * R_25) / voltage;
+    next_.temp[channel] = code_to_temp_(sum);
 
-    /* Temperature in mC */
-    temp = 1000UL;
-    temp *= 4000UL * 298 / (4000 + 298 * (log(resistance) - log(R_25)));
-    temp -= 273000;
+    sum = 0;
+    samples = 0;
 
-    return temp;
+    if (++channel < CHANNELS_) {
+        return;
+    }
+
+    channel = 0;
+    next_.seq++;
+
+    noInterrupts();
+    memcpy((void *)&regs_, &next_, sizeof(next_));
+    interrupts();
+}
+
+void receiveEvent(int len)
+{
+    if (len > 0) {
+        pointer_ = Wire.read();
+    }
+
+    /* Only the offset is writable */
+    while (Wire.available()) {
+        (void)Wire.read();
+    }
 }
 
 void requestEvent()
 {
-    uint32_t temp = read_temp_();
-    Serial.println(temp);
+    /* Runs in interrupt context, so the registers can be read directly */
+    uint8_t pointer = pointer_ < sizeof(regs_) ? pointer_ : 0;
+
+    Wire.write((uint8_t *)&regs_ + pointer, sizeof(regs_) - pointer);
 
-    Wire.write((uint8_t *)&temp, sizeof(temp));
+    pointer_ = 0;
 }
 
 void setup()
 {
-    pinMode(A0, INPUT);
+    for (uint8_t i = 0; i < CHANNELS_; i++) {
+        pinMode(pins_[i], INPUT);
+    }
 
     Wire.begin(5);
+    Wire.onReceive(receiveEvent);
     Wire.onRequest(requestEvent);
     Serial.begin(9600);
 }
-void loop() { delay(2000); }
+
+void loop()
+{
+    static uint32_t last_print;
+
+    sample_();
+
+    if (millis() - last_print >= 2000) {
+        last_print = millis();
+
+        noInterrupts();
+        int32_t temp = regs_.temp[0];
+        interrupts();
+
+        Serial.println(temp);
+    }
+}
@@ -0,0 +1,265 @@
+/* Benchmark of the tacho measurement against the simulated fans.
+ *
+ * Build and run from the repository root with:
+ *
+ *   cc -std=gnu11 -O2 -DF_CPU=4000000UL -Isim/include -Isim -Isrc \
+ *       -o fanbench sim/bench.c sim/fanmodel.c sim/sim.c sim/usart.c \
+ *       $(ls src/[!m]*.c) src/drivers/i2c.c -lm
+ *   ./fanbench [seed]
+ *
+ * Every scenario settles the fans, applies a step in duty cycle, and samples
+ * the true speed of each fan along with the speed reported by each
+ * measurement algorithm every 100 ms. For each fan and algorithm it reports:
+ *
+ *   settle  Time from the step until the reported speed stays within 5% of
+ *           the true steady state speed, "-" if it never does
+ *   over    Overshoot of the reported speed above the steady state speed
+ *   error   Mean absolute error of the reported speed against the true speed
+ *           over the last 10 seconds
+ *
+ * The stall scenario instead reports how long the firmware takes to flag a
+ * locked rotor.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "fan.h"
+#include "fanmodel.h"
+#include "fanstats.h"
+#include "fault.h"
+#include "sim.h"
+
+#define SAMPLE_HZ_ (10)
+#define SETTLE_S_ (20)
+#define OBSERVE_S_ (40)
+#define ERROR_S_ (10)
+#define BAND_ (0.05)
+
+#define SAMPLES_ (OBSERVE_S_ * SAMPLE_HZ_)
+
+/**
+ * @brief Speed measurement algorithm under test
+ */
+struct algo_ {
+        const char* name;
+        double (*rpm)(uint8_t fan_index);
+};
+
+/* Speed of the last capture of each measurement window */
+static double capture_rpm_(uint8_t fan_index)
+{
+        return fan_get_speed(fan_index);
+}
+
+/* Running mean of every capture since the step */
+static double mean_rpm_(uint8_t fan_index)
+{
+        struct fanstats s;
+
+        fanstats_get(fan_index, &s);
+
+        return s.mean;
+}
+
+static const struct algo_ algos_[] = {
+    {"capture", capture_rpm_},
+    {"mean", mean_rpm_},
+};
+
+#define ALGO_COUNT_ (sizeof(algos_) / sizeof(algos_[0]))
+
+/**
+ * @brief Fault injected into every fan before a scenario starts
+ */
+struct scenario_ {
+        const char* name;
+        double noise_rate;
+        double drop_prob;
+};
+
+static const struct scenario_ scenarios_[] = {
+    {"nominal", 0.0, 0.0},
+    {"noisy", 20.0, 0.0},
+    {"dropped", 0.0, 0.1},
+};
+
+static double true_rpm_[FAN_COUNT][SAMPLES_];
+static double algo_rpm_[ALGO_COUNT_][FAN_COUNT][SAMPLES_];
+
+static FILE* out_;
+
+static void set_all_(const char* speed)
+{
+        for (uint8_t i = 0; i < FAN_COUNT; i++) {
+                fan_set_speed(i, speed);
+        }
+}
+
+/**
+ * @brief Print the metrics of algorithm @p a for fan @p fan_index, with
+ * @p final the true steady state speed after the step
+ */
+static void report_(size_t a, uint8_t fan_index, double final)
+{
+        const double* rpm = algo_rpm_[a][fan_index];
+        size_t settled = 0;
+        double peak = 0.0;
+        double error = 0.0;
+
+        for (size_t i = 0; i < SAMPLES_; i++) {
+                if (fabs(rpm[i] - final) > BAND_ * final) {
+                        settled = i + 1;
+                }
+                if (rpm[i] > peak) {
+                        peak = rpm[i];
+                }
+        }
+
+        for (size_t i = SAMPLES_ - ERROR_S_ * SAMPLE_HZ_; i < SAMPLES_; i++) {
+                double truth = true_rpm_[fan_index][i];
+
+                error += fabs(rpm[i] - truth) / truth;
+        }
+
+        error /= ERROR_S_ * SAMPLE_HZ_;
+
+        (void)fprintf(out_, "  %-8s %3u ", algos_[a].name, fan_index);
+
+        if (settled < SAMPLES_) {
+                (void)fprintf(
+                    out_, "%7.1fs", settled / (double)SAMPLE_HZ_
+                );
+        } else {
+                (void)fprintf(out_, "%8s", "-");
+        }
+
+        (void)fprintf(
+            out_, " %7.1f%% %7.1f%%\n",
+            peak > final ? 100.0 * (peak - final) / final : 0.0,
+            100.0 * error
+        );
+}
+
+/**
+ * @brief Run scenario @p s: settle at low speed, step to max and record the
+ * response
+ */
+static void run_step_(const struct scenario_* s, uint32_t seed)
+{
+        sim_init(seed);
+
+        for (uint8_t i = 0; i < FAN_COUNT; i++) {
+                fanmodel_fan(i)->noise_rate = s->noise_rate;
+                fanmodel_fan(i)->drop_prob = s->drop_prob;
+        }
+
+        sim_run((uint64_t)SETTLE_S_ * F_CPU);
+
+        set_all_("max");
+        fanstats_reset();
+
+        for (size_t n = 0; n < SAMPLES_; n++) {
+                sim_run(F_CPU / SAMPLE_HZ_);
+
+                for (uint8_t i = 0; i < FAN_COUNT; i++) {
+                        true_rpm_[i][n] = fanmodel_fan(i)->rpm;
+
+                        for (size_t a = 0; a < ALGO_COUNT_; a++) {
+                                algo_rpm_[a][i][n] = algos_[a].rpm(i);
+                        }
+                }
+        }
+
+        (void)fprintf(out_, "%s:\n", s->name);
+        (void)fprintf(
+            out_, "  %-8s %3s %8s %8s %8s\n", "algo", "fan", "settle", "over",
+            "error"
+        );
+
+        for (size_t a = 0; a < ALGO_COUNT_; a++) {
+                for (uint8_t i = 0; i < FAN_COUNT; i++) {
+                        report_(a, i, fanmodel_target(i, sim_fan_duty(i)));
+                }
+        }
+}
+
+/**
+ * @brief Lock the rotor of fan 0 at full speed, and measure the time until it
+ * is flagged as stalled
+ */
+static void run_stall_(uint32_t seed)
+{
+        sim_init(seed);
+
+        set_all_("max");
+        sim_run((uint64_t)SETTLE_S_ * F_CPU);
+
+        fanmodel_fan(0)->stall = true;
+
+        double start = sim_seconds();
+
+        while (!(fault_get(0) & FAULT_STALL) &&
+               sim_seconds() - start < OBSERVE_S_) {
+                sim_run(F_CPU / 1000);
+        }
+
+        (void)fprintf(out_, "stall:\n");
+
+        if (fault_get(0) & FAULT_STALL) {
+                (void)fprintf(
+                    out_, "  detected after %.2fs\n", sim_seconds() - start
+                );
+        } else {
+                (void)fprintf(
+                    out_, "  not detected within %ds\n", OBSERVE_S_
+                );
+        }
+}
+
+/**
+ * @brief Run @p fn in a child process, as the firmware state can not be reset
+ * between scenarios
+ */
+static void fork_(void (*fn)(const struct scenario_*, uint32_t),
+                  const struct scenario_* s, uint32_t seed)
+{
+        (void)fflush(out_);
+
+        pid_t pid = fork();
+
+        if (pid == 0) {
+                fn(s, seed);
+                (void)fflush(out_);
+                _exit(0);
+        }
+
+        (void)waitpid(pid, NULL, 0);
+}
+
+static void stall_(const struct scenario_* s, uint32_t seed)
+{
+        (void)s;
+
+        run_stall_(seed);
+}
+
+int main(int argc, char** argv)
+{
+        uint32_t seed = argc > 1 ? strtoul(argv[1], NULL, 0) : 1;
+
+        /* The simulator takes over stdout for the console */
+        out_ = stdout;
+
+        for (size_t i = 0; i < sizeof(scenarios_) / sizeof(scenarios_[0]);
+             i++) {
+                fork_(run_step_, &scenarios_[i], seed);
+        }
+
+        fork_(stall_, NULL, seed);
+
+        return 0;
+}
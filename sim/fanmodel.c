@@ -0,0 +1,107 @@
+#include <math.h>
+#include <string.h>
+
+#include "fan.h"
+#include "fanmodel.h"
+
+/* Nominal duty to speed curve. The preset duty cycles of the firmware end up
+ * as compare values 3, 6 and 9 out of a period of 10, and land on the speeds
+ * from the fan datasheet. */
+static const struct {
+        double duty;
+        double rpm;
+} curve_[] = {
+    {0.0, 0.0}, {0.3, 3500.0}, {0.6, 8000.0}, {0.9, 13100.0}, {1.0, 13800.0},
+};
+
+static struct fanmodel_fan fans_[FAN_COUNT];
+static uint32_t rand_state_;
+
+/**
+ * @brief Uniform random number in [0, 1), from a xorshift generator so runs
+ * are reproducible across hosts
+ */
+static double rand_(void)
+{
+        rand_state_ ^= rand_state_ << 13;
+        rand_state_ ^= rand_state_ >> 17;
+        rand_state_ ^= rand_state_ << 5;
+
+        return (rand_state_ >> 8) / (double)(1 << 24);
+}
+
+void fanmodel_init(uint32_t seed, double variance)
+{
+        rand_state_ = seed ? seed : 1;
+
+        (void)memset(fans_, 0, sizeof(fans_));
+
+        for (uint8_t i = 0; i < FAN_COUNT; i++) {
+                fans_[i].gain = 1.0 + variance * (2.0 * rand_() - 1.0);
+                fans_[i].tau_up = 1.2;
+                fans_[i].tau_down = 2.5;
+                fans_[i].ppr = 2;
+        }
+}
+
+struct fanmodel_fan* fanmodel_fan(uint8_t fan_index)
+{
+        return &fans_[fan_index];
+}
+
+double fanmodel_target(uint8_t fan_index, double duty)
+{
+        size_t n = sizeof(curve_) / sizeof(curve_[0]);
+
+        if (fans_[fan_index].stall || duty <= 0.0) {
+                return 0.0;
+        }
+
+        for (size_t i = 1; i < n; i++) {
+                if (duty <= curve_[i].duty) {
+                        double frac = (duty - curve_[i - 1].duty) /
+                                      (curve_[i].duty - curve_[i - 1].duty);
+                        double rpm = curve_[i - 1].rpm +
+                                     frac * (curve_[i].rpm - curve_[i - 1].rpm);
+
+                        return rpm * fans_[fan_index].gain;
+                }
+        }
+
+        return curve_[n - 1].rpm * fans_[fan_index].gain;
+}
+
+void fanmodel_advance(
+    uint8_t fan_index, double duty, double t, double dt, fanmodel_edge_fn edge
+)
+{
+        struct fanmodel_fan* f = &fans_[fan_index];
+        double target = fanmodel_target(fan_index, duty);
+        double tau = target > f->rpm ? f->tau_up : f->tau_down;
+
+        /* First order response, evaluated exactly over the step */
+        f->rpm = target + (f->rpm - target) * exp(-dt / tau);
+
+        if (f->stall) {
+                f->rpm = 0.0;
+        }
+
+        double rate = f->rpm / 60.0 * f->ppr;
+        double end = f->phase + rate * dt;
+
+        /* Every whole period crossed is one edge, placed by interpolating
+         * within the step */
+        for (double k = floor(f->phase) + 1.0; k <= end; k += 1.0) {
+                if (f->drop_prob > 0.0 && rand_() < f->drop_prob) {
+                        continue;
+                }
+
+                edge(fan_index, t + (k - f->phase) / rate);
+        }
+
+        f->phase = end - floor(end);
+
+        if (f->noise_rate > 0.0 && rand_() < f->noise_rate * dt) {
+                edge(fan_index, t + rand_() * dt);
+        }
+}
@@ -0,0 +1,76 @@
+/* Physical model of the fans attached to the simulated board */
+#ifndef FANMODEL_H__
+#define FANMODEL_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct fanmodel_fan {
+        /* Scale of this fan's duty to speed curve relative to nominal */
+        double gain;
+        /* Time constants of spin-up and spin-down, in seconds */
+        double tau_up;
+        double tau_down;
+        /* Tacho pulses per revolution */
+        uint8_t ppr;
+        /* True speed, in RPM */
+        double rpm;
+        /* Fraction of the current tacho period elapsed */
+        double phase;
+
+        /* Injectable faults */
+        /* Rotor is locked, and produces no edges */
+        bool stall;
+        /* Rate of spurious edges, per second */
+        double noise_rate;
+        /* Probability that an edge is lost */
+        double drop_prob;
+};
+
+/**
+ * @brief Edge callback, called with the fan index and the time of the edge in
+ * seconds
+ */
+typedef void (*fanmodel_edge_fn)(uint8_t fan_index, double t);
+
+/**
+ * @brief Reset every fan to standstill, with per-fan curve variance of
+ * +- @p variance around the nominal curve
+ *
+ * @param seed
+ * @param variance
+ */
+void fanmodel_init(uint32_t seed, double variance);
+
+/**
+ * @brief Get the model of fan @p fan_index
+ *
+ * @param fan_index
+ * @return struct fanmodel_fan*
+ */
+struct fanmodel_fan* fanmodel_fan(uint8_t fan_index);
+
+/**
+ * @brief Steady state speed of fan @p fan_index at duty cycle @p duty
+ *
+ * @param fan_index
+ * @param duty 0-1
+ * @return double Speed in RPM
+ */
+double fanmodel_target(uint8_t fan_index, double duty);
+
+/**
+ * @brief Advance fan @p fan_index from time @p t by @p dt seconds at duty
+ * cycle @p duty, calling @p edge for every tacho edge produced
+ *
+ * @param fan_index
+ * @param duty
+ * @param t
+ * @param dt
+ * @param edge
+ */
+void fanmodel_advance(
+    uint8_t fan_index, double duty, double t, double dt, fanmodel_edge_fn edge
+);
+
+#endif /* FANMODEL_H__ */
@@ -0,0 +1,16 @@
+/* Host stand-in for avr/eeprom.h, backed by an array in sim.c */
+#ifndef SIM_AVR_EEPROM_H__
+#define SIM_AVR_EEPROM_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <avr/io.h>
+
+uint8_t eeprom_read_byte(const uint8_t* addr);
+void eeprom_read_block(void* dst, const void* src, size_t size);
+void eeprom_update_byte(uint8_t* addr, uint8_t value);
+void eeprom_update_block(const void* src, void* dst, size_t size);
+void eeprom_busy_wait(void);
+
+#endif /* SIM_AVR_EEPROM_H__ */
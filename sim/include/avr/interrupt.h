@@ -0,0 +1,20 @@
+/* Host stand-in for avr/interrupt.h. Interrupt handlers become plain
+ * functions that the simulator calls between main loop iterations, so global
+ * interrupt masking has nothing to protect against. */
+#ifndef SIM_AVR_INTERRUPT_H__
+#define SIM_AVR_INTERRUPT_H__
+
+#include <avr/io.h>
+
+#define ISR(vector) void vector(void)
+
+#define cli() ((void)0)
+#define sei() ((void)0)
+
+ISR(TCB0_INT_vect);
+ISR(TWI0_TWIS_vect);
+ISR(TWI1_TWIS_vect);
+ISR(RTC_CNT_vect);
+ISR(NVMCTRL_EE_vect);
+
+#endif /* SIM_AVR_INTERRUPT_H__ */
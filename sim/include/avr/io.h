@@ -0,0 +1,197 @@
+/* Host stand-in for the AVR128DB48 register file.
+ *
+ * Only the peripherals and bits used by the firmware are declared. Registers
+ * are plain memory defined in sim.c, and the simulator reacts to them between
+ * main loop iterations. Bit values match the device header.
+ */
+#ifndef SIM_AVR_IO_H__
+#define SIM_AVR_IO_H__
+
+#include <stdint.h>
+
+typedef volatile uint8_t register8_t;
+typedef volatile uint16_t register16_t;
+typedef volatile uint32_t register32_t;
+
+typedef struct {
+        register8_t CTRLA, CTRLB, CTRLC, CTRLD, CTRLECLR, CTRLESET, CTRLFCLR,
+            CTRLFSET, EVCTRL, INTCTRL, INTFLAGS, DBGCTRL, TEMP;
+        register8_t LCNT, HCNT, LPER, HPER, LCMP0, HCMP0, LCMP1, HCMP1, LCMP2,
+            HCMP2;
+} TCA_SPLIT_t;
+
+typedef union {
+        TCA_SPLIT_t SPLIT;
+} TCA_t;
+
+typedef struct {
+        register8_t CTRLA, CTRLB, EVCTRL, INTCTRL, INTFLAGS, STATUS, DBGCTRL,
+            TEMP;
+        register16_t CNT, CCMP;
+} TCB_t;
+
+typedef struct {
+        register8_t CTRLA, DUALCTRL, DBGCTRL, MCTRLA, MCTRLB, MSTATUS, MBAUD,
+            MADDR, MDATA, SCTRLA, SCTRLB, SSTATUS, SADDR, SADDRMASK, SDATA;
+} TWI_t;
+
+typedef struct {
+        register8_t RXDATAL, RXDATAH, TXDATAL, TXDATAH, STATUS, CTRLA, CTRLB,
+            CTRLC;
+        register16_t BAUD;
+        register8_t CTRLD, DBGCTRL, EVCTRL, TXPLCTRL, RXPLCTRL;
+} USART_t;
+
+typedef struct {
+        register8_t DIR, DIRSET, DIRCLR, DIRTGL, OUT, OUTSET, OUTCLR, OUTTGL,
+            IN, INTFLAGS, PORTCTRL, PINCONFIG, PINCTRLUPD, PINCTRLSET,
+            PINCTRLCLR;
+        register8_t PIN0CTRL, PIN1CTRL, PIN2CTRL, PIN3CTRL, PIN4CTRL, PIN5CTRL,
+            PIN6CTRL, PIN7CTRL;
+} PORT_t;
+
+typedef struct {
+        register8_t SWEVENTA, SWEVENTB;
+        register8_t CHANNEL0, CHANNEL1, CHANNEL2, CHANNEL3, CHANNEL4, CHANNEL5,
+            CHANNEL6, CHANNEL7, CHANNEL8, CHANNEL9;
+        register8_t USERTCB0CAPT, USERTCB1CAPT, USERTCB2CAPT, USERTCB3CAPT;
+} EVSYS_t;
+
+typedef struct {
+        register8_t EVSYSROUTEA, CCLROUTEA, USARTROUTEA, USARTROUTEB,
+            SPIROUTEA, TWIROUTEA, TCAROUTEA, TCBROUTEA, TCDROUTEA, ACROUTEA,
+            ZCDROUTEA;
+} PORTMUX_t;
+
+typedef struct {
+        register8_t RSTFR, SWRR;
+} RSTCTRL_t;
+
+typedef struct {
+        register8_t CTRLA, CTRLB, STATUS, INTCTRL, INTFLAGS;
+} NVMCTRL_t;
+
+typedef struct {
+        register8_t CTRLA, STATUS, INTCTRL, INTFLAGS, TEMP, DBGCTRL, CALIB,
+            CLKSEL;
+        register16_t CNT, PER, CMP;
+} RTC_t;
+
+typedef struct {
+        register8_t CTRLA, STATUS, LVL0PRI, LVL1VEC;
+} CPUINT_t;
+
+extern TCA_t TCA0, TCA1;
+extern TCB_t TCB0, TCB1, TCB2, TCB3;
+extern TWI_t TWI0, TWI1;
+extern USART_t USART0, USART1, USART2, USART3, USART4;
+extern PORT_t PORTA, PORTB, PORTC, PORTD, PORTE, PORTF;
+extern EVSYS_t EVSYS;
+extern PORTMUX_t PORTMUX;
+extern RSTCTRL_t RSTCTRL;
+extern NVMCTRL_t NVMCTRL;
+extern RTC_t RTC;
+extern CPUINT_t CPUINT;
+extern register8_t SREG;
+
+#define PIN0_bm 0x01
+#define PIN1_bm 0x02
+#define PIN2_bm 0x04
+#define PIN3_bm 0x08
+#define PIN4_bm 0x10
+#define PIN5_bm 0x20
+#define PIN6_bm 0x40
+#define PIN7_bm 0x80
+
+#define PORT_PULLUPEN_bm 0x08
+
+#define TCA_SPLIT_SPLITM_bm 0x01
+#define TCA_SPLIT_LCMP0EN_bm 0x01
+#define TCA_SPLIT_LCMP1EN_bm 0x02
+#define TCA_SPLIT_LCMP2EN_bm 0x04
+#define TCA_SPLIT_HCMP0EN_bm 0x10
+#define TCA_SPLIT_HCMP1EN_bm 0x20
+#define TCA_SPLIT_HCMP2EN_bm 0x40
+#define TCA_SPLIT_CLKSEL_DIV16_gc 0x08
+#define TCA_SPLIT_ENABLE_bm 0x01
+#define PORTMUX_TCA0_PORTD_gc 0x03
+#define PORTMUX_TCA1_PORTB_gc 0x00
+
+#define TCB_ENABLE_bm 0x01
+#define TCB_CLKSEL_DIV1_gc 0x00
+#define TCB_CLKSEL_DIV2_gc 0x02
+#define TCB_CNTMODE_INT_gc 0x00
+#define TCB_CNTMODE_FRQ_gc 0x03
+#define TCB_CCMPEN_bm 0x10
+#define TCB_CAPTEI_bm 0x01
+#define TCB_CAPT_bm 0x01
+#define TCB_OVF_bm 0x02
+
+#define EVSYS_USER_CHANNEL2_gc 0x03
+#define EVSYS_CHANNEL2_PORTC_PIN0_gc 0x40
+#define EVSYS_CHANNEL2_PORTC_PIN1_gc 0x41
+#define EVSYS_CHANNEL2_PORTC_PIN2_gc 0x42
+#define EVSYS_CHANNEL2_PORTC_PIN3_gc 0x43
+#define EVSYS_CHANNEL2_PORTC_PIN4_gc 0x44
+#define EVSYS_CHANNEL2_PORTC_PIN5_gc 0x45
+#define EVSYS_CHANNEL2_PORTC_PIN6_gc 0x46
+#define EVSYS_CHANNEL2_PORTC_PIN7_gc 0x47
+#define EVSYS_CHANNEL2_PORTD_PIN0_gc 0x48
+
+#define TWI_DBGRUN_bm 0x01
+#define TWI_ENABLE_bm 0x01
+#define TWI_RIF_bm 0x80
+#define TWI_WIF_bm 0x40
+#define TWI_CLKHOLD_bm 0x20
+#define TWI_RXACK_bm 0x10
+#define TWI_ARBLOST_bm 0x08
+#define TWI_COLL_bm 0x08
+#define TWI_BUSERR_bm 0x04
+#define TWI_DIR_bm 0x02
+#define TWI_AP_bm 0x01
+#define TWI_BUSSTATE_gm 0x03
+#define TWI_BUSSTATE_IDLE_gc 0x01
+#define TWI_DIF_bm 0x80
+#define TWI_APIF_bm 0x40
+#define TWI_AP_ADR_gc 0x01
+#define TWI_DIEN_bm 0x80
+#define TWI_APIEN_bm 0x40
+#define TWI_PIEN_bm 0x20
+#define TWI_PMEN_bm 0x04
+#define TWI_SMEN_bm 0x02
+#define TWI_MCMD_REPSTART_gc 0x01
+#define TWI_MCMD_RECVTRANS_gc 0x02
+#define TWI_MCMD_STOP_gc 0x03
+#define TWI_ACKACT_ACK_gc 0x00
+#define TWI_ACKACT_NACK_gc 0x04
+#define TWI_SCMD_COMPTRANS_gc 0x02
+#define TWI_SCMD_RESPONSE_gc 0x03
+
+#define USART_RXCIF_bm 0x80
+#define USART_TXCIF_bm 0x40
+#define USART_DREIF_bm 0x20
+#define USART_RXCIE_bm 0x80
+#define USART_RXEN_bm 0x80
+#define USART_TXEN_bm 0x40
+#define USART_RS485_bm 0x01
+
+#define RSTCTRL_SWRST_bm 0x01
+
+#define NVMCTRL_EEREADY_bm 0x01
+#define NVMCTRL_EEBUSY_bm 0x02
+
+#define RTC_RTCEN_bm 0x01
+#define RTC_PRESCALER_DIV1_gc 0x00
+#define RTC_CLKSEL_OSC32K_gc 0x00
+#define RTC_CTRLABUSY_bm 0x01
+#define RTC_CNTBUSY_bm 0x02
+#define RTC_PERBUSY_bm 0x04
+#define RTC_OVF_bm 0x01
+
+#define EEPROM_START 0x1400
+#define EEPROM_SIZE 512
+
+#define TCB0_INT_vect_num 14
+#define TWI0_TWIS_vect_num 21
+
+#endif /* SIM_AVR_IO_H__ */
@@ -0,0 +1,8 @@
+/* Host stand-in for util/delay.h */
+#ifndef SIM_UTIL_DELAY_H__
+#define SIM_UTIL_DELAY_H__
+
+#define _delay_ms(ms) ((void)(ms))
+#define _delay_us(us) ((void)(us))
+
+#endif /* SIM_UTIL_DELAY_H__ */
@@ -0,0 +1,400 @@
+/* End-to-end latency benchmark of the I2C command interface.
+ *
+ * A virtual bus master sends commands to the firmware's I2C slave and polls
+ * for the reply, while a virtual console client sends shell commands whose
+ * output keeps the firmware busy writing to the USART. The latency of a
+ * command is the time from the master starting to send it until it holds the
+ * complete reply.
+ *
+ * Build and run from the repository root with:
+ *
+ *   cc -std=gnu11 -O2 -DF_CPU=4000000UL -Isim/include -Isim -Isrc \
+ *       -o latbench sim/latbench.c sim/fanmodel.c sim/sim.c sim/twimaster.c \
+ *       sim/usart.c $(ls src/[!m]*.c) src/drivers/i2c.c -lm
+ *   ./latbench [-r <cmds/s>] [-u <lines/s>] [-t <seconds>]
+ *       [-m <cmd>=<weight>,...] [-b <bus Hz>] [-l <loop cycles>] [-0]
+ *
+ * Commands are picked at random from the mix given with -m, which defaults to
+ * "report=1". A rate of 0 sends the next command as soon as the previous one
+ * has completed. The output lists, for each command, the number completed,
+ * dropped (no complete reply within the timeout, or a corrupted reply) and
+ * NACKed, and latency percentiles.
+ *
+ * It also shows the firmware's histogram of tacho capture latency under this
+ * load, and the number of captures lost by being serviced too late. With -0
+ * the capture interrupt is left at level 0, next to the communication
+ * handlers, for comparison.
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <avr/io.h>
+
+#include "fan.h"
+#include "sim.h"
+#include "twimaster.h"
+#include "zone.h"
+
+/* Give up on a reply after this long */
+#define TIMEOUT_MS_ (2000)
+/* Time between polls for a reply */
+#define POLL_MS_ (1)
+/* Time the firmware is given to boot before the first command */
+#define BOOT_MS_ (100)
+
+#define MS_ (F_CPU / 1000)
+
+#define LINE_ "fanspeed\r"
+
+struct cmd_ {
+        const char* name;
+        uint8_t id;
+        size_t reply_len;
+        /* Expected reply, NULL if it can not be known in advance */
+        const char* reply;
+
+        uint32_t weight;
+
+        uint32_t done;
+        uint32_t drops;
+        uint32_t nacks;
+        uint32_t* latency;
+};
+
+static struct cmd_ cmds_[] = {
+    {"report", 0x0, 2 * FAN_COUNT, NULL},
+    {"hello", 0x1, 4, "hey"},
+    {"faults", 0x2, 7 * FAN_COUNT, NULL},
+    {"zones", 0x4, 6 * ZONE_COUNT, NULL},
+};
+
+#define CMD_COUNT_ (sizeof(cmds_) / sizeof(cmds_[0]))
+
+static struct {
+        uint8_t addr;
+        uint64_t period;
+        uint64_t uart_period;
+
+        bool polling;
+        struct cmd_* cmd;
+        uint64_t issued;
+        uint64_t next;
+        uint64_t next_line;
+        uint32_t polls;
+        uint32_t rand;
+} bench_;
+
+static FILE* out_;
+
+static uint32_t rand_(void)
+{
+        bench_.rand ^= bench_.rand << 13;
+        bench_.rand ^= bench_.rand >> 17;
+        bench_.rand ^= bench_.rand << 5;
+
+        return bench_.rand;
+}
+
+static struct cmd_* pick_(void)
+{
+        uint32_t total = 0;
+
+        for (size_t i = 0; i < CMD_COUNT_; i++) {
+                total += cmds_[i].weight;
+        }
+
+        uint32_t r = rand_() % total;
+
+        for (size_t i = 0;; i++) {
+                if (r < cmds_[i].weight) {
+                        return &cmds_[i];
+                }
+
+                r -= cmds_[i].weight;
+        }
+}
+
+/**
+ * @brief Record the latency of a completed command, in us
+ */
+static void record_(struct cmd_* c, uint64_t cycles)
+{
+        if ((c->done & (c->done - 1)) == 0) {
+                uint32_t* latency = realloc(
+                    c->latency, (c->done ? 2 * c->done : 1) * sizeof(uint32_t)
+                );
+
+                if (latency == NULL) {
+                        (void)fprintf(stderr, "Out of memory\n");
+                        exit(1);
+                }
+
+                c->latency = latency;
+        }
+
+        c->latency[c->done++] = (uint32_t)(cycles / (F_CPU / 1000000));
+}
+
+static void finish_(uint64_t now)
+{
+        bench_.polling = false;
+        bench_.next = bench_.issued + bench_.period > now
+                          ? bench_.issued + bench_.period
+                          : now;
+}
+
+static void send_(uint64_t now)
+{
+        struct cmd_* c = pick_();
+        uint8_t packet[] = {c->id, 0};
+
+        bench_.cmd = c;
+        bench_.issued = now;
+
+        ptrdiff_t sent = twimaster_write(bench_.addr, packet, sizeof(packet));
+        uint64_t end = now + twimaster_cycles(sizeof(packet));
+
+        if (sent != sizeof(packet)) {
+                c->nacks++;
+                finish_(end);
+
+                return;
+        }
+
+        bench_.polling = true;
+        bench_.next = end + POLL_MS_ * MS_;
+}
+
+static void poll_(uint64_t now)
+{
+        struct cmd_* c = bench_.cmd;
+        uint8_t buf[64];
+
+        ptrdiff_t len = twimaster_read(bench_.addr, buf, c->reply_len);
+        uint64_t end = now + twimaster_cycles(len > 0 ? len : 0);
+
+        bench_.polls++;
+
+        if (len < 0) {
+                c->nacks++;
+                finish_(end);
+        } else if (len == 0) {
+                /* Reply not ready yet */
+                if (end - bench_.issued > TIMEOUT_MS_ * MS_) {
+                        c->drops++;
+                        finish_(end);
+                } else {
+                        bench_.next = end + POLL_MS_ * MS_;
+                }
+        } else if ((size_t)len < c->reply_len ||
+                   (c->reply != NULL &&
+                    memcmp(buf, c->reply, c->reply_len) != 0)) {
+                c->drops++;
+                finish_(end);
+        } else {
+                record_(c, end - bench_.issued);
+                finish_(end);
+        }
+}
+
+/**
+ * @brief Device hook driving the virtual master and console client
+ */
+static void tick_(uint64_t now)
+{
+        while (now >= bench_.next) {
+                if (bench_.polling) {
+                        poll_(bench_.next);
+                } else {
+                        send_(bench_.next);
+                }
+        }
+
+        while (bench_.uart_period != 0 && now >= bench_.next_line) {
+                sim_usart_rx(LINE_, strlen(LINE_));
+                bench_.next_line += bench_.uart_period;
+        }
+}
+
+static int cmp_u32_(const void* a, const void* b)
+{
+        uint32_t x = *(const uint32_t*)a;
+        uint32_t y = *(const uint32_t*)b;
+
+        return x < y ? -1 : x > y;
+}
+
+static double percentile_(const struct cmd_* c, double p)
+{
+        size_t i = (size_t)(p * (c->done - 1) + 0.5);
+
+        return c->latency[i] / 1000.0;
+}
+
+static void report_(void)
+{
+        (void)fprintf(
+            out_, "%-8s %7s %6s %6s %9s %9s %9s %9s\n", "cmd", "done", "drops",
+            "nacks", "p50 ms", "p90 ms", "p99 ms", "max ms"
+        );
+
+        for (size_t i = 0; i < CMD_COUNT_; i++) {
+                struct cmd_* c = &cmds_[i];
+
+                if (c->weight == 0) {
+                        continue;
+                }
+
+                (void)fprintf(
+                    out_, "%-8s %7u %6u %6u", c->name, c->done, c->drops,
+                    c->nacks
+                );
+
+                if (c->done == 0) {
+                        (void)fprintf(out_, "\n");
+                        continue;
+                }
+
+                qsort(c->latency, c->done, sizeof(uint32_t), cmp_u32_);
+
+                (void)fprintf(
+                    out_, " %9.2f %9.2f %9.2f %9.2f\n", percentile_(c, 0.5),
+                    percentile_(c, 0.9), percentile_(c, 0.99),
+                    percentile_(c, 1.0)
+                );
+        }
+
+        (void)fprintf(
+            out_, "polls: %u, console bytes: %llu\n", bench_.polls,
+            (unsigned long long)sim_usart_tx_count()
+        );
+
+        struct fan_irq_latency lat;
+
+        fan_irq_latency(&lat);
+
+        (void)fprintf(
+            out_, "capture latency: %u captures, %u lost, max %u cycles\n",
+            lat.count, sim_lost_captures(), lat.peak
+        );
+
+        for (uint8_t i = 0; i < FAN_IRQ_BUCKETS; i++) {
+                (void)fprintf(
+                    out_, "  %s%5u: %u\n",
+                    i == FAN_IRQ_BUCKETS - 1 ? ">=" : " <",
+                    i == FAN_IRQ_BUCKETS - 1 ? 32u << (i - 1) : 32u << i,
+                    lat.hist[i]
+                );
+        }
+}
+
+/**
+ * @brief Parse command mix @p mix, a comma separated list of
+ * <name>=<weight>
+ *
+ * @return int
+ * @retval -1 Invalid mix
+ * @retval 0 Success
+ */
+static int parse_mix_(char* mix)
+{
+        for (char* tok = strtok(mix, ","); tok != NULL;
+             tok = strtok(NULL, ",")) {
+                char* eq = strchr(tok, '=');
+                size_t i = 0;
+
+                if (eq == NULL) {
+                        return -1;
+                }
+
+                *eq = 0;
+
+                for (; i < CMD_COUNT_ && strcmp(cmds_[i].name, tok) != 0;
+                     i++) {
+                }
+
+                if (i == CMD_COUNT_) {
+                        return -1;
+                }
+
+                cmds_[i].weight = strtoul(eq + 1, NULL, 0);
+        }
+
+        return 0;
+}
+
+int main(int argc, char** argv)
+{
+        char default_mix[] = "report=1";
+        char* mix = default_mix;
+        double rate = 10.0;
+        double uart_rate = 0.0;
+        double seconds = 30.0;
+        uint32_t bus = 100000;
+        uint32_t loop_cycles = 200;
+        bool level0 = false;
+        int opt;
+
+        while ((opt = getopt(argc, argv, "r:u:t:m:b:l:0")) != -1) {
+                switch (opt) {
+                case 'r':
+                        rate = atof(optarg);
+                        break;
+                case 'u':
+                        uart_rate = atof(optarg);
+                        break;
+                case 't':
+                        seconds = atof(optarg);
+                        break;
+                case 'm':
+                        mix = optarg;
+                        break;
+                case 'b':
+                        bus = strtoul(optarg, NULL, 0);
+                        break;
+                case 'l':
+                        loop_cycles = strtoul(optarg, NULL, 0);
+                        break;
+                case '0':
+                        level0 = true;
+                        break;
+                default:
+                        return 1;
+                }
+        }
+
+        if (parse_mix_(mix) != 0) {
+                (void)fprintf(stderr, "Invalid command mix\n");
+                return 1;
+        }
+
+        /* The simulator takes over stdout for the console */
+        out_ = stdout;
+
+        sim_init(1);
+        sim_set_loop_cycles(loop_cycles);
+        twimaster_set_speed(bus);
+
+        if (level0) {
+                CPUINT.LVL1VEC = 0;
+        }
+
+        bench_.addr = TWI0.SADDR >> 1;
+        bench_.rand = 1;
+        bench_.period = rate > 0.0 ? (uint64_t)(F_CPU / rate) : 0;
+        bench_.uart_period =
+            uart_rate > 0.0 ? (uint64_t)(F_CPU / uart_rate) : 0;
+        bench_.next = sim_now() + BOOT_MS_ * MS_;
+        bench_.next_line = bench_.next;
+
+        (void)sim_attach(tick_);
+
+        sim_run((uint64_t)(seconds * F_CPU));
+
+        report_();
+
+        return 0;
+}
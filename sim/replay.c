@@ -0,0 +1,321 @@
+/* Replay of a trace of peripheral input, recorded by firmware built with
+ * TRACE_ENABLE, against the simulated board.
+ *
+ * Build and run from the repository root with:
+ *
+ *   cc -std=gnu11 -O2 -DF_CPU=4000000UL -Isim/include -Isim -Isrc \
+ *       -o replay sim/replay.c sim/fanmodel.c sim/sim.c sim/usart.c \
+ *       $(ls src/[!m]*.c) src/drivers/i2c.c -lm
+ *   ./replay [-l <loop cycles>] [-t <ms after>] [-q] < trace.txt
+ *
+ * The input is the console output of the `trace` shell command, and any line
+ * that is not a record is skipped. Every record is fed to the firmware at the
+ * time it was recorded: tacho captures are latched into TCB0 in place of the
+ * fan model, TWI0 slave events are presented to the slave interrupt handler,
+ * and received bytes are queued on the console USART. The firmware then runs
+ * on for the given time after the last record, 1000 ms by default.
+ *
+ * The console output of the firmware is written to stdout, so it can be
+ * compared with the original. On stderr the replay reports every change of
+ * the measured speeds (unless -q is given), and every command written to and
+ * reply read from the I2C slave, each prefixed with the board time in ms.
+ *
+ * The `trace` command that ended the recording is replayed as well, and is
+ * rejected by the firmware of the replay, which is built without tracing.
+ * The sensor bus is not traced, so zone sensors do not answer, as elsewhere
+ * in the simulator. If records were lost before the start of the trace, the
+ * state the firmware built up from them is not reproduced.
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <avr/interrupt.h>
+#include <avr/io.h>
+
+#include "clock.h"
+#include "error.h"
+#include "fan.h"
+#include "sim.h"
+#include "trace.h"
+
+/* Estimated cycles taken by one run of the slave interrupt handler */
+#define SLAVE_ISR_CYCLES_ (250)
+/* Most bytes of one I2C transfer that are reported */
+#define MAX_TRANSFER_ (128)
+
+static struct {
+        bool quiet;
+        struct fan_snapshot last;
+
+        /* Transfer on the slave in progress */
+        bool active;
+        bool read;
+        uint8_t addr;
+        uint8_t data[MAX_TRANSFER_];
+        size_t len;
+
+        struct trace_record* trace;
+        size_t count;
+        size_t next;
+        unsigned long lost;
+
+        uint32_t records;
+        uint32_t misattributed;
+} replay_;
+
+static double ms_(void)
+{
+        return sim_seconds() * 1000.0;
+}
+
+static void report_speeds_(void)
+{
+        struct fan_snapshot snap;
+
+        fan_snapshot(&snap);
+
+        if (replay_.quiet ||
+            memcmp(snap.rpm, replay_.last.rpm, sizeof(snap.rpm)) == 0) {
+                return;
+        }
+
+        replay_.last = snap;
+
+        (void)fprintf(stderr, "%.3f rpm", ms_());
+        for (uint8_t i = 0; i < FAN_COUNT; i++) {
+                (void)fprintf(stderr, " %u", snap.rpm[i]);
+        }
+        (void)fprintf(stderr, "\n");
+}
+
+static void report_transfer_(void)
+{
+        (void)fprintf(
+            stderr, "%.3f %s 0x%02x:", ms_(), replay_.read ? "read" : "write",
+            replay_.addr
+        );
+        for (size_t i = 0; i < replay_.len; i++) {
+                (void)fprintf(stderr, " %02x", replay_.data[i]);
+        }
+        (void)fprintf(stderr, "\n");
+}
+
+static void collect_(uint8_t c)
+{
+        if (replay_.len < MAX_TRANSFER_) {
+                replay_.data[replay_.len++] = c;
+        }
+}
+
+/**
+ * @brief Present the slave event @p sstatus with the received byte @p data to
+ * TWI0, and follow the transfer it belongs to
+ */
+static void twi_(uint8_t sstatus, uint8_t data)
+{
+        TWI0.SSTATUS = sstatus;
+        TWI0.SDATA = data;
+        TWI0.SCTRLB = 0;
+
+        TWI0_TWIS_vect();
+        sim_isr_level0(SLAVE_ISR_CYCLES_);
+
+        bool acked = !(TWI0.SCTRLB & TWI_ACKACT_NACK_gc);
+
+        if (sstatus & TWI_DIF_bm) {
+                if (!(sstatus & TWI_DIR_bm)) {
+                        collect_(data);
+                } else if (!(sstatus & TWI_RXACK_bm) && acked) {
+                        collect_(TWI0.SDATA);
+                }
+        } else if (sstatus & TWI_APIF_bm) {
+                if (replay_.active) {
+                        report_transfer_();
+                }
+
+                replay_.active = (sstatus & TWI_AP_ADR_gc) && acked;
+                replay_.read = sstatus & TWI_DIR_bm;
+                replay_.addr = data >> 1;
+                replay_.len = 0;
+        }
+}
+
+/**
+ * @brief Latch the count @p count of fan @p fan_index into TCB0
+ */
+static void capture_(uint8_t fan_index, uint16_t count)
+{
+        struct fan_snapshot snap;
+
+        sim_capture(count);
+
+        /* The firmware measures the fans in turn, so a capture is credited to
+         * another fan if the replay has gone out of step with the recording */
+        fan_snapshot(&snap);
+
+        if (fan_index >= FAN_COUNT || snap.pulse[fan_index] != count) {
+                replay_.misattributed++;
+        }
+}
+
+/**
+ * @brief Feed the record @p r to the firmware
+ */
+static void feed_(const struct trace_record* r)
+{
+        switch (r->type) {
+        case TRACE_CAPTURE:
+                capture_(r->a, r->b);
+                break;
+        case TRACE_TWI:
+                if ((r->b >> 8) == 0) {
+                        twi_(r->a, r->b & 0xFF);
+                }
+                break;
+        case TRACE_RX:
+                sim_usart_rx((const char*)&r->a, 1);
+                break;
+        default:
+                return;
+        }
+
+        replay_.records++;
+}
+
+static uint64_t cycles_(const struct trace_record* r)
+{
+        return (uint64_t)r->stamp * F_CPU / CLOCK_HZ;
+}
+
+/**
+ * @brief Device feeding every record that is due. As a device it also runs
+ * while the firmware busy waits, such as on console output, so inputs arrive
+ * in the middle of it as they did when recorded.
+ */
+static void device_(uint64_t now)
+{
+        while (replay_.next < replay_.count &&
+               cycles_(&replay_.trace[replay_.next]) <= now) {
+                feed_(&replay_.trace[replay_.next++]);
+        }
+}
+
+/**
+ * @brief Read the records of the trace from @p in
+ *
+ * @return int
+ * @retval -ENOMEM Out of memory
+ * @retval 0 Success
+ */
+static int load_(FILE* in)
+{
+        char line[128];
+        size_t size = 0;
+
+        while (fgets(line, sizeof(line), in) != NULL) {
+                unsigned long stamp;
+                unsigned int type, a, b;
+                char end;
+
+                if (sscanf(line, "Trace - %lu lost", &replay_.lost) == 1) {
+                        continue;
+                }
+
+                if (sscanf(line, "%lu %u %u %u %c", &stamp, &type, &a, &b,
+                           &end) != 4 ||
+                    a > UINT8_MAX || b > UINT16_MAX) {
+                        continue;
+                }
+
+                if (replay_.count == size) {
+                        size = size ? 2 * size : 1024;
+                        replay_.trace = realloc(
+                            replay_.trace, size * sizeof(*replay_.trace)
+                        );
+
+                        if (replay_.trace == NULL) {
+                                return -E_NOMEM;
+                        }
+                }
+
+                replay_.trace[replay_.count++] =
+                    (struct trace_record){stamp, type, a, b};
+        }
+
+        return 0;
+}
+
+int main(int argc, char** argv)
+{
+        uint32_t loop_cycles = 200;
+        double after_ms = 1000.0;
+        int opt;
+
+        while ((opt = getopt(argc, argv, "l:t:q")) != -1) {
+                switch (opt) {
+                case 'l':
+                        loop_cycles = strtoul(optarg, NULL, 0);
+                        break;
+                case 't':
+                        after_ms = atof(optarg);
+                        break;
+                case 'q':
+                        replay_.quiet = true;
+                        break;
+                default:
+                        return 1;
+                }
+        }
+
+        if (load_(stdin) != 0) {
+                (void)fprintf(stderr, "Out of memory\n");
+                return 1;
+        }
+
+        /* The simulator takes over stdout for the console */
+        FILE* out = stdout;
+
+        sim_init(1);
+        sim_set_loop_cycles(loop_cycles);
+        sim_set_tacho(false);
+        sim_usart_output(out);
+        (void)sim_attach(device_);
+
+        uint64_t end = (uint64_t)(after_ms * F_CPU / 1000);
+
+        if (replay_.count > 0) {
+                end += cycles_(&replay_.trace[replay_.count - 1]);
+        }
+
+        while (sim_now() < end) {
+                sim_iteration();
+                report_speeds_();
+        }
+
+        if (replay_.active) {
+                report_transfer_();
+        }
+
+        (void)fflush(out);
+
+        if (replay_.lost != 0) {
+                (void)fprintf(
+                    stderr,
+                    "%lu records were lost before the trace, state built up "
+                    "from them is not reproduced\n",
+                    replay_.lost
+                );
+        }
+
+        (void)fprintf(
+            stderr, "%lu records replayed, %lu captures credited to another "
+            "fan than recorded\n",
+            (unsigned long)replay_.records,
+            (unsigned long)replay_.misattributed
+        );
+
+        return replay_.misattributed != 0;
+}
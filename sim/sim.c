@@ -0,0 +1,433 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <avr/eeprom.h>
+#include <avr/interrupt.h>
+#include <avr/io.h>
+
+#include "alert.h"
+#include "clock.h"
+#include "cmd.h"
+#include "drivers/i2c.h"
+#include "drivers/usart.h"
+#include "error.h"
+#include "fan.h"
+#include "fanmodel.h"
+#include "history.h"
+#include "perf.h"
+#include "rs485.h"
+#include "sim.h"
+#include "store.h"
+#include "zone.h"
+
+extern void shell_tick(void);
+extern void fan_tick(void);
+
+/* Longest stretch of time simulated in one go. Hardware events inside a step
+ * are timestamped exactly, but interrupts are serviced at the end of it. */
+#define STEP_CYCLES_ (400)
+/* Time the EEPROM is busy after a byte is written */
+#define EEPROM_WRITE_CYCLES_ (F_CPU / 100)
+/* Most tacho edges of the selected fan within one step */
+#define MAX_EDGES_ (16)
+/* Most devices attached to the board */
+#define MAX_DEVICES_ (4)
+/* Cycles from an interrupt being raised until the first statement of its
+ * handler runs, including the prologue */
+#define ISR_ENTRY_CYCLES_ (24)
+
+TCA_t TCA0, TCA1;
+TCB_t TCB0, TCB1, TCB2, TCB3;
+TWI_t TWI0, TWI1;
+USART_t USART0, USART1, USART2, USART3, USART4;
+PORT_t PORTA, PORTB, PORTC, PORTD, PORTE, PORTF;
+EVSYS_t EVSYS;
+PORTMUX_t PORTMUX;
+RSTCTRL_t RSTCTRL;
+NVMCTRL_t NVMCTRL;
+RTC_t RTC;
+CPUINT_t CPUINT;
+register8_t SREG;
+
+struct channel_ {
+        volatile TCA_t* tca;
+        register8_t* cmp;
+        uint8_t tacho_gen;
+};
+
+#define CHANNEL_(tca, cmp, port, pin, tacho_port, tacho_pin, tacho_gen)        \
+        {&tca, &tca.SPLIT.cmp, tacho_gen},
+
+static const struct channel_ channels_[FAN_COUNT] = {FAN_CHANNELS(CHANNEL_)};
+
+static struct {
+        uint64_t now;
+        uint32_t loop_cycles;
+        uint64_t last_capture;
+        uint64_t eeprom_busy_until;
+        uint8_t eeprom[EEPROM_SIZE];
+        uint16_t rtc_high;
+
+        uint64_t edges[MAX_EDGES_];
+        uint8_t edge_count;
+
+        sim_device_fn devices[MAX_DEVICES_];
+        uint8_t device_count;
+
+        /* Whether the fan model drives the tacho input */
+        bool tacho_off;
+
+        /* End of the level 0 interrupt handlers running or queued */
+        uint64_t isr_busy_until;
+        uint32_t lost_captures;
+} sim_;
+
+double sim_fan_duty(uint8_t fan_index)
+{
+        const struct channel_* ch = &channels_[fan_index];
+        volatile TCA_SPLIT_t* split = &ch->tca->SPLIT;
+
+        if (!(split->CTRLA & TCA_SPLIT_ENABLE_bm)) {
+                return 0.0;
+        }
+
+        /* The high byte compare registers sit at odd offsets from LCMP0 */
+        bool high = (ch->cmp - &split->LCMP0) & 1;
+        uint8_t per = high ? split->HPER : split->LPER;
+
+        return *ch->cmp >= per + 1 ? 1.0 : *ch->cmp / (double)(per + 1);
+}
+
+/**
+ * @brief Edge callback of the fan model. Only edges of the fan currently
+ * routed to TCB0 through event channel 2 are kept.
+ */
+static void on_edge_(uint8_t fan_index, double t)
+{
+        if (sim_.tacho_off ||
+            EVSYS.CHANNEL2 != channels_[fan_index].tacho_gen ||
+            sim_.edge_count >= MAX_EDGES_) {
+                return;
+        }
+
+        sim_.edges[sim_.edge_count++] = (uint64_t)(t * F_CPU);
+}
+
+static int cmp_edges_(const void* a, const void* b)
+{
+        uint64_t x = *(const uint64_t*)a;
+        uint64_t y = *(const uint64_t*)b;
+
+        return x < y ? -1 : x > y;
+}
+
+/**
+ * @brief Get the time the capture interrupt raised at @p t is serviced. At
+ * level 1 it preempts everything else, while at level 0 it waits for any
+ * level 0 handler that is running or queued.
+ *
+ * @param t
+ * @return uint64_t
+ */
+static uint64_t service_time_(uint64_t t)
+{
+        if (CPUINT.LVL1VEC != TCB0_INT_vect_num && sim_.isr_busy_until > t) {
+                return sim_.isr_busy_until + ISR_ENTRY_CYCLES_;
+        }
+
+        return t + ISR_ENTRY_CYCLES_;
+}
+
+/**
+ * @brief Capture an event at time @p t on TCB0 in frequency measurement mode,
+ * which latches the count since the previous event into CCMP and restarts the
+ * counter. If the next event at @p next arrives before the interrupt is
+ * serviced, the capture is overwritten and lost.
+ *
+ * @param t
+ * @param next
+ */
+static void capture_(uint64_t t, uint64_t next)
+{
+        if (!(TCB0.CTRLA & TCB_ENABLE_bm) || !(TCB0.EVCTRL & TCB_CAPTEI_bm)) {
+                return;
+        }
+
+        uint64_t service = service_time_(t);
+
+        TCB0.CCMP = (uint16_t)(t - sim_.last_capture);
+        sim_.last_capture = t;
+
+        if (next <= service) {
+                sim_.lost_captures++;
+                return;
+        }
+
+        /* The handler reads the counter as it was when it was serviced */
+        TCB0.CNT = (uint16_t)(service - t);
+
+        if (TCB0.INTCTRL & TCB_CAPT_bm) {
+                TCB0_INT_vect();
+        }
+}
+
+void sim_set_tacho(bool enable)
+{
+        sim_.tacho_off = !enable;
+}
+
+void sim_capture(uint16_t count)
+{
+        if (!(TCB0.CTRLA & TCB_ENABLE_bm) || !(TCB0.EVCTRL & TCB_CAPTEI_bm)) {
+                return;
+        }
+
+        TCB0.CCMP = count;
+        TCB0.CNT = ISR_ENTRY_CYCLES_;
+        sim_.last_capture = sim_.now;
+
+        if (TCB0.INTCTRL & TCB_CAPT_bm) {
+                TCB0_INT_vect();
+        }
+}
+
+/**
+ * @brief Run the RTC up to the current time, raising the overflow interrupt
+ * when it wraps
+ */
+static void rtc_update_(void)
+{
+        if (!(RTC.CTRLA & RTC_RTCEN_bm)) {
+                return;
+        }
+
+        uint64_t ticks = sim_.now * CLOCK_HZ / F_CPU;
+
+        RTC.CNT = (uint16_t)ticks;
+
+        while (sim_.rtc_high != (uint16_t)(ticks >> 16)) {
+                sim_.rtc_high++;
+                RTC.INTFLAGS |= RTC_OVF_bm;
+
+                if (RTC.INTCTRL & RTC_OVF_bm) {
+                        RTC_CNT_vect();
+
+                        /* The handler clears the flag by writing a one to it,
+                         * which plain memory can not emulate */
+                        RTC.INTFLAGS &= ~RTC_OVF_bm;
+                }
+        }
+}
+
+/**
+ * @brief Service the EEPROM ready interrupt for as long as it is enabled and
+ * the EEPROM is idle
+ */
+static void eeprom_update_(void)
+{
+        bool busy = sim_.now < sim_.eeprom_busy_until;
+
+        NVMCTRL.STATUS = busy ? NVMCTRL_EEBUSY_bm : 0;
+
+        for (uint16_t i = 0; i < EEPROM_SIZE && !busy &&
+                             (NVMCTRL.INTCTRL & NVMCTRL_EEREADY_bm);
+             i++) {
+                NVMCTRL_EE_vect();
+                busy = sim_.now < sim_.eeprom_busy_until;
+        }
+}
+
+/**
+ * @brief Simulate @p cycles of hardware activity, at most `STEP_CYCLES_`
+ *
+ * @param cycles
+ */
+static void step_(uint32_t cycles)
+{
+        double t = sim_.now / (double)F_CPU;
+        double dt = cycles / (double)F_CPU;
+
+        sim_.edge_count = 0;
+
+        for (uint8_t i = 0; i < FAN_COUNT; i++) {
+                fanmodel_advance(i, sim_fan_duty(i), t, dt, on_edge_);
+        }
+
+        qsort(sim_.edges, sim_.edge_count, sizeof(sim_.edges[0]), cmp_edges_);
+
+        sim_.now += cycles;
+
+        for (uint8_t i = 0; i < sim_.edge_count; i++) {
+                capture_(
+                    sim_.edges[i], i + 1 < sim_.edge_count ? sim_.edges[i + 1]
+                                                           : UINT64_MAX
+                );
+        }
+
+        TCB0.CNT = (uint16_t)(sim_.now - sim_.last_capture);
+        if (TCB2.CTRLA & TCB_ENABLE_bm) {
+                TCB2.CNT = (uint16_t)sim_.now;
+        }
+
+        rtc_update_();
+        eeprom_update_();
+
+        for (uint8_t i = 0; i < sim_.device_count; i++) {
+                sim_.devices[i](sim_.now);
+        }
+}
+
+void sim_charge(uint64_t cycles)
+{
+        uint64_t end = sim_.now + cycles;
+
+        while (sim_.now < end) {
+                uint64_t left = end - sim_.now;
+
+                step_(left < STEP_CYCLES_ ? left : STEP_CYCLES_);
+        }
+}
+
+void sim_init(uint32_t seed)
+{
+        (void)memset(&sim_, 0, sizeof(sim_));
+        (void)memset(sim_.eeprom, 0xFF, sizeof(sim_.eeprom));
+        sim_.loop_cycles = 200;
+
+        fanmodel_init(seed, 0.1);
+
+        /* Same order as main() */
+        clock_init();
+
+        store_init();
+        fan_init();
+
+        perf_init();
+
+        usart_init(&USART3, 9600);
+        usart_setup_stdout();
+        rs485_init();
+
+        alert_init();
+
+        i2c_master_init(&ZONE_TWI, 100000, I2C_MODE_STANDARD);
+
+        i2c_slave_init(&CMD_TWI, store_get(i2c_slave_addr));
+        i2c_slave_set_gcall(&CMD_TWI, store_get(i2c_gcall));
+
+        CPUINT.LVL1VEC = TCB0_INT_vect_num;
+
+        /* Nothing answers on the sensor bus, so every master transfer is
+         * NACKed at the address */
+        ZONE_TWI.MSTATUS = TWI_WIF_bm | TWI_RXACK_bm;
+}
+
+void sim_iteration(void)
+{
+        sim_charge(sim_.loop_cycles);
+
+        shell_tick();
+        cmd_tick();
+        fan_tick();
+        zone_tick();
+        history_tick();
+}
+
+void sim_run(uint64_t cycles)
+{
+        uint64_t end = sim_.now + cycles;
+
+        while (sim_.now < end) {
+                sim_iteration();
+        }
+}
+
+void sim_isr_level0(uint32_t cycles)
+{
+        uint64_t start = sim_.isr_busy_until > sim_.now ? sim_.isr_busy_until
+                                                        : sim_.now;
+
+        sim_.isr_busy_until = start + cycles;
+}
+
+uint32_t sim_lost_captures(void)
+{
+        return sim_.lost_captures;
+}
+
+int sim_attach(sim_device_fn fn)
+{
+        if (sim_.device_count >= MAX_DEVICES_) {
+                return -E_NOMEM;
+        }
+
+        sim_.devices[sim_.device_count++] = fn;
+
+        return 0;
+}
+
+void sim_set_loop_cycles(uint32_t cycles)
+{
+        sim_.loop_cycles = cycles;
+}
+
+uint64_t sim_now(void)
+{
+        return sim_.now;
+}
+
+double sim_seconds(void)
+{
+        return sim_.now / (double)F_CPU;
+}
+
+/**
+ * @brief Get the EEPROM array index of the EEPROM address @p addr
+ */
+static size_t eeprom_index_(const void* addr)
+{
+        return ((uintptr_t)addr - EEPROM_START) % EEPROM_SIZE;
+}
+
+uint8_t eeprom_read_byte(const uint8_t* addr)
+{
+        return sim_.eeprom[eeprom_index_(addr)];
+}
+
+void eeprom_read_block(void* dst, const void* src, size_t size)
+{
+        for (size_t i = 0; i < size; i++) {
+                ((uint8_t*)dst)[i] = eeprom_read_byte((const uint8_t*)src + i);
+        }
+}
+
+void eeprom_busy_wait(void)
+{
+        if (sim_.now < sim_.eeprom_busy_until) {
+                sim_charge(sim_.eeprom_busy_until - sim_.now);
+        }
+}
+
+void eeprom_update_byte(uint8_t* addr, uint8_t value)
+{
+        size_t index = eeprom_index_(addr);
+
+        eeprom_busy_wait();
+
+        if (sim_.eeprom[index] == value) {
+                return;
+        }
+
+        sim_.eeprom[index] = value;
+        sim_.eeprom_busy_until = sim_.now + EEPROM_WRITE_CYCLES_;
+}
+
+void eeprom_update_block(const void* src, void* dst, size_t size)
+{
+        for (size_t i = 0; i < size; i++) {
+                eeprom_update_byte(
+                    (uint8_t*)dst + i, ((const uint8_t*)src)[i]
+                );
+        }
+}
@@ -0,0 +1,150 @@
+/* Host simulation of the fancontrol board.
+ *
+ * The firmware sources are compiled for the host against the register
+ * stand-ins in sim/include, and the simulator plays the part of the hardware:
+ * it advances a virtual CPU clock, feeds tacho edges from the fan model into
+ * TCB0, runs the RTC and the EEPROM controller, and calls the matching
+ * interrupt handlers between main loop iterations.
+ */
+#ifndef SIM_H__
+#define SIM_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * @brief Reset the simulated hardware, and initialize the firmware the same
+ * way as `main` does
+ *
+ * @param seed Seed of the fan model
+ */
+void sim_init(uint32_t seed);
+
+/**
+ * @brief Run the firmware main loop until the virtual clock has advanced by
+ * @p cycles CPU cycles
+ *
+ * @param cycles
+ */
+void sim_run(uint64_t cycles);
+
+/**
+ * @brief Run a single iteration of the firmware main loop
+ */
+void sim_iteration(void);
+
+/**
+ * @brief Advance the virtual clock by @p cycles without running the main
+ * loop, processing any hardware events and interrupts that happen meanwhile.
+ * This is used to account for time the firmware spends busy waiting.
+ *
+ * @param cycles
+ */
+void sim_charge(uint64_t cycles);
+
+/**
+ * @brief Set the number of CPU cycles one main loop iteration is assumed to
+ * take, not counting busy waiting charged through `sim_charge`
+ *
+ * @param cycles
+ */
+void sim_set_loop_cycles(uint32_t cycles);
+
+/**
+ * @brief Get the virtual clock in CPU cycles
+ *
+ * @return uint64_t
+ */
+uint64_t sim_now(void);
+
+/**
+ * @brief Get the virtual clock in seconds
+ *
+ * @return double
+ */
+double sim_seconds(void);
+
+/**
+ * @brief Get the duty cycle (0-1) currently output to fan @p fan_index, as
+ * given by its TCA compare register
+ *
+ * @param fan_index
+ * @return double
+ */
+double sim_fan_duty(uint8_t fan_index);
+
+/**
+ * @brief Account for a level 0 interrupt handler running for @p cycles,
+ * starting now or once the level 0 handlers already accounted for are done.
+ * A tacho capture raised meanwhile is delayed, unless it runs at level 1.
+ *
+ * @param cycles
+ */
+void sim_isr_level0(uint32_t cycles);
+
+/**
+ * @brief Get the number of tacho captures that were overwritten by the next
+ * capture before their interrupt was serviced
+ *
+ * @return uint32_t
+ */
+uint32_t sim_lost_captures(void);
+
+/**
+ * @brief Set whether the fan model drives the tacho input. While it does not,
+ * TCB0 only captures what is fed through `sim_capture`.
+ *
+ * @param enable
+ */
+void sim_set_tacho(bool enable);
+
+/**
+ * @brief Capture the count @p count on TCB0 now, and service the capture
+ * interrupt, as if a tacho edge had arrived
+ *
+ * @param count
+ */
+void sim_capture(uint16_t count);
+
+/**
+ * @brief Device attached to the simulated board, called with the virtual
+ * clock after every step of simulated time. Devices act on the firmware only
+ * through registers and interrupt handlers, and must not advance the clock.
+ */
+typedef void (*sim_device_fn)(uint64_t now);
+
+/**
+ * @brief Attach device @p fn to the simulated board. Devices are detached
+ * again by `sim_init`.
+ *
+ * @param fn
+ * @return int
+ * @retval -ENOMEM Too many devices attached
+ * @retval 0 Success
+ */
+int sim_attach(sim_device_fn fn);
+
+/**
+ * @brief Queue @p len bytes from @p data as received on the console USART
+ *
+ * @param data
+ * @param len
+ */
+void sim_usart_rx(const char* data, size_t len);
+
+/**
+ * @brief Set the stream console output is written to, NULL to discard it
+ *
+ * @param out
+ */
+void sim_usart_output(FILE* out);
+
+/**
+ * @brief Get the number of bytes written to the console USART so far
+ *
+ * @return uint64_t
+ */
+uint64_t sim_usart_tx_count(void);
+
+#endif /* SIM_H__ */
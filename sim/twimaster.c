@@ -0,0 +1,118 @@
+#include <stdbool.h>
+
+#include <avr/interrupt.h>
+#include <avr/io.h>
+
+#include "error.h"
+#include "sim.h"
+#include "twimaster.h"
+
+/* Estimated cycles taken by one run of the slave interrupt handler */
+#define SLAVE_ISR_CYCLES_ (250)
+
+static uint32_t speed_ = 100000;
+
+void twimaster_set_speed(uint32_t speed)
+{
+        speed_ = speed;
+}
+
+uint64_t twimaster_cycles(size_t bytes)
+{
+        /* Start, address and stop, and 9 bits per byte including the
+         * acknowledge */
+        return (2 + 9 * (bytes + 1)) * (uint64_t)F_CPU / speed_;
+}
+
+/**
+ * @brief Present @p sstatus to the slave and run its interrupt handler
+ *
+ * @param sstatus
+ * @return bool
+ * @retval true The slave acknowledged
+ * @retval false The slave did not acknowledge
+ */
+static bool slave_event_(uint8_t sstatus)
+{
+        TWI0.SSTATUS = sstatus;
+        TWI0.SCTRLB = 0;
+
+        TWI0_TWIS_vect();
+        sim_isr_level0(SLAVE_ISR_CYCLES_);
+
+        return !(TWI0.SCTRLB & TWI_ACKACT_NACK_gc);
+}
+
+/**
+ * @brief Address the slave for a transfer in direction @p dir
+ *
+ * @param addr
+ * @param dir 0 for write, `TWI_DIR_bm` for read
+ * @return bool
+ * @retval true The slave acknowledged its address
+ * @retval false Nobody acknowledged
+ */
+static bool start_(uint8_t addr, uint8_t dir)
+{
+        bool gcall = addr == 0 && (TWI0.SADDR & 0x01);
+
+        if (!(TWI0.SCTRLA & TWI_ENABLE_bm) ||
+            (addr != TWI0.SADDR >> 1 && !gcall)) {
+                return false;
+        }
+
+        TWI0.SDATA = (addr << 1) | (dir ? 1 : 0);
+
+        return slave_event_(TWI_APIF_bm | TWI_AP_ADR_gc | dir);
+}
+
+static void stop_(void)
+{
+        (void)slave_event_(TWI_APIF_bm);
+}
+
+ptrdiff_t twimaster_write(uint8_t addr, const uint8_t* data, size_t size)
+{
+        size_t sent = 0;
+
+        if (!start_(addr, 0)) {
+                return -E_NODEV;
+        }
+
+        while (sent < size) {
+                TWI0.SDATA = data[sent];
+
+                if (!slave_event_(TWI_DIF_bm)) {
+                        break;
+                }
+
+                sent++;
+        }
+
+        stop_();
+
+        return (ptrdiff_t)sent;
+}
+
+ptrdiff_t twimaster_read(uint8_t addr, uint8_t* buf, size_t size)
+{
+        size_t bytes = 0;
+
+        if (!start_(addr, TWI_DIR_bm)) {
+                return -E_NODEV;
+        }
+
+        /* Every byte but the last is acknowledged by the master, which the
+         * slave sees along with the request for the next byte */
+        while (bytes < size) {
+                if (!slave_event_(TWI_DIF_bm | TWI_DIR_bm)) {
+                        break;
+                }
+
+                buf[bytes++] = TWI0.SDATA;
+        }
+
+        stop_();
+
+        return (ptrdiff_t)bytes;
+}
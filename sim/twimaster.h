@@ -0,0 +1,51 @@
+/* Virtual I2C master on the bus of the firmware's TWI0 slave. Transfers are
+ * carried out by presenting the bus conditions the slave hardware would see
+ * in SSTATUS and SDATA, and calling the slave interrupt handler. */
+#ifndef TWIMASTER_H__
+#define TWIMASTER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Set the bus speed used to calculate transfer times
+ *
+ * @param speed Bus speed, in Hz
+ */
+void twimaster_set_speed(uint32_t speed);
+
+/**
+ * @brief Get the time a transfer of @p bytes bytes, not counting the address,
+ * holds the bus
+ *
+ * @param bytes
+ * @return uint64_t Time, in CPU cycles
+ */
+uint64_t twimaster_cycles(size_t bytes);
+
+/**
+ * @brief Write @p size bytes from @p data to @p addr
+ *
+ * @param addr
+ * @param data
+ * @param size
+ * @return ptrdiff_t
+ * @retval -ENODEV The address was not acknowledged
+ * @retval >=0 Bytes acknowledged by the slave
+ */
+ptrdiff_t twimaster_write(uint8_t addr, const uint8_t* data, size_t size);
+
+/**
+ * @brief Read at most @p size bytes from @p addr into @p buf, stopping early
+ * if the slave has no data to send
+ *
+ * @param addr
+ * @param buf
+ * @param size
+ * @return ptrdiff_t
+ * @retval -ENODEV The address was not acknowledged
+ * @retval >=0 Bytes read
+ */
+ptrdiff_t twimaster_read(uint8_t addr, uint8_t* buf, size_t size);
+
+#endif /* TWIMASTER_H__ */
@@ -0,0 +1,116 @@
+/* Replacement for drivers/usart.c on the host. Console output is written to
+ * a host stream, and each byte costs the time it takes to shift out at the
+ * configured baud rate, as the firmware busy waits on the transmitter. */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+
+#include "drivers/usart.h"
+#include "sim.h"
+#include "trace.h"
+
+/* Estimated cycles taken by the receive interrupt handler for one byte */
+#define RX_ISR_CYCLES_ (100)
+
+static struct {
+        uint32_t baud;
+        FILE* out;
+        uint64_t tx_count;
+        char rx[256];
+        size_t rx_head;
+        size_t rx_len;
+} usart_;
+
+static void send_one_(char c)
+{
+        /* 8N1 framing, 10 bits per byte */
+        sim_charge(10ULL * F_CPU / usart_.baud);
+
+        usart_.tx_count++;
+
+        if (usart_.out != NULL) {
+                (void)fputc(c, usart_.out);
+        }
+}
+
+static ssize_t stream_write_(void* cookie, const char* buf, size_t size)
+{
+        (void)cookie;
+
+        for (size_t i = 0; i < size; i++) {
+                send_one_(buf[i]);
+        }
+
+        return size;
+}
+
+void usart_setup_stdout(void)
+{
+        static FILE* stream;
+        cookie_io_functions_t fns = {.write = stream_write_};
+
+        if (stream == NULL) {
+                stream = fopencookie(NULL, "w", fns);
+                (void)setvbuf(stream, NULL, _IONBF, 0);
+        }
+
+        stdout = stream;
+}
+
+void usart_init(volatile USART_t* const peri, uint32_t baud)
+{
+        (void)peri;
+
+        usart_.baud = baud;
+}
+
+void usart_set_rs485(bool enable)
+{
+        /* The transceiver direction is not simulated */
+        (void)enable;
+}
+
+void usart_write(const char* str, size_t len)
+{
+        while (len--) {
+                send_one_(*str++);
+        }
+}
+
+size_t usart_read(char* buf, size_t max)
+{
+        size_t i = 0;
+
+        for (; i < max && usart_.rx_len > 0; i++) {
+                buf[i] = usart_.rx[usart_.rx_head];
+                usart_.rx_head = (usart_.rx_head + 1) % sizeof(usart_.rx);
+                usart_.rx_len--;
+        }
+
+        return i;
+}
+
+void sim_usart_rx(const char* data, size_t len)
+{
+        for (size_t i = 0; i < len && usart_.rx_len < sizeof(usart_.rx); i++) {
+                size_t index = (usart_.rx_head + usart_.rx_len) %
+                               sizeof(usart_.rx);
+
+                usart_.rx[index] = data[i];
+                usart_.rx_len++;
+
+                TRACE(TRACE_RX, data[i], 0);
+                sim_isr_level0(RX_ISR_CYCLES_);
+        }
+}
+
+void sim_usart_output(FILE* out)
+{
+        usart_.out = out;
+}
+
+uint64_t sim_usart_tx_count(void)
+{
+        return usart_.tx_count;
+}
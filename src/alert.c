@@ -0,0 +1,89 @@
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <avr/io.h>
+
+#include "alert.h"
+#include "fan.h"
+#include "store.h"
+
+#define ALERT_PORT_ PORTA
+#define ALERT_PIN_bm_ PIN7_bm
+
+/* Hysteresis around the temperature threshold, in mC, so that a reading
+ * hovering around the threshold does not raise an alert on every sample */
+#define TEMP_HYSTERESIS_ (1000)
+
+_Static_assert(FAN_COUNT <= 16, "Fan mask does not fit all fans");
+
+static struct {
+        uint8_t events;
+        uint16_t fans;
+        bool temp_above;
+        uint16_t rpm[FAN_COUNT];
+} alert_;
+
+void alert_init(void)
+{
+        /* The output latch is kept low, and the line is driven by switching
+         * the pin between output (asserted) and input (released) */
+        ALERT_PORT_.OUTCLR = ALERT_PIN_bm_;
+        ALERT_PORT_.DIRCLR = ALERT_PIN_bm_;
+}
+
+void alert_raise(uint8_t events, uint16_t fan_mask)
+{
+        alert_.events |= events;
+        alert_.fans |= fan_mask;
+
+        ALERT_PORT_.DIRSET = ALERT_PIN_bm_;
+}
+
+void alert_rpm(uint8_t fan_index, uint16_t rpm)
+{
+        uint16_t delta = store_get(alert_rpm_delta);
+        uint16_t last = alert_.rpm[fan_index];
+
+        if (delta == 0) {
+                return;
+        }
+
+        if ((rpm > last ? rpm - last : last - rpm) > delta) {
+                alert_.rpm[fan_index] = rpm;
+                alert_raise(ALERT_RPM, (uint16_t)1 << fan_index);
+        }
+}
+
+void alert_temp(int32_t temp)
+{
+        int32_t threshold = store_get(alert_temp_threshold);
+
+        if (!alert_.temp_above && temp > threshold) {
+                alert_.temp_above = true;
+                alert_raise(ALERT_TEMP, 0);
+        } else if (alert_.temp_above && temp < threshold - TEMP_HYSTERESIS_) {
+                alert_.temp_above = false;
+                alert_raise(ALERT_TEMP, 0);
+        }
+}
+
+uint8_t alert_pending(uint16_t* fan_mask)
+{
+        if (fan_mask != NULL) {
+                *fan_mask = alert_.fans;
+        }
+
+        return alert_.events;
+}
+
+uint8_t alert_take(uint16_t* fan_mask)
+{
+        uint8_t events = alert_pending(fan_mask);
+
+        alert_.events = 0;
+        alert_.fans = 0;
+
+        ALERT_PORT_.DIRCLR = ALERT_PIN_bm_;
+
+        return events;
+}
@@ -0,0 +1,59 @@
+#ifndef ALERT_H__
+#define ALERT_H__
+
+#include <stdint.h>
+
+enum alert_event {
+        ALERT_FAULT = 1 << 0,
+        ALERT_TEMP = 1 << 1,
+        ALERT_RPM = 1 << 2,
+};
+
+/**
+ * @brief Initialize the alert line. The line is open-drain, and requires an
+ * external pull-up shared with the other boards on the bus.
+ */
+void alert_init(void);
+
+/**
+ * @brief Add @p events to the pending set, and assert the alert line
+ *
+ * @param events Bitmap of `enum alert_event`
+ * @param fan_mask Bitmap of the fans the events relate to
+ */
+void alert_raise(uint8_t events, uint16_t fan_mask);
+
+/**
+ * @brief Raise `ALERT_RPM` if the speed of fan @p fan_index has changed by more
+ * than the configured delta since it was last alerted on
+ *
+ * @param fan_index
+ * @param rpm
+ */
+void alert_rpm(uint8_t fan_index, uint16_t rpm);
+
+/**
+ * @brief Raise `ALERT_TEMP` if @p temp has crossed the configured threshold
+ * since the last reading
+ *
+ * @param temp Temperature in mC
+ */
+void alert_temp(int32_t temp);
+
+/**
+ * @brief Get the pending events without clearing them
+ *
+ * @param fan_mask Set to the fans the pending events relate to, may be NULL
+ * @return uint8_t Bitmap of `enum alert_event`
+ */
+uint8_t alert_pending(uint16_t* fan_mask);
+
+/**
+ * @brief Get and clear the pending events, releasing the alert line
+ *
+ * @param fan_mask Set to the fans the pending events relate to, may be NULL
+ * @return uint8_t Bitmap of `enum alert_event`
+ */
+uint8_t alert_take(uint16_t* fan_mask);
+
+#endif /* ALERT_H__ */
@@ -0,0 +1,74 @@
+#include <avr/interrupt.h>
+#include <avr/io.h>
+
+#include "clock.h"
+
+/* RTC overflows, counted by the RTC overflow interrupt. The counter wraps every
+ * 65536 ticks, which is exactly 2000 ms. */
+static volatile uint32_t overflows_;
+
+ISR(RTC_CNT_vect)
+{
+        RTC.INTFLAGS = RTC_OVF_bm;
+        overflows_++;
+}
+
+void clock_init(void)
+{
+        RTC.CLKSEL = RTC_CLKSEL_OSC32K_gc;
+
+        /* PER and CTRLA are synchronized to the RTC clock domain */
+        while (RTC.STATUS & (RTC_PERBUSY_bm | RTC_CTRLABUSY_bm)) {
+        }
+
+        RTC.PER = 0xFFFF;
+        RTC.INTCTRL = RTC_OVF_bm;
+        RTC.CTRLA = RTC_PRESCALER_DIV1_gc | RTC_RTCEN_bm;
+}
+
+/**
+ * @brief Read the RTC counter into @p low, and the overflows counted so far
+ * into @p high, as one consistent value
+ *
+ * @param high
+ * @param low
+ */
+static void read_(uint32_t* high, uint16_t* low)
+{
+        uint8_t sreg = SREG;
+
+        cli();
+
+        *low = RTC.CNT;
+        *high = overflows_;
+
+        /* The counter may have wrapped after interrupts were disabled, in
+         * which case the overflow has not been counted yet */
+        if ((RTC.INTFLAGS & RTC_OVF_bm) && *low < 0x8000) {
+                (*high)++;
+        }
+
+        SREG = sreg;
+}
+
+uint32_t clock_ticks(void)
+{
+        uint32_t high;
+        uint16_t low;
+
+        read_(&high, &low);
+
+        return (high << 16) | low;
+}
+
+uint32_t clock_ms(void)
+{
+        uint32_t high;
+        uint16_t low;
+
+        read_(&high, &low);
+
+        /* Computed from the overflows rather than the ticks, so that this
+         * wraps around at 2^32 ms like the callers assume */
+        return high * 2000 + (((uint32_t)low * 1000) >> 15);
+}
@@ -0,0 +1,31 @@
+#ifndef CLOCK_H__
+#define CLOCK_H__
+
+#include <stdint.h>
+
+/* Frequency of the clock returned by `clock_ticks` */
+#define CLOCK_HZ (32768UL)
+
+/**
+ * @brief Start the system clock. This uses the RTC, running from the internal
+ * 32.768 kHz oscillator.
+ */
+void clock_init(void);
+
+/**
+ * @brief Get the number of clock ticks since `clock_init` was called. This
+ * wraps around after roughly 36 hours.
+ *
+ * @return uint32_t Ticks, at `CLOCK_HZ`
+ */
+uint32_t clock_ticks(void);
+
+/**
+ * @brief Get the number of milliseconds since `clock_init` was called. This
+ * wraps around after roughly 49 days.
+ *
+ * @return uint32_t
+ */
+uint32_t clock_ms(void);
+
+#endif /* CLOCK_H__ */
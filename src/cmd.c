@@ -1,8 +1,19 @@
 
-#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
 
+#include "alert.h"
+#include "cmd.h"
 #include "drivers/i2c.h"
+#include "error.h"
+#include "evlog.h"
 #include "fan.h"
+#include "fanstats.h"
+#include "fault.h"
+#include "history.h"
+#include "perf.h"
+#include "store.h"
+#include "zone.h"
 
 struct __attribute__((packed)) cmd_packet_ {
         uint8_t cmd;
@@ -14,6 +25,18 @@ enum cmd_type_ {
         CMD_MIN_ = 0x0,
         CMD_REPORT_ = 0x0,
         CMD_HELLO_,
+        CMD_FAULTS_,
+        CMD_ALERT_,
+        CMD_ZONES_,
+        CMD_FANSTATS_,
+        CMD_PERF_,
+        CMD_SET_DUTY_,
+        CMD_SET_TARGET_,
+        CMD_SNAPSHOT_,
+        CMD_SNAPSHOT_GET_,
+        CMD_HISTORY_,
+        CMD_FANS_,
+        CMD_LOG_,
         CMD_MAX_,
 };
 
@@ -21,28 +44,355 @@ typedef int (*cmd_fn_)(struct cmd_packet_* packet);
 
 static int report_(struct cmd_packet_* packet)
 {
-        for (uint8_t i = 0; i < 8; i++) {
-                uint16_t speed = fan_get_speed(i);
+        struct fan_snapshot snap;
 
-                (void)memcpy(
-                    packet->args + i * sizeof(speed), &speed, sizeof(speed)
-                );
-        }
+        /* Every speed in the report is from the same moment */
+        fan_snapshot(&snap);
+        (void)memcpy(packet->args, snap.rpm, sizeof(snap.rpm));
 
-        (void)i2c_slave_send(packet->args, sizeof(uint16_t) * 8);
+        (void)i2c_slave_send(
+            &CMD_TWI, packet->args, sizeof(uint16_t) * FAN_COUNT
+        );
 
         return 0;
 }
 
 static int hello_(struct cmd_packet_* packet)
 {
-        (void)i2c_slave_send("hey", 4);
+        (void)i2c_slave_send(&CMD_TWI, "hey", 4);
+        return 0;
+}
+
+/**
+ * @brief Reply with the fault bitmap of every fan, followed by the stall,
+ * under-speed and recovery counters of every fan
+ */
+static int faults_(struct cmd_packet_* packet)
+{
+        uint8_t* out = packet->args;
+
+        for (uint8_t i = 0; i < FAN_COUNT; i++) {
+                *out++ = fault_get(i);
+        }
+
+        for (uint8_t i = 0; i < FAN_COUNT; i++) {
+                const struct fault_counters* c = fault_counters(i);
+
+                (void)memcpy(out, &c->stalls, sizeof(c->stalls));
+                out += sizeof(c->stalls);
+                (void)memcpy(out, &c->underspeeds, sizeof(c->underspeeds));
+                out += sizeof(c->underspeeds);
+                (void)memcpy(out, &c->recoveries, sizeof(c->recoveries));
+                out += sizeof(c->recoveries);
+        }
+
+        (void)i2c_slave_send(&CMD_TWI, packet->args, out - packet->args);
+
+        return 0;
+}
+
+/**
+ * @brief Reply with the pending alert events and the 16-bit mask of fans they
+ * relate to, clearing them and releasing the alert line
+ */
+static int alert_(struct cmd_packet_* packet)
+{
+        uint16_t fans;
+
+        packet->args[0] = alert_take(&fans);
+        (void)memcpy(&packet->args[1], &fans, sizeof(fans));
+
+        (void)i2c_slave_send(&CMD_TWI, packet->args, 1 + sizeof(fans));
+
+        return 0;
+}
+
+/**
+ * @brief Reply with the cached temperature (in mC) of every zone, followed by
+ * the age (in ms, saturated to 0xFFFF) of each. Zones without data report
+ * INT32_MIN.
+ */
+static int zones_(struct cmd_packet_* packet)
+{
+        uint8_t* out = packet->args;
+
+        for (uint8_t i = 0; i < ZONE_COUNT; i++) {
+                int32_t temp;
+
+                if (zone_get(i, &temp) != 0) {
+                        temp = INT32_MIN;
+                }
+
+                (void)memcpy(out, &temp, sizeof(temp));
+                out += sizeof(temp);
+        }
+
+        for (uint8_t i = 0; i < ZONE_COUNT; i++) {
+                uint32_t age = zone_age(i);
+                uint16_t age16 = age > UINT16_MAX ? UINT16_MAX : age;
+
+                (void)memcpy(out, &age16, sizeof(age16));
+                out += sizeof(age16);
+        }
+
+        (void)i2c_slave_send(&CMD_TWI, packet->args, out - packet->args);
+
+        return 0;
+}
+
+/**
+ * @brief Reply with the statistics of the fan given by the first argument.
+ * If the argument is 0xFF, the statistics of every fan are reset instead.
+ */
+static int fanstats_(struct cmd_packet_* packet)
+{
+        struct fanstats s;
+
+        if (packet->arg_len < 1) {
+                return -E_INVAL;
+        }
+
+        if (packet->args[0] == 0xFF) {
+                fanstats_reset();
+                return 0;
+        }
+
+        if (packet->args[0] >= FAN_COUNT) {
+                return -E_INVAL;
+        }
+
+        fanstats_get(packet->args[0], &s);
+
+        (void)i2c_slave_send(&CMD_TWI, (uint8_t*)&s, sizeof(s));
+
+        return 0;
+}
+
+#ifdef PERF_ENABLE
+/**
+ * @brief Reply with count, min, max and average cycles of every probe, and
+ * reset them
+ */
+static int perf_(struct cmd_packet_* packet)
+{
+        uint8_t* out = packet->args;
+
+        for (uint8_t i = 0; i < PERF_PROBES; i++) {
+                struct perf_entry e;
+                perf_take(i, &e);
+
+                uint16_t avg = e.count ? e.total / e.count : 0;
+
+                (void)memcpy(out, &e.count, sizeof(e.count));
+                out += sizeof(e.count);
+                (void)memcpy(out, &e.min, sizeof(e.min));
+                out += sizeof(e.min);
+                (void)memcpy(out, &e.max, sizeof(e.max));
+                out += sizeof(e.max);
+                (void)memcpy(out, &avg, sizeof(avg));
+                out += sizeof(avg);
+        }
+
+        (void)i2c_slave_send(&CMD_TWI, packet->args, out - packet->args);
+
+        return 0;
+}
+#endif /* PERF_ENABLE */
+
+/**
+ * @brief Set the duty cycle of every fan to the first argument, in percent
+ */
+static int set_duty_(struct cmd_packet_* packet)
+{
+        if (packet->arg_len < 1 || packet->args[0] > 100) {
+                return -E_INVAL;
+        }
+
+        for (uint8_t i = 0; i < FAN_COUNT; i++) {
+                fan_set_duty(i, packet->args[0]);
+        }
+
+        return 0;
+}
+
+/**
+ * @brief Make every fan track the target speed given by the first two
+ * argument bytes, in RPM
+ */
+static int set_target_(struct cmd_packet_* packet)
+{
+        uint16_t target;
+
+        if (packet->arg_len < sizeof(target)) {
+                return -E_INVAL;
+        }
+
+        (void)memcpy(&target, packet->args, sizeof(target));
+
+        for (uint8_t i = 0; i < FAN_COUNT; i++) {
+                fan_set_target_rpm(i, target);
+        }
+
+        return 0;
+}
+
+/**
+ * @brief Take a snapshot of the statistics of every fan
+ */
+static int snapshot_(struct cmd_packet_* packet)
+{
+        fanstats_snapshot();
+
+        return 0;
+}
+
+/**
+ * @brief Reply with the time of the last snapshot, followed by the snapshot
+ * of the fan given by the first argument
+ */
+static int snapshot_get_(struct cmd_packet_* packet)
+{
+        struct fanstats s;
+
+        if (packet->arg_len < 1 || packet->args[0] >= FAN_COUNT) {
+                return -E_INVAL;
+        }
+
+        uint32_t stamp = fanstats_snapshot_get(packet->args[0], &s);
+
+        (void)memcpy(packet->args, &stamp, sizeof(stamp));
+        (void)memcpy(packet->args + sizeof(stamp), &s, sizeof(s));
+
+        (void)i2c_slave_send(
+            &CMD_TWI, packet->args, sizeof(stamp) + sizeof(s)
+        );
+
+        return 0;
+}
+
+/* Bytes of history sent in one reply */
+#define HISTORY_CHUNK_ (64)
+
+/**
+ * @brief Reply with up to `HISTORY_CHUNK_` bytes of history, starting at the
+ * offset given by the first four argument bytes. The reply is the offset the
+ * data was actually read from, the number of bytes read, and the data, padded
+ * to a fixed size. Reading the next chunk resumes at offset + bytes read.
+ */
+static int history_(struct cmd_packet_* packet)
+{
+        uint32_t offset;
+
+        if (packet->arg_len < sizeof(offset)) {
+                return -E_INVAL;
+        }
+
+        (void)memcpy(&offset, packet->args, sizeof(offset));
+
+        uint8_t* data = packet->args + sizeof(offset) + 1;
+
+        (void)memset(data, 0, HISTORY_CHUNK_);
+        uint8_t len = history_read(&offset, data, HISTORY_CHUNK_);
+
+        (void)memcpy(packet->args, &offset, sizeof(offset));
+        packet->args[sizeof(offset)] = len;
+
+        (void)i2c_slave_send(
+            &CMD_TWI, packet->args, sizeof(offset) + 1 + HISTORY_CHUNK_
+        );
+
+        return 0;
+}
+
+/**
+ * @brief Reply with the duty cycle of every fan, in percent, followed by the
+ * zone every fan is assigned to
+ */
+static int fans_(struct cmd_packet_* packet)
+{
+        for (uint8_t i = 0; i < FAN_COUNT; i++) {
+                packet->args[i] = fan_get_duty(i);
+        }
+
+        (void)memcpy(
+            packet->args + FAN_COUNT, store_get(fan_zone), FAN_COUNT
+        );
+
+        (void)i2c_slave_send(&CMD_TWI, packet->args, 2 * FAN_COUNT);
+
+        return 0;
+}
+
+/* Events sent in one log reply */
+#define LOG_CHUNK_ (6)
+
+/**
+ * @brief Reply with up to `LOG_CHUNK_` events taken from the event log. The
+ * reply is the number of events sent, the number still in the log, and the
+ * number dropped since the last reply, followed by the events, padded to a
+ * fixed size.
+ */
+static int log_(struct cmd_packet_* packet)
+{
+        struct evlog_entry* entries = (void*)(packet->args + 4);
+        uint8_t count = 0;
+
+        (void)memset(entries, 0, LOG_CHUNK_ * sizeof(*entries));
+
+        while (count < LOG_CHUNK_ && evlog_take(&entries[count]) == 0) {
+                count++;
+        }
+
+        uint16_t dropped = evlog_take_dropped();
+
+        packet->args[0] = count;
+        packet->args[1] = evlog_count();
+        (void)memcpy(packet->args + 2, &dropped, sizeof(dropped));
+
+        (void)i2c_slave_send(
+            &CMD_TWI, packet->args, 4 + LOG_CHUNK_ * sizeof(*entries)
+        );
+
         return 0;
 }
 
+/**
+ * @brief Check whether command @p cmd may be sent through a general call.
+ * These commands act on every board at the same moment, and do not reply, as
+ * a reply would be read by whichever board is addressed next.
+ *
+ * @param cmd
+ * @return bool
+ */
+static bool broadcast_safe_(uint8_t cmd)
+{
+        switch (cmd) {
+        case CMD_SET_DUTY_:
+        case CMD_SET_TARGET_:
+        case CMD_SNAPSHOT_:
+                return true;
+        default:
+                return false;
+        }
+}
+
 static cmd_fn_ commands[] = {
     [CMD_REPORT_] = report_,
     [CMD_HELLO_] = hello_,
+    [CMD_FAULTS_] = faults_,
+    [CMD_ALERT_] = alert_,
+    [CMD_ZONES_] = zones_,
+    [CMD_FANSTATS_] = fanstats_,
+#ifdef PERF_ENABLE
+    [CMD_PERF_] = perf_,
+#endif /* PERF_ENABLE */
+    [CMD_SET_DUTY_] = set_duty_,
+    [CMD_SET_TARGET_] = set_target_,
+    [CMD_SNAPSHOT_] = snapshot_,
+    [CMD_SNAPSHOT_GET_] = snapshot_get_,
+    [CMD_HISTORY_] = history_,
+    [CMD_FANS_] = fans_,
+    [CMD_LOG_] = log_,
 };
 
 void cmd_tick(void)
@@ -60,21 +410,29 @@ void cmd_tick(void)
 
         ticks = 0;
 
-        size_t size = i2c_slave_recv(buf, sizeof(buf));
+        /* Only the packet at the head of the buffer is handled, and the
+         * transactions queued behind it may have been addressed differently */
+        bool gcall = i2c_slave_peek_gcall(&CMD_TWI);
+        size_t size = i2c_slave_recv(&CMD_TWI, buf, sizeof(buf));
         if (size < sizeof(struct cmd_packet_)) {
                 return;
         }
 
         struct cmd_packet_* packet = (void*)buf;
         if (packet->cmd >= CMD_MAX_) {
-                (void)printf("Command packet too big, dropped\r\n");
+                evlog_add(EVLOG_SYS_CMD, EVLOG_CMD_DROPPED, packet->cmd, size);
+
+                return;
+        }
 
+        if (gcall && !broadcast_safe_(packet->cmd)) {
                 return;
         }
 
         cmd_fn_ fn = commands[packet->cmd];
         if (fn == NULL) {
                 /* Invalid command ID */
+                evlog_add(EVLOG_SYS_CMD, EVLOG_CMD_DROPPED, packet->cmd, size);
                 return;
         }
 
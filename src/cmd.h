@@ -2,6 +2,9 @@
 #ifndef CMD_H__
 #define CMD_H__
 
+/* TWI instance the rack controller talks to the board on */
+#define CMD_TWI (TWI0)
+
 void cmd_tick(void);
 
 #endif /* CMD_H__ */
\ No newline at end of file
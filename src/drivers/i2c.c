@@ -7,7 +7,10 @@
 #include <avr/io.h>
 #include <util/delay.h>
 
+#include "../clock.h"
 #include "../error.h"
+#include "../perf.h"
+#include "../trace.h"
 #include "i2c.h"
 
 /**
@@ -90,17 +93,35 @@ static void msetup_(volatile TWI_t* twi, uint32_t speed, enum i2c_mode mode)
         twi->MCTRLA |= TWI_ENABLE_bm;
 }
 
+/* Longest time the master waits for the bus to act on a request, in clock
+ * ticks. This is far longer than a byte takes, even with clock stretching. */
+#define MTIMEOUT_TICKS_ (CLOCK_HZ / 100)
+
 /**
  * @brief Helper function to wait for the TWI master to have acted on the
- * previous request
+ * previous request. If it does not in time, the bus is forced back to idle so
+ * that the next transfer can start over.
  *
  * @param twi
+ * @return int
+ * @retval -EBUSY Timed out
+ * @retval 0 Success
  */
-static void mwait_(volatile TWI_t* twi)
+static int mwait_(volatile TWI_t* twi)
 {
+        uint32_t start = clock_ticks();
+
         /* Case M1, M3 and M4 will set WIF. M2 sets RIF */
         while (!(twi->MSTATUS & (TWI_WIF_bm | TWI_RIF_bm))) {
+                if (clock_ticks() - start > MTIMEOUT_TICKS_) {
+                        twi->MCTRLB = TWI_MCMD_STOP_gc;
+                        twi->MSTATUS = TWI_BUSSTATE_IDLE_gc;
+
+                        return -E_BUSY;
+                }
         }
+
+        return 0;
 }
 
 /**
@@ -111,15 +132,16 @@ static void mwait_(volatile TWI_t* twi)
  * @param is_read Indicates direction
  * @return int
  * @retval -ENODEV No device with address @p addr acknowledged the request
- * @retval -EBUSY Error on bus
+ * @retval -EBUSY Error on bus, or the bus did not respond in time
  * @retval 0 Success
  */
 static int mset_addr_(volatile TWI_t* twi, uint8_t addr, bool is_read)
 {
         twi->MADDR = (addr << 1) | is_read;
-        mwait_(twi);
 
-        if (is_nack_(twi->MSTATUS)) {
+        if (mwait_(twi) != 0) {
+                return -E_BUSY;
+        } else if (is_nack_(twi->MSTATUS)) {
                 /* Case M3: Not acknowledged, stop transfer */
                 twi->MCTRLB |= TWI_MCMD_STOP_gc;
 
@@ -134,7 +156,9 @@ static int mset_addr_(volatile TWI_t* twi, uint8_t addr, bool is_read)
 }
 
 /**
- * @brief Send at most @p size bytes from @p data to @p addr, using @p twi
+ * @brief Write at most @p size bytes from @p data to @p addr, using @p twi,
+ * without ending the transaction. On success the bus is still owned, and
+ * the caller must either issue a stop or a repeated start.
  *
  * @param twi
  * @param addr
@@ -142,11 +166,11 @@ static int mset_addr_(volatile TWI_t* twi, uint8_t addr, bool is_read)
  * @param size
  * @return ptrdiff_t
  * @retval -ENODEV No device with address @p addr acknowledged the request
- * @retval -EBUSY Error on bus
+ * @retval -EBUSY Error on bus, or the bus did not respond in time
  * @retval >=0 Bytes written
  */
 static ptrdiff_t
-msend_(volatile TWI_t* twi, uint8_t addr, const uint8_t* data, size_t size)
+mwrite_(volatile TWI_t* twi, uint8_t addr, const uint8_t* data, size_t size)
 {
         size_t sent;
         ptrdiff_t status;
@@ -158,9 +182,10 @@ msend_(volatile TWI_t* twi, uint8_t addr, const uint8_t* data, size_t size)
 
         for (sent = 0; sent < size; sent++) {
                 twi->MDATA = data[sent];
-                mwait_(twi);
 
-                if (is_nack_(twi->MSTATUS)) {
+                if (mwait_(twi) != 0) {
+                        return -E_BUSY;
+                } else if (is_nack_(twi->MSTATUS)) {
                         twi->MCTRLB |= TWI_MCMD_STOP_gc;
 
                         return -E_BUSY;
@@ -169,11 +194,33 @@ msend_(volatile TWI_t* twi, uint8_t addr, const uint8_t* data, size_t size)
                 }
         }
 
-        twi->MCTRLB |= TWI_MCMD_STOP_gc;
-
         return (ptrdiff_t)sent;
 }
 
+/**
+ * @brief Send at most @p size bytes from @p data to @p addr, using @p twi
+ *
+ * @param twi
+ * @param addr
+ * @param data
+ * @param size
+ * @return ptrdiff_t
+ * @retval -ENODEV No device with address @p addr acknowledged the request
+ * @retval -EBUSY Error on bus, or the bus did not respond in time
+ * @retval >=0 Bytes written
+ */
+static ptrdiff_t
+msend_(volatile TWI_t* twi, uint8_t addr, const uint8_t* data, size_t size)
+{
+        ptrdiff_t status = mwrite_(twi, addr, data, size);
+
+        if (status >= 0) {
+                twi->MCTRLB |= TWI_MCMD_STOP_gc;
+        }
+
+        return status;
+}
+
 /**
  * @brief Receive at most @p max bytes from @p addr into @p buf, using @p twi
  *
@@ -183,7 +230,7 @@ msend_(volatile TWI_t* twi, uint8_t addr, const uint8_t* data, size_t size)
  * @param max
  * @return ptrdiff_t
  * @retval -ENODEV No device with address @p addr acknowledged the request
- * @retval -EBUSY Error on bus
+ * @retval -EBUSY Error on bus, or the bus did not respond in time
  * @retval >=0 Bytes received
  */
 static ptrdiff_t
@@ -198,9 +245,9 @@ mrecv_(volatile TWI_t* twi, uint8_t addr, uint8_t* buf, size_t max)
         }
 
         while (bytes < max) {
-                mwait_(twi);
-
-                if (twi->MSTATUS & TWI_WIF_bm) {
+                if (mwait_(twi) != 0) {
+                        return -E_BUSY;
+                } else if (twi->MSTATUS & TWI_WIF_bm) {
                         return -E_IO;
                 }
 
@@ -217,14 +264,49 @@ mrecv_(volatile TWI_t* twi, uint8_t addr, uint8_t* buf, size_t max)
 }
 
 /**
- * @brief Set the slave address of @p twi to @p addr
+ * @brief Write @p wsize bytes from @p wdata to @p addr, and then read at most
+ * @p rsize bytes into @p rbuf in the same transaction, using a repeated start
+ *
+ * @param twi
+ * @param addr
+ * @param wdata
+ * @param wsize
+ * @param rbuf
+ * @param rsize
+ * @return ptrdiff_t
+ * @retval -ENODEV No device with address @p addr acknowledged the request
+ * @retval -EBUSY Error on bus, or the bus did not respond in time
+ * @retval -EIO Transfer was interrupted
+ * @retval >=0 Bytes received
+ */
+static ptrdiff_t mxfer_(
+    volatile TWI_t* twi, uint8_t addr, const uint8_t* wdata, size_t wsize,
+    uint8_t* rbuf, size_t rsize
+)
+{
+        ptrdiff_t status = mwrite_(twi, addr, wdata, wsize);
+        if (status < 0) {
+                return status;
+        }
+
+        /* Writing the address while the bus is still owned issues a repeated
+         * start */
+        return mrecv_(twi, addr, rbuf, rsize);
+}
+
+/* Bit 0 of SADDR enables recognition of the general call address */
+#define GCALL_EN_bm_ (0x01)
+
+/**
+ * @brief Set the slave address of @p twi to @p addr, keeping general call
+ * recognition as it is
  *
  * @param twi
  * @param addr
  */
 static inline void sset_addr_(volatile TWI_t* twi, uint8_t addr)
 {
-        twi->SADDR = addr << 1;
+        twi->SADDR = (addr << 1) | (twi->SADDR & GCALL_EN_bm_);
 }
 
 /**
@@ -241,13 +323,39 @@ static void ssetup_(volatile TWI_t* twi, uint8_t addr)
         (void)twi->SSTATUS;
 }
 
+#define RBUF_SIZE_ (100)
+
 struct ringbuf_ {
-        uint8_t buf[100];
+        uint8_t buf[RBUF_SIZE_];
         size_t head;
         size_t length;
 };
 
-static struct ringbuf_ tx_buf_, rx_buf_;
+/**
+ * @brief Buffers of the slave on one TWI instance
+ */
+struct slave_ {
+        struct ringbuf_ tx_buf;
+        struct ringbuf_ rx_buf;
+        /* The current transaction is addressed to the general call address */
+        bool gcall;
+        /* One bit per byte of rx_buf, set if the byte was received through a
+         * general call */
+        uint8_t gcall_rx[(RBUF_SIZE_ + 7) / 8];
+};
+
+static struct slave_ slaves_[2];
+
+/**
+ * @brief Get the slave buffers of TWI instance @p twi
+ *
+ * @param twi
+ * @return struct slave_*
+ */
+static inline struct slave_* slave_(volatile TWI_t* twi)
+{
+        return &slaves_[twi == &TWI1];
+}
 
 /**
  * @brief Write @p c to ringbuffer @p rbuf
@@ -292,6 +400,25 @@ static int rbuf_read_(struct ringbuf_* rbuf, volatile uint8_t* c)
         return 0;
 }
 
+/**
+ * @brief Record whether the byte last written to the receive buffer of
+ * @p slave was received through a general call
+ *
+ * @param slave
+ */
+static void mark_gcall_(struct slave_* slave)
+{
+        struct ringbuf_* rbuf = &slave->rx_buf;
+        size_t index = (rbuf->head + rbuf->length - 1) % sizeof(rbuf->buf);
+        uint8_t bit = 1 << (index % 8);
+
+        if (slave->gcall) {
+                slave->gcall_rx[index / 8] |= bit;
+        } else {
+                slave->gcall_rx[index / 8] &= ~bit;
+        }
+}
+
 /**
  * @brief Handle slave interrupt for TWI instance @p twi
  *
@@ -299,13 +426,29 @@ static int rbuf_read_(struct ringbuf_* rbuf, volatile uint8_t* c)
  */
 static void sisr_handle_(volatile TWI_t* twi)
 {
+        struct slave_* slave = slave_(twi);
         uint8_t sstatus = twi->SSTATUS;
+        uint8_t data = 0;
+
+        /* SDATA holds a byte from the master after a write or an address.
+         * It is read once here, so that it can be traced. */
+        if ((sstatus & TWI_DIF_bm) ? !(sstatus & TWI_DIR_bm)
+                                   : (sstatus & TWI_APIF_bm) &&
+                                         (sstatus & TWI_AP_ADR_gc)) {
+                data = twi->SDATA;
+        }
+
+        TRACE(TRACE_TWI, sstatus, ((twi == &TWI1) << 8) | data);
 
         if (sstatus & TWI_DIF_bm) {
                 int status;
                 if (!(sstatus & TWI_DIR_bm)) {
                         /* Receive direction */
-                        status = rbuf_write_(&rx_buf_, twi->SDATA);
+                        status = rbuf_write_(&slave->rx_buf, data);
+
+                        if (status == 0) {
+                                mark_gcall_(slave);
+                        }
                 } else {
                         /* Transmit direction */
                         if (is_nack_(sstatus)) {
@@ -316,7 +459,7 @@ static void sisr_handle_(volatile TWI_t* twi)
                                 return;
                         }
 
-                        status = rbuf_read_(&tx_buf_, &twi->SDATA);
+                        status = rbuf_read_(&slave->tx_buf, &twi->SDATA);
                 }
 
                 if (status != 0) {
@@ -331,6 +474,17 @@ static void sisr_handle_(volatile TWI_t* twi)
 
         if (sstatus & TWI_APIF_bm) {
                 if (sstatus & TWI_AP_ADR_gc) {
+                        /* The received address is in SDATA, and the general
+                         * call address may only be written to */
+                        slave->gcall = (data >> 1) == 0;
+
+                        if (slave->gcall && (sstatus & TWI_DIR_bm)) {
+                                twi->SCTRLB =
+                                    TWI_ACKACT_NACK_gc | TWI_SCMD_COMPTRANS_gc;
+
+                                return;
+                        }
+
                         twi->SCTRLB = TWI_ACKACT_ACK_gc | TWI_SCMD_RESPONSE_gc;
                 } else {
                         twi->SCTRLB =
@@ -341,41 +495,89 @@ static void sisr_handle_(volatile TWI_t* twi)
 
 ISR(TWI0_TWIS_vect)
 {
+        PERF_BEGIN(PERF_ISR_TWI0);
         sisr_handle_(&TWI0);
+        PERF_END(PERF_ISR_TWI0);
 }
 
-void i2c_master_init(uint32_t speed, enum i2c_mode mode)
+ISR(TWI1_TWIS_vect)
 {
-        msetup_(&TWI0, speed, mode);
+        PERF_BEGIN(PERF_ISR_TWI1);
+        sisr_handle_(&TWI1);
+        PERF_END(PERF_ISR_TWI1);
 }
 
-ptrdiff_t i2c_master_send(uint8_t addr, const uint8_t* data, size_t size)
+void i2c_master_init(volatile TWI_t* twi, uint32_t speed, enum i2c_mode mode)
 {
-        return msend_(&TWI0, addr, data, size);
+        msetup_(twi, speed, mode);
 }
 
-ptrdiff_t i2c_master_recv(uint8_t addr, uint8_t* buf, size_t size)
+ptrdiff_t i2c_master_send(
+    volatile TWI_t* twi, uint8_t addr, const uint8_t* data, size_t size
+)
 {
-        return mrecv_(&TWI0, addr, buf, size);
+        return msend_(twi, addr, data, size);
 }
 
-void i2c_slave_init(uint8_t addr)
+ptrdiff_t
+i2c_master_recv(volatile TWI_t* twi, uint8_t addr, uint8_t* buf, size_t size)
 {
-        ssetup_(&TWI0, addr);
+        return mrecv_(twi, addr, buf, size);
+}
+
+ptrdiff_t i2c_master_xfer(
+    volatile TWI_t* twi, uint8_t addr, const uint8_t* wdata, size_t wsize,
+    uint8_t* rbuf, size_t rsize
+)
+{
+        return mxfer_(twi, addr, wdata, wsize, rbuf, rsize);
+}
+
+void i2c_slave_init(volatile TWI_t* twi, uint8_t addr)
+{
+        ssetup_(twi, addr);
+}
+
+void i2c_slave_set_addr(volatile TWI_t* twi, uint8_t addr)
+{
+        sset_addr_(twi, addr);
 }
 
-void i2c_slave_set_addr(uint8_t addr)
+void i2c_slave_set_gcall(volatile TWI_t* twi, bool enable)
 {
-        sset_addr_(&TWI0, addr);
+        if (enable) {
+                twi->SADDR |= GCALL_EN_bm_;
+        } else {
+                twi->SADDR &= ~GCALL_EN_bm_;
+        }
+}
+
+bool i2c_slave_peek_gcall(volatile TWI_t* twi)
+{
+        struct slave_* slave = slave_(twi);
+        size_t head;
+        bool gcall = false;
+
+        cli();
+
+        head = slave->rx_buf.head;
+        if (slave->rx_buf.length > 0) {
+                gcall = slave->gcall_rx[head / 8] & (1 << (head % 8));
+        }
+
+        sei();
+
+        return gcall;
 }
 
-size_t i2c_slave_send(const uint8_t* data, size_t size)
+size_t i2c_slave_send(volatile TWI_t* twi, const uint8_t* data, size_t size)
 {
+        struct ringbuf_* tx_buf = &slave_(twi)->tx_buf;
         size_t i = 0;
 
         cli();
 
-        for (; rbuf_write_(&tx_buf_, data[i]) == 0 && --size; i++) {
+        for (; rbuf_write_(tx_buf, data[i]) == 0 && --size; i++) {
         }
 
         sei();
@@ -383,13 +585,14 @@ size_t i2c_slave_send(const uint8_t* data, size_t size)
         return i;
 }
 
-size_t i2c_slave_recv(uint8_t* buf, size_t size)
+size_t i2c_slave_recv(volatile TWI_t* twi, uint8_t* buf, size_t size)
 {
+        struct ringbuf_* rx_buf = &slave_(twi)->rx_buf;
         size_t i = 0;
 
         cli();
 
-        for (; rbuf_read_(&rx_buf_, buf + i) == 0 && --size; i++) {
+        for (; rbuf_read_(rx_buf, buf + i) == 0 && --size; i++) {
         }
 
         sei();
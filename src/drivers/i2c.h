@@ -2,9 +2,12 @@
 #ifndef DRIVER_I2C_H__
 #define DRIVER_I2C_H__
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
+#include <avr/io.h>
+
 enum i2c_mode {
         I2C_MODE_STANDARD = 0,
         I2C_MODE_FAST,
@@ -12,69 +15,129 @@ enum i2c_mode {
 };
 
 /**
- * @brief Initialize the I2C master
+ * @brief Initialize the I2C master on TWI instance @p twi
  *
+ * @param twi
  * @param speed Speed of I2C bus
  * @param mode
  */
-void i2c_master_init(uint32_t speed, enum i2c_mode mode);
+void i2c_master_init(
+    volatile TWI_t* twi, uint32_t speed, enum i2c_mode mode
+);
 
 /**
- * @brief Send @p bytes from @p to I2C device with address @p addr
+ * @brief Send @p bytes from @p to I2C device with address @p addr, on TWI
+ * instance @p twi
  *
+ * @param twi
  * @param addr
  * @param data
  * @param size
  * @return ptrdiff_t
  * @retval -ENODEV No device with address @p addr acknowledged the request
- * @retval -EBUSY Error on bus
+ * @retval -EBUSY Error on bus, or the bus did not respond in time
  * @retval >=0 Bytes written
  */
-ptrdiff_t i2c_master_send(uint8_t addr, const uint8_t* data, size_t size);
+ptrdiff_t i2c_master_send(
+    volatile TWI_t* twi, uint8_t addr, const uint8_t* data, size_t size
+);
 
 /**
- * @brief Receive at most @p max bytes from @p addr into @p buf
+ * @brief Receive at most @p max bytes from @p addr into @p buf, on TWI
+ * instance @p twi
  *
+ * @param twi
  * @param addr
  * @param buf
  * @param max
  * @return ptrdiff_t
  * @retval -ENODEV No device with address @p addr acknowledged the request
- * @retval -EBUSY Error on bus
+ * @retval -EBUSY Error on bus, or the bus did not respond in time
+ * @retval >=0 Bytes received
+ */
+ptrdiff_t
+i2c_master_recv(volatile TWI_t* twi, uint8_t addr, uint8_t* buf, size_t size);
+
+/**
+ * @brief Write @p wsize bytes from @p wdata to @p addr, and then read at most
+ * @p rsize bytes into @p rbuf using a repeated start, without releasing the
+ * bus of TWI instance @p twi in between. This is typically used to set a
+ * register pointer and read from it.
+ *
+ * @param twi
+ * @param addr
+ * @param wdata
+ * @param wsize
+ * @param rbuf
+ * @param rsize
+ * @return ptrdiff_t
+ * @retval -ENODEV No device with address @p addr acknowledged the request
+ * @retval -EBUSY Error on bus, or the bus did not respond in time
+ * @retval -EIO Transfer was interrupted
  * @retval >=0 Bytes received
  */
-ptrdiff_t i2c_master_recv(uint8_t addr, uint8_t* buf, size_t size);
+ptrdiff_t i2c_master_xfer(
+    volatile TWI_t* twi, uint8_t addr, const uint8_t* wdata, size_t wsize,
+    uint8_t* rbuf, size_t rsize
+);
 
 /**
- * @brief Initialize I2C slave with address @p addr
+ * @brief Initialize I2C slave on TWI instance @p twi with address @p addr.
+ * The master and the slave may share the same instance.
  *
+ * @param twi
  * @param addr
  */
-void i2c_slave_init(uint8_t addr);
+void i2c_slave_init(volatile TWI_t* twi, uint8_t addr);
 
 /**
- * @brief Set the slave address to @p addr
+ * @brief Set the slave address of TWI instance @p twi to @p addr
  *
+ * @param twi
  * @param addr
  */
-void i2c_slave_set_addr(uint8_t addr);
+void i2c_slave_set_addr(volatile TWI_t* twi, uint8_t addr);
+
+/**
+ * @brief Enable or disable recognition of the general call address (0) by the
+ * slave on TWI instance @p twi. The general call address can only be written
+ * to, and reads from it are not acknowledged.
+ *
+ * @param twi
+ * @param enable
+ */
+void i2c_slave_set_gcall(volatile TWI_t* twi, bool enable);
+
+/**
+ * @brief Check whether the next byte to be received by the slave on TWI
+ * instance @p twi was sent through a general call
+ *
+ * @param twi
+ * @return bool
+ * @retval false The byte was addressed to the slave, or nothing has been
+ * received
+ */
+bool i2c_slave_peek_gcall(volatile TWI_t* twi);
 
 /**
- * @brief Send @p size bytes from @p data as a slave
+ * @brief Send @p size bytes from @p data as the slave on TWI instance @p twi
  *
+ * @param twi
  * @param data
  * @param size
  * @return size_t Bytes written
  */
-size_t i2c_slave_send(const uint8_t* data, size_t size);
+size_t i2c_slave_send(volatile TWI_t* twi, const uint8_t* data, size_t size);
 
 /**
- * @brief Receive at most @p size bytes into @p buf from master device
+ * @brief Receive at most @p size bytes into @p buf from master device, as the
+ * slave on TWI instance @p twi
  *
+ * @param twi
  * @param buf
  * @param size
  * @return size_t Bytes received
  */
-size_t i2c_slave_recv(uint8_t* buf, size_t size);
+size_t i2c_slave_recv(volatile TWI_t* twi, uint8_t* buf, size_t size);
 
 #endif /* DRIVER_I2C_H__ */
\ No newline at end of file
@@ -6,6 +6,8 @@
 #include <avr/io.h>
 
 #include "../error.h"
+#include "../perf.h"
+#include "../trace.h"
 #include "usart.h"
 
 /**
@@ -53,6 +55,10 @@ static void send_one_(char c)
  */
 static void process_incoming_(char c)
 {
+        PERF_BEGIN(PERF_ISR_USART);
+
+        TRACE(TRACE_RX, c, 0);
+
         uint8_t head = isr_buf_.head;
         uint8_t len = isr_buf_.len;
         unsigned int newlen;
@@ -70,6 +76,8 @@ static void process_incoming_(char c)
         } else {
                 isr_buf_.len = newlen;
         }
+
+        PERF_END(PERF_ISR_USART);
 }
 
 /* Each vector is implemented, as only those that have interrupts configured
@@ -174,6 +182,15 @@ void usart_init(volatile USART_t* const peri, uint32_t baud)
         usart_peri_ = peri;
 }
 
+void usart_set_rs485(bool enable)
+{
+        if (enable) {
+                usart_peri_->CTRLA |= USART_RS485_bm;
+        } else {
+                usart_peri_->CTRLA &= ~USART_RS485_bm;
+        }
+}
+
 void usart_write(const char* str, size_t len)
 {
         while (len--) {
@@ -2,6 +2,7 @@
 #ifndef DRIVER_USART_H__
 #define DRIVER_USART_H__
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -21,6 +22,15 @@ void usart_setup_stdout(void);
  */
 void usart_init(volatile USART_t* const peri, uint32_t baud);
 
+/**
+ * @brief Enable or disable RS-485 mode of the main USART peripheral. While
+ * enabled, the XDIR pin is driven high during transmission, to enable the
+ * driver of a half-duplex bus transceiver. The pin must be set as output.
+ *
+ * @param enable
+ */
+void usart_set_rs485(bool enable);
+
 /**
  * @brief Write @p len bytes from @p str to main USART peripheral
  *
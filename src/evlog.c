@@ -0,0 +1,140 @@
+#include <stdbool.h>
+
+#include "clock.h"
+#include "error.h"
+#include "evlog.h"
+
+/* Number of the newest entries searched for an event to merge a repeat into */
+#define MERGE_DEPTH_ (4)
+
+static struct {
+        struct evlog_entry entries[EVLOG_ENTRIES];
+        /* Time of the latest occurrence of each entry */
+        uint32_t last[EVLOG_ENTRIES];
+        uint8_t head;
+        uint8_t count;
+        uint16_t dropped;
+} log_;
+
+static const char* const sys_names_[EVLOG_SYS_COUNT] = {
+    [EVLOG_SYS_FAN] = "fan",
+    [EVLOG_SYS_CMD] = "cmd",
+    [EVLOG_SYS_ZONE] = "zone",
+};
+
+static const char* const code_names_[EVLOG_CODE_COUNT] = {
+    [EVLOG_FAN_STALL] = "stall",
+    [EVLOG_FAN_UNDERSPEED] = "underspeed",
+    [EVLOG_FAN_RECOVERED] = "recovered",
+    [EVLOG_CMD_DROPPED] = "dropped",
+    [EVLOG_ZONE_POLL] = "poll failed",
+};
+
+/**
+ * @brief Get the index of the entry @p age places before the newest one
+ *
+ * @param age
+ * @return uint8_t
+ */
+static uint8_t newest_(uint8_t age)
+{
+        return (log_.head + log_.count - 1 - age) % EVLOG_ENTRIES;
+}
+
+/**
+ * @brief Merge a repeat of an event into a recent entry of the same event, if
+ * there is one
+ *
+ * @return bool Whether the event was merged
+ */
+static bool merge_(uint8_t sys, uint8_t code, uint16_t a, uint16_t b)
+{
+        uint32_t now = clock_ms();
+
+        for (uint8_t i = 0; i < log_.count && i < MERGE_DEPTH_; i++) {
+                uint8_t index = newest_(i);
+                struct evlog_entry* e = &log_.entries[index];
+
+                if (e->sys != sys || e->code != code || e->a != a ||
+                    now - log_.last[index] >= EVLOG_REPEAT_MS) {
+                        continue;
+                }
+
+                e->b = b;
+                log_.last[index] = now;
+
+                if (e->repeats < UINT16_MAX) {
+                        e->repeats++;
+                }
+
+                return true;
+        }
+
+        return false;
+}
+
+void evlog_add(uint8_t sys, uint8_t code, uint16_t a, uint16_t b)
+{
+        if (merge_(sys, code, a, b)) {
+                return;
+        }
+
+        if (log_.count == EVLOG_ENTRIES) {
+                log_.head = (log_.head + 1) % EVLOG_ENTRIES;
+                log_.count--;
+
+                if (log_.dropped < UINT16_MAX) {
+                        log_.dropped++;
+                }
+        }
+
+        log_.count++;
+
+        uint8_t index = newest_(0);
+        struct evlog_entry* e = &log_.entries[index];
+
+        e->stamp = clock_ms();
+        log_.last[index] = e->stamp;
+        e->sys = sys;
+        e->code = code;
+        e->a = a;
+        e->b = b;
+        e->repeats = 0;
+}
+
+int evlog_take(struct evlog_entry* out)
+{
+        if (log_.count == 0) {
+                return -E_NODATA;
+        }
+
+        *out = log_.entries[log_.head];
+        log_.head = (log_.head + 1) % EVLOG_ENTRIES;
+        log_.count--;
+
+        return 0;
+}
+
+uint8_t evlog_count(void)
+{
+        return log_.count;
+}
+
+uint16_t evlog_take_dropped(void)
+{
+        uint16_t dropped = log_.dropped;
+
+        log_.dropped = 0;
+
+        return dropped;
+}
+
+const char* evlog_sys_name(uint8_t sys)
+{
+        return sys < EVLOG_SYS_COUNT ? sys_names_[sys] : "?";
+}
+
+const char* evlog_code_name(uint8_t code)
+{
+        return code < EVLOG_CODE_COUNT ? code_names_[code] : "?";
+}
@@ -0,0 +1,104 @@
+#ifndef EVLOG_H__
+#define EVLOG_H__
+
+#include <stdint.h>
+
+/* Number of events held. Once full, the oldest event is dropped. */
+#define EVLOG_ENTRIES (32)
+
+/* An event that repeats within this many ms of its previous occurrence is
+ * only counted, instead of taking up a new entry, for as long as its entry
+ * has not been taken out of the log */
+#define EVLOG_REPEAT_MS (2000)
+
+enum evlog_sys {
+        EVLOG_SYS_FAN = 0,
+        EVLOG_SYS_CMD,
+        EVLOG_SYS_ZONE,
+        EVLOG_SYS_COUNT,
+};
+
+enum evlog_code {
+        /* Fan a stalled */
+        EVLOG_FAN_STALL = 0,
+        /* Fan a runs too slow, b is the expected speed in RPM */
+        EVLOG_FAN_UNDERSPEED,
+        /* Fan a is back at its expected speed */
+        EVLOG_FAN_RECOVERED,
+        /* Command a was dropped, b is the packet size */
+        EVLOG_CMD_DROPPED,
+        /* Poll of sensor slot a failed, b is the error code */
+        EVLOG_ZONE_POLL,
+        EVLOG_CODE_COUNT,
+};
+
+/**
+ * @brief One logged event
+ */
+struct __attribute__((packed)) evlog_entry {
+        /* Time of the first occurrence, from `clock_ms` */
+        uint32_t stamp;
+        /* One of `enum evlog_sys` */
+        uint8_t sys;
+        /* One of `enum evlog_code` */
+        uint8_t code;
+        uint16_t a;
+        /* From the latest occurrence */
+        uint16_t b;
+        /* Further occurrences merged into this entry, saturated */
+        uint16_t repeats;
+};
+
+/**
+ * @brief Log event @p code of subsystem @p sys. This only takes a few stores,
+ * and may be called from the main loop at any time, but not from an
+ * interrupt.
+ *
+ * @param sys
+ * @param code
+ * @param a
+ * @param b
+ */
+void evlog_add(uint8_t sys, uint8_t code, uint16_t a, uint16_t b);
+
+/**
+ * @brief Take the oldest event out of the log
+ *
+ * @param out
+ * @return int
+ * @retval -E_NODATA The log is empty
+ * @retval 0 Success
+ */
+int evlog_take(struct evlog_entry* out);
+
+/**
+ * @brief Get the number of events in the log
+ *
+ * @return uint8_t
+ */
+uint8_t evlog_count(void);
+
+/**
+ * @brief Get and reset the number of events dropped because the log was full
+ *
+ * @return uint16_t
+ */
+uint16_t evlog_take_dropped(void);
+
+/**
+ * @brief Get the name of subsystem @p sys
+ *
+ * @param sys
+ * @return const char*
+ */
+const char* evlog_sys_name(uint8_t sys);
+
+/**
+ * @brief Get the name of event @p code
+ *
+ * @param code
+ * @return const char*
+ */
+const char* evlog_code_name(uint8_t code);
+
+#endif /* EVLOG_H__ */
@@ -1,10 +1,20 @@
 #include <avr/interrupt.h>
 #include <avr/io.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
 #include <util/delay.h>
 
-#define TCB_INSTANCE TCB0
+#include "alert.h"
+#include "clock.h"
+#include "error.h"
+#include "fan.h"
+#include "fan_channels.h"
+#include "fanstats.h"
+#include "fault.h"
+#include "perf.h"
+#include "store.h"
+#include "trace.h"
 
 /*fan modes/PWM duty cycle percentages*/
 #define off (0)
@@ -13,81 +23,144 @@
 #define max (100)
 
 /*from fan datasheet graph: rpm corresponding to percentage*/
-static const int SUPPOSED_OFF_RPM = 0;
-static const int SUPPOSED_LOW_RPM = 3500;
-static const int SUPPOSED_MEDIUM_RPM = 8000;
-static const int SUPPOSED_MAX_RPM = 13100;
-
-static uint32_t pulse[8]; // Array to store the pulse values for 8 fans
-static uint32_t rpm[8];   // Array to store the RPM values for 8 fans
-
-/*All fans are set to low at initialisation*/
-/*PD0, PD1, PD2, PD3, PD4, PD5, PB2, PB3*/
-static int fan_speeds[] = {low, low, low, low, low, low, low, low};
-
-/*Definition/calculation of fan value*/
-#define PERIOD (9)
-#define fanspeed_1 ((9 / 100.0) * fan_speeds[0])
-#define fanspeed_2 ((9 / 100.0) * fan_speeds[1])
-#define fanspeed_3 ((9 / 100.0) * fan_speeds[2])
-#define fanspeed_4 ((9 / 100.0) * fan_speeds[3])
-#define fanspeed_5 ((9 / 100.0) * fan_speeds[4])
-#define fanspeed_6 ((9 / 100.0) * fan_speeds[5])
-#define fanspeed_7 ((9 / 100.0) * fan_speeds[6])
-#define fanspeed_8 ((9 / 100.0) * fan_speeds[7])
-
-/*prototypes*/
-void TCA0_init(void);
-void TCA1_init(void);
-void PORT_init(void);
-void check_fan_speeds(uint8_t fan_index);
-
-static register8_t* speed_register(uint8_t fan_index)
-{
-        switch (fan_index) {
-        case 0:
-                return &TCA0.SPLIT.LCMP0;
-        case 1:
-                return &TCA0.SPLIT.LCMP1;
-        case 2:
-                return &TCA0.SPLIT.LCMP2;
-        case 3:
-                return &TCA0.SPLIT.HCMP0;
-        case 4:
-                return &TCA0.SPLIT.HCMP1;
-        case 5:
-                return &TCA0.SPLIT.HCMP2;
-        case 6:
-                return &TCA1.SPLIT.LCMP2;
-        case 7:
-                return &TCA1.SPLIT.HCMP0;
-        }
-
-        return NULL;
-}
-
-void PORT_init(void)
-{
-        /* set pins of PORT D and B as PWM outputs */
-        PORTD.DIR |= PIN0_bm | PIN1_bm | PIN2_bm | PIN3_bm | PIN4_bm | PIN5_bm;
-        PORTB.DIR |= PIN2_bm | PIN3_bm;
-
-        /* tacho (read) pins */
-        PORTC.DIRCLR = PIN0_bm | PIN1_bm | PIN2_bm | PIN3_bm | PIN4_bm |
-                       PIN5_bm | PIN6_bm | PIN7_bm;
-        /* Enable pull-up resistor */
-        PORTC.PIN0CTRL |= PORT_PULLUPEN_bm;
-        PORTC.PIN1CTRL |= PORT_PULLUPEN_bm;
-        PORTC.PIN2CTRL |= PORT_PULLUPEN_bm;
-        PORTC.PIN3CTRL |= PORT_PULLUPEN_bm;
-        PORTC.PIN4CTRL |= PORT_PULLUPEN_bm;
-        PORTC.PIN5CTRL |= PORT_PULLUPEN_bm;
-        PORTC.PIN6CTRL |= PORT_PULLUPEN_bm;
-        PORTC.PIN7CTRL |= PORT_PULLUPEN_bm;
+#define SUPPOSED_OFF_RPM (0)
+#define SUPPOSED_LOW_RPM (3500)
+#define SUPPOSED_MEDIUM_RPM (8000)
+#define SUPPOSED_MAX_RPM (13100)
+
+/**
+ * @brief Measured state of every fan, published with a sequence counter. The
+ * writer makes `seq` odd before updating the state, and even again once done.
+ * Readers copy the state, and retry if `seq` was odd or changed meanwhile, so
+ * they never see a half written value without having to disable interrupts.
+ *
+ * The capture interrupt is the writer. Writes from the main loop must be done
+ * with interrupts disabled, so they do not interleave with the interrupt.
+ */
+static volatile struct {
+        uint8_t seq;
+        struct fan_snapshot snap;
+} state_;
+
+/* Counted by the capture interrupt, to tell how many tacho edges the fan
+ * currently selected produced during its measurement window */
+static volatile uint8_t captures_;
+
+/* Set by the capture interrupt when a new speed has been measured, and
+ * cleared once it has been added to the statistics */
+static volatile bool new_sample_;
+
+/* Duty cycle of each fan, set from the stored profile at initialisation */
+static int fan_speeds[FAN_COUNT];
+
+/* Target speed of each fan in RPM, or 0 if the fan runs at a fixed duty
+ * cycle */
+static uint16_t targets_[FAN_COUNT];
+
+/* Profile each fan currently runs with. It is loaded from the store at
+ * initialisation, and changes are only saved by `fan_save_profiles`. */
+static struct fan_profile profiles_[FAN_COUNT];
+
+/* Time at which every fan had been set up with its stored profile */
+static uint32_t boot_ticks_;
+
+/*Definition/calculation of fan value. Every compare step is a point of the
+ * calibrated curves. */
+#define PERIOD (FAN_CURVE_POINTS - 1)
+
+/* Time given to the fans to settle at each step of a calibration sweep */
+#define CAL_SETTLE_MS_ (3000)
+
+/* A measurement window ends once the fan has produced this many captures, or
+ * after `WINDOW_MS_` for a fan too slow for that. A window is then a few tacho
+ * periods long, and a stalled fan holds up the rotation for `WINDOW_MS_`. */
+#define WINDOW_CAPTURES_ (4)
+#define WINDOW_MS_ (100)
+
+/* Least time between two duty cycle steps when tracking a target speed, so
+ * that the speed has time to settle */
+#define TRACK_MS_ (2000)
+
+/**
+ * @brief State of a running calibration
+ */
+static struct {
+        bool active;
+        /* Compare step being measured */
+        uint8_t step;
+        /* Time the fans were set to the current step */
+        uint32_t since;
+        /* Bitmap of fans not yet measured at the current step */
+        uint16_t pending;
+        uint8_t curve[FAN_COUNT][FAN_CURVE_POINTS];
+} cal_;
+
+/* Time the measurement window of the current fan started */
+static uint32_t window_start_;
+
+struct channel_ {
+        volatile TCA_t* tca;
+        register8_t* cmp;
+        uint8_t cmp_en_bm;
+        volatile PORT_t* port;
+        uint8_t pin_bm;
+        volatile PORT_t* tacho_port;
+        uint8_t tacho_pin;
+        uint8_t tacho_gen;
+};
+
+#define CHANNEL_(tca, cmp, port, pin, tacho_port, tacho_pin, tacho_gen)        \
+        {&tca,                                                                 \
+         &tca.SPLIT.cmp,                                                       \
+         TCA_SPLIT_##cmp##EN_bm,                                               \
+         &port,                                                                \
+         PIN##pin##_bm,                                                        \
+         &tacho_port,                                                          \
+         tacho_pin,                                                            \
+         tacho_gen},
+
+static const struct channel_ channels_[FAN_COUNT] = {FAN_CHANNELS(CHANNEL_)};
+
+/**
+ * @brief Convert duty cycle @p duty_cycle (in percent) to a compare value
+ *
+ * @param duty_cycle
+ * @return uint8_t
+ */
+static uint8_t compare_value_(int duty_cycle)
+{
+        return (uint8_t)((PERIOD * duty_cycle) / 100);
+}
+
+/**
+ * @brief Get the smallest duty cycle that gives compare value @p cmp
+ *
+ * @param cmp
+ * @return uint8_t Duty cycle in percent
+ */
+static uint8_t duty_of_compare_(uint8_t cmp)
+{
+        return (cmp * 100 + PERIOD - 1) / PERIOD;
+}
+
+/**
+ * @brief Setup PWM output and tacho input pins of every fan
+ */
+static void port_init_(void)
+{
+        for (uint8_t i = 0; i < FAN_COUNT; i++) {
+                const struct channel_* ch = &channels_[i];
+
+                ch->port->DIRSET = ch->pin_bm;
+
+                /* Tacho (read) pin, with pull-up enabled */
+                ch->tacho_port->DIRCLR = 1 << ch->tacho_pin;
+                (&ch->tacho_port->PIN0CTRL)[ch->tacho_pin] |= PORT_PULLUPEN_bm;
+        }
 }
 
 /*TCB for frequency measurement*/
-void TCB_init(void)
+static void tcb_init_(void)
 {
         TCB0.CTRLA = TCB_CLKSEL_DIV1_gc |
                      TCB_ENABLE_bm; // Set clock division factor to 1
@@ -98,127 +171,424 @@ void TCB_init(void)
         TCB0.EVCTRL = TCB_CAPTEI_bm;                 // Enable event input
         TCB0.INTCTRL = TCB_CAPT_bm;                  // Enable capture interrupt
         EVSYS.USERTCB0CAPT = EVSYS_USER_CHANNEL2_gc; // Initialize channel 2
-        EVSYS.CHANNEL2 =
-            EVSYS_CHANNEL2_PORTC_PIN0_gc; // Capture first tacho pin
+        EVSYS.CHANNEL2 = channels_[0].tacho_gen;     // Capture first tacho pin
 }
 
-/*TCA0 for control of pins PD0, PD1, PD2, PD3, PD4, PD5*/
-void TCA0_init(void)
+/* Nominal speed at each preset duty cycle, interpolated in between */
+static const struct {
+        int duty;
+        int rpm;
+} curve_[] = {
+    {off, SUPPOSED_OFF_RPM},
+    {low, SUPPOSED_LOW_RPM},
+    {medium, SUPPOSED_MEDIUM_RPM},
+    {max, SUPPOSED_MAX_RPM},
+};
+
+#define CURVE_POINTS_ (sizeof(curve_) / sizeof(curve_[0]))
+
+/**
+ * @brief Get the duty cycle that nominally gives fan @p fan_index a speed of
+ * @p target RPM, used as the starting point when tracking a target speed.
+ * This is the lowest step of the calibrated curve reaching @p target, or if
+ * the fan is not calibrated, an interpolation of the datasheet curve.
+ *
+ * @param fan_index
+ * @param target
+ * @return uint8_t Duty cycle in percent
+ */
+static uint8_t nominal_duty_(uint8_t fan_index, uint16_t target)
 {
-        /* set waveform output on PORT A */
-        PORTMUX.TCAROUTEA = PORTMUX_TCA0_PORTD_gc;
+        const uint8_t* curve = fan_curve(fan_index);
 
-        /* enable split mode */
-        TCA0.SPLIT.CTRLD = TCA_SPLIT_SPLITM_bm;
+        if (curve != NULL) {
+                for (uint8_t i = 0; i < FAN_CURVE_POINTS; i++) {
+                        if ((uint32_t)curve[i] * FAN_CURVE_UNIT >= target) {
+                                return duty_of_compare_(i);
+                        }
+                }
 
-        /* enable compare channel */
-        TCA0.SPLIT.CTRLB = TCA_SPLIT_HCMP0EN_bm | TCA_SPLIT_HCMP1EN_bm |
-                           TCA_SPLIT_HCMP2EN_bm // higher byte
-                           | TCA_SPLIT_LCMP0EN_bm | TCA_SPLIT_LCMP1EN_bm |
-                           TCA_SPLIT_LCMP2EN_bm; // lower byte
+                return max;
+        }
 
-        /* set the PWM frequencies and duty cycles */
-        TCA0.SPLIT.LPER = PERIOD;
-        TCA0.SPLIT.LCMP0 = fanspeed_1;
-        TCA0.SPLIT.LCMP1 = fanspeed_2;
-        TCA0.SPLIT.LCMP2 = fanspeed_3;
+        for (uint8_t i = 1; i < CURVE_POINTS_; i++) {
+                if (target <= curve_[i].rpm) {
+                        int32_t span = curve_[i].duty - curve_[i - 1].duty;
+
+                        return curve_[i - 1].duty +
+                               span * (target - curve_[i - 1].rpm) /
+                                   (curve_[i].rpm - curve_[i - 1].rpm);
+                }
+        }
+
+        return max;
+}
+
+/**
+ * @brief Set the duty cycle of fan @p fan_index to @p duty percent
+ *
+ * @param fan_index
+ * @param duty
+ */
+static void apply_duty_(uint8_t fan_index, uint8_t duty)
+{
+        fan_speeds[fan_index] = duty;
+        *channels_[fan_index].cmp = compare_value_(duty);
+}
+
+/**
+ * @brief Run fan @p fan_index as given by profile @p p. A fan tracking a
+ * target speed starts out at the duty cycle nominally giving that speed.
+ *
+ * @param fan_index
+ * @param p
+ */
+static void apply_profile_(uint8_t fan_index, const struct fan_profile* p)
+{
+        if (p->mode == FAN_MODE_TARGET && p->target != 0) {
+                targets_[fan_index] = p->target;
+                apply_duty_(fan_index, nominal_duty_(fan_index, p->target));
+        } else {
+                targets_[fan_index] = 0;
+                apply_duty_(fan_index, p->duty > max ? max : p->duty);
+        }
+}
 
-        TCA0.SPLIT.HPER = PERIOD;
-        TCA0.SPLIT.HCMP0 = fanspeed_4;
-        TCA0.SPLIT.HCMP1 = fanspeed_5;
-        TCA0.SPLIT.HCMP2 = fanspeed_6;
+/**
+ * @brief Set the profile of fan @p fan_index to @p p, and apply it. During a
+ * calibration it is only applied once the calibration is over.
+ *
+ * @param fan_index
+ * @param p
+ */
+static void set_profile_(uint8_t fan_index, const struct fan_profile* p)
+{
+        profiles_[fan_index] = *p;
 
-        TCA0.SPLIT.CTRLA = TCA_SPLIT_CLKSEL_DIV16_gc /* set clock source
-        (sys_clk/16) */
-                           | TCA_SPLIT_ENABLE_bm;    /* start timer */
+        if (!cal_.active) {
+                apply_profile_(fan_index, p);
+        }
 }
 
-/*TCA1 for control of pins PB2, PB3*/
-void TCA1_init(void)
+/**
+ * @brief Setup every TCA instance used by the channel map in split mode, and
+ * start each fan with its saved profile
+ */
+static void tca_init_(void)
 {
-        /* set waveform output on PORT A */
-        PORTMUX.TCAROUTEA = PORTMUX_TCA1_PORTB_gc;
+        PORTMUX.TCAROUTEA = FAN_TCA_ROUTE;
 
-        /* enable split mode */
-        TCA1.SPLIT.CTRLD = TCA_SPLIT_SPLITM_bm;
+        store_read(fan_profile, &profiles_);
 
-        TCA1.SPLIT.CTRLB = TCA_SPLIT_HCMP0EN_bm | TCA_SPLIT_HCMP1EN_bm |
-                           TCA_SPLIT_HCMP2EN_bm    /* enable compare channel
-for the higher byte */
-                           | TCA_SPLIT_LCMP2EN_bm; /* enable compare channel
-                            for the lower byte */
+        for (uint8_t i = 0; i < FAN_COUNT; i++) {
+                const struct channel_* ch = &channels_[i];
+                volatile TCA_t* tca = ch->tca;
 
-        /* set the PWM frequencies and duty cycles */
-        TCA1.SPLIT.LPER = PERIOD;
-        TCA1.SPLIT.LCMP2 = fanspeed_7;
+                if (!(tca->SPLIT.CTRLD & TCA_SPLIT_SPLITM_bm)) {
+                        tca->SPLIT.CTRLD = TCA_SPLIT_SPLITM_bm;
+                        tca->SPLIT.LPER = PERIOD;
+                        tca->SPLIT.HPER = PERIOD;
+                        tca->SPLIT.DBGCTRL = 1;
+                }
 
-        TCA1.SPLIT.HPER = PERIOD;
-        TCA1.SPLIT.HCMP0 = fanspeed_8;
-        TCA1.SPLIT.DBGCTRL = 1;
+                tca->SPLIT.CTRLB |= ch->cmp_en_bm;
+                apply_profile_(i, &profiles_[i]);
+        }
 
-        TCA1.SPLIT.CTRLA = TCA_SPLIT_CLKSEL_DIV16_gc /* set clock source
-        (sys_clk/16) */
-                           | TCA_SPLIT_ENABLE_bm;    /* start timer */
+        for (uint8_t i = 0; i < FAN_COUNT; i++) {
+                /* set clock source (sys_clk/16), and start timer */
+                channels_[i].tca->SPLIT.CTRLA =
+                    TCA_SPLIT_CLKSEL_DIV16_gc | TCA_SPLIT_ENABLE_bm;
+        }
 }
 
 static uint8_t current_tacho_pin = 0;
 
+static volatile struct fan_irq_latency irq_latency_;
+
+/**
+ * @brief Add @p latency to the capture latency histogram. Called from the
+ * capture interrupt.
+ *
+ * @param latency Cycles from the capture until its interrupt was serviced
+ */
+static void irq_latency_add_(uint16_t latency)
+{
+        uint8_t bucket = 0;
+
+        for (uint16_t l = latency >> 5; l != 0 && bucket < FAN_IRQ_BUCKETS - 1;
+             l >>= 1) {
+                bucket++;
+        }
+
+        irq_latency_.hist[bucket]++;
+        irq_latency_.count++;
+
+        if (latency > irq_latency_.peak) {
+                irq_latency_.peak = latency;
+        }
+}
+
 // TCB0 interrupt routine
 ISR(TCB0_INT_vect)
 {
-        pulse[current_tacho_pin] =
-            TCB0.CCMP; // Store the new capture value for the current tacho pin
+        /* The counter restarts at the capture, and runs at CLK_PER, so it now
+         * holds the cycles taken to get here */
+        uint16_t latency = TCB0.CNT;
+
+        PERF_BEGIN(PERF_ISR_TCB0);
+
+        irq_latency_add_(latency);
+
+        uint16_t pulse = TCB0.CCMP;
+
+        TRACE(TRACE_CAPTURE, current_tacho_pin, pulse);
+
+        if (captures_ < UINT8_MAX) {
+                captures_++;
+        }
+
+        /* The first capture after switching fans is timed from an edge of the
+         * previous fan, so it only tells that this one is spinning */
+        if (captures_ > 1) {
+                state_.seq++;
+
+                state_.snap.pulse[current_tacho_pin] = pulse;
+                /* Calculate corresponding rpm */
+                state_.snap.rpm[current_tacho_pin] =
+                    ((1000000000UL) / ((uint32_t)pulse * 200 * 2)) * 60;
+
+                state_.seq++;
+
+                new_sample_ = true;
+        }
+
+        PERF_END(PERF_ISR_TCB0);
+}
+
+/**
+ * @brief Get the nominal speed of fan @p fan_index, based on its current
+ * duty cycle and its calibrated curve, or the datasheet curve if it has not
+ * been calibrated
+ *
+ * @param fan_index
+ * @return uint16_t Speed in RPM
+ */
+static uint16_t expected_rpm_(uint8_t fan_index)
+{
+        const uint8_t* curve = fan_curve(fan_index);
+        int duty = fan_speeds[fan_index];
+
+        if (targets_[fan_index] != 0) {
+                return targets_[fan_index];
+        }
+
+        if (curve != NULL) {
+                return curve[compare_value_(duty)] * FAN_CURVE_UNIT;
+        }
+
+        for (uint8_t i = 1; i < CURVE_POINTS_; i++) {
+                if (duty <= curve_[i].duty) {
+                        int32_t span = curve_[i].rpm - curve_[i - 1].rpm;
+
+                        return curve_[i - 1].rpm +
+                               span * (duty - curve_[i - 1].duty) /
+                                   (curve_[i].duty - curve_[i - 1].duty);
+                }
+        }
+
+        return SUPPOSED_MAX_RPM;
+}
+
+/**
+ * @brief Run every fan at compare step @p step of the calibration sweep
+ *
+ * @param step
+ */
+static void cal_step_(uint8_t step)
+{
+        cal_.step = step;
+        cal_.since = clock_ms();
+        cal_.pending = (1UL << FAN_COUNT) - 1;
+
+        for (uint8_t i = 0; i < FAN_COUNT; i++) {
+                apply_duty_(i, duty_of_compare_(step));
+        }
+}
+
+/**
+ * @brief Return every fan to its profile, ending the calibration
+ */
+static void cal_end_(void)
+{
+        cal_.active = false;
+
+        for (uint8_t i = 0; i < FAN_COUNT; i++) {
+                apply_profile_(i, &profiles_[i]);
+        }
+}
+
+/**
+ * @brief Record @p speed as the speed of fan @p fan_index at the current
+ * step, if its measurement window started after the fans had settled. Once
+ * every fan has been recorded the sweep moves on to the next step.
+ *
+ * @param fan_index
+ * @param speed
+ */
+static void cal_window_(uint8_t fan_index, uint16_t speed)
+{
+        uint16_t rpm = (speed + FAN_CURVE_UNIT / 2) / FAN_CURVE_UNIT;
+
+        /* Signed, as the window may have started before the step */
+        if ((int32_t)(window_start_ - cal_.since) < CAL_SETTLE_MS_ ||
+            !(cal_.pending & (1 << fan_index))) {
+                return;
+        }
+
+        if (rpm > UINT8_MAX) {
+                rpm = UINT8_MAX;
+        }
+
+        /* A fan slower than a tacho period per capture counter overflow
+         * reads back as noise, so the curve is kept from rising as the duty
+         * cycle falls */
+        if (cal_.step < PERIOD && rpm > cal_.curve[fan_index][cal_.step + 1]) {
+                rpm = cal_.curve[fan_index][cal_.step + 1];
+        }
+
+        cal_.curve[fan_index][cal_.step] = rpm;
+        cal_.pending &= ~(1 << fan_index);
+
+        if (cal_.pending != 0) {
+                return;
+        }
+
+        if (cal_.step > 0) {
+                cal_step_(cal_.step - 1);
+                return;
+        }
+
+        store_update(fan_curve, &cal_.curve);
+        cal_end_();
+}
+
+/**
+ * @brief Move the duty cycle of fan @p fan_index one compare step towards its
+ * target speed, if it has one. This is done at most once per `TRACK_MS_`, so
+ * the speed has time to settle between steps.
+ *
+ * @param fan_index
+ */
+static void track_target_(uint8_t fan_index)
+{
+        static uint32_t tracked_ms[FAN_COUNT];
+        uint16_t target = targets_[fan_index];
+        register8_t* cmp = channels_[fan_index].cmp;
+        /* Dead band around the target, to not hunt between two steps */
+        uint16_t band = target / 16;
+
+        if (target == 0 || clock_ms() - tracked_ms[fan_index] < TRACK_MS_) {
+                return;
+        }
+
+        uint16_t speed = fan_get_speed(fan_index);
+
+        tracked_ms[fan_index] = clock_ms();
 
-        /* Calculate corresponding rpm */
-        rpm[current_tacho_pin] =
-            ((1000000000UL) / (pulse[current_tacho_pin] * 200 * 2)) * 60;
+        if (speed + band < target && *cmp < PERIOD) {
+                (*cmp)++;
+        } else if (speed > target + band && *cmp > 0) {
+                (*cmp)--;
+        } else {
+                return;
+        }
+
+        /* Smallest duty cycle that gives the new compare value */
+        fan_speeds[fan_index] = duty_of_compare_(*cmp);
 }
 
 void fan_tick(void)
 {
-        static int ticks = 0;
-        /* Short delay to reduce errors when switching */
-        if (++ticks < 10000) {
+        if (new_sample_) {
+                /* Cleared before reading, so a capture landing in between is
+                 * picked up on the next call rather than lost */
+                new_sample_ = false;
+
+                fanstats_sample(
+                    current_tacho_pin, fan_get_speed(current_tacho_pin)
+                );
+        }
+
+        if (captures_ < WINDOW_CAPTURES_ &&
+            clock_ms() - window_start_ < WINDOW_MS_) {
                 return;
         }
 
-        ticks = 0;
+        /* The measurement window of the current fan is over. No edges during
+         * the window means that the fan is not spinning, and the last
+         * measured speed is stale. */
+        bool captured = captures_ > 0;
+        if (!captured) {
+                cli();
+                state_.seq++;
+                state_.snap.rpm[current_tacho_pin] = 0;
+                state_.seq++;
+                sei();
+        }
+
+        uint16_t speed = fan_get_speed(current_tacho_pin);
+
+        fanstats_window(current_tacho_pin, captured);
+
+        if (cal_.active) {
+                /* The sweep moves the duty cycle away from the profile, so
+                 * the speed is neither checked nor tracked meanwhile */
+                cal_window_(current_tacho_pin, speed);
+        } else {
+                fault_update(
+                    current_tacho_pin, captured, speed,
+                    expected_rpm_(current_tacho_pin)
+                );
+                alert_rpm(current_tacho_pin, speed);
+                track_target_(current_tacho_pin);
+        }
 
         /* Looping through pins */
-        uint8_t next_tacho_pin = (current_tacho_pin + 1) % 8;
+        uint8_t next_tacho_pin = (current_tacho_pin + 1) % FAN_COUNT;
 
         // Switch to the next tacho pin
-        EVSYS.CHANNEL2 = EVSYS_CHANNEL2_PORTC_PIN0_gc + next_tacho_pin;
+        EVSYS.CHANNEL2 = channels_[next_tacho_pin].tacho_gen;
         current_tacho_pin = next_tacho_pin;
+        captures_ = 0;
+        new_sample_ = false;
+        window_start_ = clock_ms();
 }
 
 void fan_init(void)
 {
-        TCB_init();
-        PORT_init();
-        TCA1_init();
-        TCA0_init();
+        tcb_init_();
+        port_init_();
+        tca_init_();
+
+        boot_ticks_ = clock_ticks();
+}
+
+uint32_t fan_boot_ticks(void)
+{
+        return boot_ticks_;
 }
 
 void fan_check_speed(uint8_t fan_index)
 {
-        int threshold;
-        /* Check speed setting */
-        if (fan_speeds[fan_index] == max) {
-                threshold = SUPPOSED_MAX_RPM;
-        } else if (fan_speeds[fan_index] == medium) {
-                threshold = SUPPOSED_MEDIUM_RPM;
-        } else if (fan_speeds[fan_index] == low) {
-                threshold = SUPPOSED_LOW_RPM;
-        } else {
-                threshold = SUPPOSED_OFF_RPM;
-        }
+        uint8_t faults = fault_get(fan_index);
 
-        /* Check if speed is too low (1500 under supposed rpm) */
-        if (rpm[fan_index] < threshold - 1500) {
+        if (faults & FAULT_STALL) {
+                printf("Error: Fan %d is stalled\r\n", fan_index + 1);
+        } else if (faults & FAULT_UNDERSPEED) {
                 printf(
                     "Error: Fan speed %d is too low, should be: %d\r\n",
-                    fan_index + 1, (int)threshold
+                    fan_index + 1, (int)expected_rpm_(fan_index)
                 );
         }
 }
@@ -226,7 +596,6 @@ void fan_check_speed(uint8_t fan_index)
 void fan_set_speed(uint8_t fan_index, const char* speed)
 {
         int duty_cycle = off;
-        register8_t* reg = NULL;
 
         if (strcmp(speed, "max") == 0) {
                 duty_cycle = max;
@@ -236,16 +605,128 @@ void fan_set_speed(uint8_t fan_index, const char* speed)
                 duty_cycle = low;
         }
 
-        reg = speed_register(fan_index);
-        if (reg == NULL) {
+        fan_set_duty(fan_index, duty_cycle);
+}
+
+void fan_set_duty(uint8_t fan_index, uint8_t duty)
+{
+        struct fan_profile p = {
+            .mode = FAN_MODE_DUTY,
+            .duty = duty > max ? max : duty,
+        };
+
+        if (fan_index >= FAN_COUNT) {
+                return;
+        }
+
+        set_profile_(fan_index, &p);
+}
+
+void fan_set_target_rpm(uint8_t fan_index, uint16_t target)
+{
+        struct fan_profile p = {
+            .mode = target != 0 ? FAN_MODE_TARGET : FAN_MODE_DUTY,
+            .duty = off,
+            .target = target,
+        };
+
+        if (fan_index >= FAN_COUNT) {
                 return;
         }
 
-        fan_speeds[fan_index] = duty_cycle;
-        *reg = (uint8_t)((9 * duty_cycle) / 100);
+        set_profile_(fan_index, &p);
+}
+
+void fan_save_profiles(void)
+{
+        store_update(fan_profile, &profiles_);
+}
+
+int fan_cal_start(void)
+{
+        if (cal_.active) {
+                return -E_BUSY;
+        }
+
+        (void)memset(cal_.curve, 0, sizeof(cal_.curve));
+        cal_.active = true;
+
+        /* Sweeping down from full duty spares the fans a spin-up at every
+         * step */
+        cal_step_(PERIOD);
+
+        return 0;
+}
+
+void fan_cal_abort(void)
+{
+        if (cal_.active) {
+                cal_end_();
+        }
+}
+
+bool fan_cal_running(uint8_t* step)
+{
+        *step = cal_.step;
+        return cal_.active;
+}
+
+void fan_cal_clear(void)
+{
+        uint8_t curves[FAN_COUNT][FAN_CURVE_POINTS] = {{0}};
+
+        store_update(fan_curve, &curves);
+}
+
+const uint8_t* fan_curve(uint8_t fan_index)
+{
+        const uint8_t* curve = store_get(fan_curve)[fan_index];
+
+        return curve[FAN_CURVE_POINTS - 1] != 0 ? curve : NULL;
+}
+
+void fan_irq_latency(struct fan_irq_latency* out)
+{
+        cli();
+        (void)memcpy(out, (const void*)&irq_latency_, sizeof(*out));
+        sei();
+}
+
+void fan_irq_latency_reset(void)
+{
+        cli();
+        (void)memset((void*)&irq_latency_, 0, sizeof(irq_latency_));
+        sei();
+}
+
+uint8_t fan_get_duty(uint8_t fan_index)
+{
+        return (uint8_t)fan_speeds[fan_index];
+}
+
+void fan_snapshot(struct fan_snapshot* out)
+{
+        uint8_t seq;
+
+        do {
+                seq = state_.seq;
+
+                for (uint8_t i = 0; i < FAN_COUNT; i++) {
+                        out->rpm[i] = state_.snap.rpm[i];
+                        out->pulse[i] = state_.snap.pulse[i];
+                }
+        } while ((seq & 1) || seq != state_.seq);
 }
 
 uint16_t fan_get_speed(uint8_t fan_index)
 {
-        return (uint16_t)rpm[fan_index];
+        uint8_t seq;
+        uint16_t speed;
+
+        do {
+                seq = state_.seq;
+                speed = state_.snap.rpm[fan_index];
+        } while ((seq & 1) || seq != state_.seq);
+
+        return speed;
 }
\ No newline at end of file
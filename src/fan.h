@@ -2,24 +2,94 @@
 #ifndef FAN_H__
 #define FAN_H__
 
+#include <stdbool.h>
 #include <stdint.h>
 
+#include "fan_channels.h"
+
+#define FAN_COUNT_ONE_(...) +1
+
+/* Number of fans, as given by the channel map in fan_channels.h */
+#define FAN_COUNT (0 FAN_CHANNELS(FAN_COUNT_ONE_))
+
+enum fan_mode {
+        /* Run at a fixed duty cycle */
+        FAN_MODE_DUTY = 0,
+        /* Adjust the duty cycle to track a target speed */
+        FAN_MODE_TARGET,
+};
+
+/* Points of a calibrated speed curve, one for each PWM compare step from off
+ * to full duty */
+#define FAN_CURVE_POINTS (10)
+/* Unit of the speed stored for each curve point, in RPM */
+#define FAN_CURVE_UNIT (64)
+
+/**
+ * @brief Operating point of a fan, as saved in the store
+ */
+struct fan_profile {
+        /* One of `enum fan_mode` */
+        uint8_t mode;
+        /* Duty cycle in percent, for `FAN_MODE_DUTY` */
+        uint8_t duty;
+        /* Target speed in RPM, for `FAN_MODE_TARGET` */
+        uint16_t target;
+};
+
+/* Buckets of the capture latency histogram. Bucket 0 holds latencies below 32
+ * cycles, and each following bucket covers twice the range of the previous
+ * one, with the last bucket holding everything from 2048 cycles and up. */
+#define FAN_IRQ_BUCKETS (8)
+
 /**
- * @brief Initialize fans
+ * @brief Time from tacho captures until their interrupt handler ran, in CPU
+ * cycles
+ */
+struct fan_irq_latency {
+        uint16_t hist[FAN_IRQ_BUCKETS];
+        /* Longest latency seen */
+        uint16_t peak;
+        uint32_t count;
+};
+
+/**
+ * @brief Consistent view of the measured state of every fan
+ */
+struct fan_snapshot {
+        /* Last measured speed in RPM */
+        uint16_t rpm[FAN_COUNT];
+        /* Last captured tacho period, in TCB0 ticks */
+        uint16_t pulse[FAN_COUNT];
+};
+
+/**
+ * @brief Initialize fans, starting each with the profile saved in the store.
+ * The store must be initialized first.
  */
 void fan_init(void);
 
 /**
- * @brief Check the speed of fan @p index. If the speed is not close to the
- * nominal speed determined by the output of the fan controller, an error
- * will be printed to the console.
+ * @brief Get the time at which `fan_init` had set every fan to its saved
+ * profile
+ *
+ * @return uint32_t Ticks since the clock was started, at `CLOCK_HZ`
+ */
+uint32_t fan_boot_ticks(void);
+
+/**
+ * @brief Check the fault state of fan @p index. If the fan is stalled, or
+ * running too far below the nominal speed determined by the output of the fan
+ * controller, an error will be printed to the console. Faults found in the
+ * background are recorded in the event log by the fault engine instead.
  *
  * @param fan_index Index of fan
  */
 void fan_check_speed(uint8_t fan_index);
 
 /**
- * @brief Set the speed of fan @p index to one of "off", "low", "medium", "max"
+ * @brief Set the speed of fan @p index to one of "off", "low", "medium", "max".
+ * The setting is only restored at boot once saved with `fan_save_profiles`.
  *
  * @param fan_index
  * @param speed
@@ -27,7 +97,108 @@ void fan_check_speed(uint8_t fan_index);
 void fan_set_speed(uint8_t fan_index, const char* speed);
 
 /**
- * @brief Get the last measured speed for fan @p fan_index
+ * @brief Set the duty cycle of fan @p fan_index to @p duty percent, clamped
+ * to 100. This cancels any target speed set with `fan_set_target_rpm`. The
+ * setting is only restored at boot once saved with `fan_save_profiles`.
+ *
+ * @param fan_index
+ * @param duty
+ */
+void fan_set_duty(uint8_t fan_index, uint8_t duty);
+
+/**
+ * @brief Make fan @p fan_index track a speed of @p target RPM, adjusting its
+ * duty cycle one step at a time as it settles. A target of 0 turns the fan
+ * off. The setting is only restored at boot once saved with
+ * `fan_save_profiles`.
+ *
+ * @param fan_index
+ * @param target
+ */
+void fan_set_target_rpm(uint8_t fan_index, uint16_t target);
+
+/**
+ * @brief Save the current setting of every fan to the store, so that each fan
+ * starts with it at boot
+ */
+void fan_save_profiles(void);
+
+/**
+ * @brief Start calibrating every fan. All fans are swept together from full
+ * duty down to off, one PWM compare step at a time, and the speed of each is
+ * recorded once it has settled at each step. Once done the curves are saved
+ * to the store, and every fan returns to its saved profile.
+ *
+ * While calibrating, target speeds are not tracked and no faults or speed
+ * alerts are raised.
+ *
+ * @return int
+ * @retval -E_BUSY A calibration is already running
+ * @retval 0 Calibration started
+ */
+int fan_cal_start(void);
+
+/**
+ * @brief Stop a running calibration without saving it, returning every fan to
+ * its saved profile
+ */
+void fan_cal_abort(void);
+
+/**
+ * @brief Check whether a calibration is running
+ *
+ * @param step Set to the compare step being measured, counting down to 0
+ * @return bool
+ */
+bool fan_cal_running(uint8_t* step);
+
+/**
+ * @brief Forget the saved curve of every fan, falling back to the nominal
+ * curve from the fan datasheet
+ */
+void fan_cal_clear(void);
+
+/**
+ * @brief Get the saved curve of fan @p fan_index
+ *
+ * @param fan_index
+ * @return const uint8_t* Speed at each compare step, in units of
+ * `FAN_CURVE_UNIT`, or NULL if the fan has not been calibrated
+ */
+const uint8_t* fan_curve(uint8_t fan_index);
+
+/**
+ * @brief Get the capture latency histogram since it was last reset
+ *
+ * @param out
+ */
+void fan_irq_latency(struct fan_irq_latency* out);
+
+/**
+ * @brief Reset the capture latency histogram
+ */
+void fan_irq_latency_reset(void);
+
+/**
+ * @brief Get the duty cycle currently output to fan @p fan_index
+ *
+ * @param fan_index
+ * @return uint8_t Duty cycle in percent
+ */
+uint8_t fan_get_duty(uint8_t fan_index);
+
+/**
+ * @brief Get the measured state of every fan, all taken at the same moment.
+ * This never disables interrupts, but must not be called from an interrupt
+ * that can preempt the tacho capture interrupt.
+ *
+ * @param out
+ */
+void fan_snapshot(struct fan_snapshot* out);
+
+/**
+ * @brief Get the last measured speed for fan @p fan_index, without disabling
+ * interrupts
  *
  * @param fan_index
  * @return uint16_t Speed in RPM
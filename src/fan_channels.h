@@ -0,0 +1,39 @@
+/* Channel map of the fans on the board.
+ *
+ * Each entry is X(tca, cmp, port, pin, tacho_port, tacho_pin, tacho_gen):
+ *  - tca/cmp: TCA instance and split mode compare channel driving the PWM
+ *  - port/pin: PWM output pin, which must match the TCA route in
+ *    `FAN_TCA_ROUTE`
+ *  - tacho_port/tacho_pin: Tacho input pin
+ *  - tacho_gen: Event generator of the tacho pin on event channel 2, which
+ *    accepts the pins of PORTC and PORTD
+ *
+ * The fan index is the position in the table. PB0 and PB1 are taken by the
+ * console USART. Boards built with RS485_ENABLE route fan 8 to PB4, as the
+ * USART drives PB3 as XDIR there, see rs485.c.
+ */
+#ifndef FAN_CHANNELS_H__
+#define FAN_CHANNELS_H__
+
+#define FAN_CHANNELS(X)                                                        \
+        X(TCA0, LCMP0, PORTD, 0, PORTC, 0, EVSYS_CHANNEL2_PORTC_PIN0_gc)       \
+        X(TCA0, LCMP1, PORTD, 1, PORTC, 1, EVSYS_CHANNEL2_PORTC_PIN1_gc)       \
+        X(TCA0, LCMP2, PORTD, 2, PORTC, 2, EVSYS_CHANNEL2_PORTC_PIN2_gc)       \
+        X(TCA0, HCMP0, PORTD, 3, PORTC, 3, EVSYS_CHANNEL2_PORTC_PIN3_gc)       \
+        X(TCA0, HCMP1, PORTD, 4, PORTC, 4, EVSYS_CHANNEL2_PORTC_PIN4_gc)       \
+        X(TCA0, HCMP2, PORTD, 5, PORTC, 5, EVSYS_CHANNEL2_PORTC_PIN5_gc)       \
+        X(TCA1, LCMP2, PORTB, 2, PORTC, 6, EVSYS_CHANNEL2_PORTC_PIN6_gc)       \
+        FAN_CHANNEL_8_(X)
+
+#ifdef RS485_ENABLE
+#define FAN_CHANNEL_8_(X)                                                      \
+        X(TCA1, HCMP1, PORTB, 4, PORTC, 7, EVSYS_CHANNEL2_PORTC_PIN7_gc)
+#else
+#define FAN_CHANNEL_8_(X)                                                      \
+        X(TCA1, HCMP0, PORTB, 3, PORTC, 7, EVSYS_CHANNEL2_PORTC_PIN7_gc)
+#endif /* RS485_ENABLE */
+
+/* Output routes of the TCA instances used above */
+#define FAN_TCA_ROUTE (PORTMUX_TCA0_PORTD_gc | PORTMUX_TCA1_PORTB_gc)
+
+#endif /* FAN_CHANNELS_H__ */
@@ -0,0 +1,151 @@
+#include <string.h>
+
+#include "clock.h"
+#include "fan.h"
+#include "fanstats.h"
+
+/* Fractional bits of the running mean */
+#define MEAN_FRAC_ (8)
+
+/**
+ * @brief Accumulator for one fan. The mean and variance are kept using
+ * Welford's algorithm, with the mean in fixed point. The remainder of each
+ * division of the mean update is carried to the next, so that the mean does
+ * not stop following the samples as the count grows. The sum is only used
+ * for the reported mean.
+ */
+struct acc_ {
+        uint16_t min;
+        uint16_t max;
+        uint32_t count;
+        uint64_t sum;
+        int32_t mean;
+        /* Remainder of the mean, in units of 1 / count */
+        int32_t rem;
+        uint64_t m2;
+        uint16_t stalls;
+        uint32_t rotation_ms;
+        uint32_t last_window;
+        uint16_t hist[FANSTATS_BUCKETS];
+};
+
+static struct acc_ acc_[FAN_COUNT];
+
+static struct {
+        struct fanstats fans[FAN_COUNT];
+        uint32_t stamp;
+} snapshot_;
+
+/**
+ * @brief Get the histogram bucket of @p rpm
+ *
+ * @param rpm
+ * @return uint8_t
+ */
+static uint8_t bucket_(uint16_t rpm)
+{
+        uint8_t bucket = 0;
+
+        for (rpm >>= 8; rpm != 0 && bucket < FANSTATS_BUCKETS - 1; rpm >>= 1) {
+                bucket++;
+        }
+
+        return bucket;
+}
+
+void fanstats_sample(uint8_t fan_index, uint16_t rpm)
+{
+        struct acc_* a = &acc_[fan_index];
+
+        if (a->count == 0 || rpm < a->min) {
+                a->min = rpm;
+        }
+        if (rpm > a->max) {
+                a->max = rpm;
+        }
+
+        a->count++;
+        a->sum += rpm;
+
+        int32_t x = (int32_t)rpm << MEAN_FRAC_;
+        int32_t delta = x - a->mean;
+        int32_t t = a->rem + delta;
+        int32_t step = t / (int32_t)a->count;
+
+        /* Keep the remainder in [0, count) */
+        t -= step * (int32_t)a->count;
+        if (t < 0) {
+                step--;
+                t += a->count;
+        }
+
+        a->mean += step;
+        a->rem = t;
+
+        int64_t m2 = (int64_t)delta * (x - a->mean);
+        a->m2 += (m2 + (1L << (2 * MEAN_FRAC_ - 1))) >> (2 * MEAN_FRAC_);
+
+        uint8_t bucket = bucket_(rpm);
+        if (a->hist[bucket] < UINT16_MAX) {
+                a->hist[bucket]++;
+        }
+}
+
+void fanstats_window(uint8_t fan_index, bool captured)
+{
+        struct acc_* a = &acc_[fan_index];
+        uint32_t now = clock_ms();
+
+        /* Windows are far apart for each fan, as the tacho input is shared.
+         * The fan is assumed to have been spinning since its last window if
+         * edges are seen in this one. */
+        if (captured && a->last_window != 0) {
+                a->rotation_ms += now - a->last_window;
+        } else if (!captured && a->stalls < UINT16_MAX) {
+                a->stalls++;
+        }
+
+        a->last_window = now;
+}
+
+void fanstats_get(uint8_t fan_index, struct fanstats* out)
+{
+        const struct acc_* a = &acc_[fan_index];
+
+        out->min = a->min;
+        out->max = a->max;
+        out->mean = a->count > 0 ? (a->sum + a->count / 2) / a->count : 0;
+        out->variance = a->count > 1 ? a->m2 / (a->count - 1) : 0;
+        out->captures = a->count;
+        out->stalls = a->stalls;
+        out->rotation_ms = a->rotation_ms;
+
+        (void)memcpy(out->hist, a->hist, sizeof(out->hist));
+}
+
+void fanstats_reset(void)
+{
+        uint32_t now = clock_ms();
+
+        (void)memset(acc_, 0, sizeof(acc_));
+
+        for (uint8_t i = 0; i < FAN_COUNT; i++) {
+                acc_[i].last_window = now;
+        }
+}
+
+void fanstats_snapshot(void)
+{
+        for (uint8_t i = 0; i < FAN_COUNT; i++) {
+                fanstats_get(i, &snapshot_.fans[i]);
+        }
+
+        snapshot_.stamp = clock_ms();
+}
+
+uint32_t fanstats_snapshot_get(uint8_t fan_index, struct fanstats* out)
+{
+        (void)memcpy(out, &snapshot_.fans[fan_index], sizeof(*out));
+
+        return snapshot_.stamp;
+}
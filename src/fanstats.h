@@ -0,0 +1,73 @@
+#ifndef FANSTATS_H__
+#define FANSTATS_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Number of histogram buckets. Bucket 0 holds speeds below 256 RPM, and each
+ * following bucket covers twice the range of the previous one, with the last
+ * bucket holding everything from 16384 RPM and up. */
+#define FANSTATS_BUCKETS (8)
+
+/**
+ * @brief Statistics of one fan since it was last reset
+ */
+struct __attribute__((packed)) fanstats {
+        uint16_t min;
+        uint16_t max;
+        /* Running mean in RPM */
+        uint16_t mean;
+        /* Running variance in RPM^2 */
+        uint32_t variance;
+        uint32_t captures;
+        uint16_t stalls;
+        /* Time the fan has been observed spinning, in ms */
+        uint32_t rotation_ms;
+        uint16_t hist[FANSTATS_BUCKETS];
+};
+
+/**
+ * @brief Add a speed measurement @p rpm of fan @p fan_index
+ *
+ * @param fan_index
+ * @param rpm
+ */
+void fanstats_sample(uint8_t fan_index, uint16_t rpm);
+
+/**
+ * @brief Record the end of a measurement window of fan @p fan_index
+ *
+ * @param fan_index
+ * @param captured Whether any tacho edge was captured during the window
+ */
+void fanstats_window(uint8_t fan_index, bool captured);
+
+/**
+ * @brief Get the statistics of fan @p fan_index
+ *
+ * @param fan_index
+ * @param out
+ */
+void fanstats_get(uint8_t fan_index, struct fanstats* out);
+
+/**
+ * @brief Reset the statistics of all fans
+ */
+void fanstats_reset(void);
+
+/**
+ * @brief Copy the current statistics of every fan into the snapshot, so they
+ * can be read out later as they were at this moment
+ */
+void fanstats_snapshot(void);
+
+/**
+ * @brief Get the statistics of fan @p fan_index from the last snapshot
+ *
+ * @param fan_index
+ * @param out
+ * @return uint32_t Time the snapshot was taken, from `clock_ms`
+ */
+uint32_t fanstats_snapshot_get(uint8_t fan_index, struct fanstats* out);
+
+#endif /* FANSTATS_H__ */
@@ -0,0 +1,165 @@
+#include <string.h>
+
+#include "alert.h"
+#include "clock.h"
+#include "evlog.h"
+#include "fan.h"
+#include "fault.h"
+
+/* A fan is considered under-speed when it runs more than this far below its
+ * nominal speed, and recovered once it is back within the recovery margin.
+ * The gap between the two is the hysteresis. */
+#define UNDERSPEED_MARGIN_ (1500)
+#define RECOVER_MARGIN_ (750)
+
+/* Time a condition must hold before the fault state changes, in ms. A fan is
+ * stalled once no tacho edge has been seen for `STALL_MS_`. Under-speed waits
+ * longer, so that a fan spinning up after its duty cycle was raised is not
+ * flagged. */
+#define STALL_MS_ (1500)
+#define UNDERSPEED_MS_ (6000)
+#define RECOVER_MS_ (1500)
+
+struct state_ {
+        uint8_t flags;
+        /* Time of the last update */
+        uint32_t update_ms;
+        /* Time each condition was last seen not to hold */
+        uint32_t stall_since;
+        uint32_t slow_since;
+        uint32_t good_since;
+        struct fault_counters counters;
+};
+
+static struct state_ faults_[FAN_COUNT];
+
+/**
+ * @brief Check whether a condition has held for @p hold ms
+ *
+ * @param holds Whether the condition holds now
+ * @param since Time the condition was last seen not to hold, updated if it
+ * does not hold now
+ * @param now
+ * @param hold
+ * @return bool
+ */
+static bool held_(bool holds, uint32_t* since, uint32_t now, uint32_t hold)
+{
+        if (!holds) {
+                *since = now;
+
+                return false;
+        }
+
+        return now - *since >= hold;
+}
+
+/**
+ * @brief Update the fault state @p f of a fan that is expected to be spinning
+ *
+ * @param f
+ * @param now
+ * @param captured
+ * @param rpm
+ * @param expected
+ */
+static void update_(
+    struct state_* f, uint32_t now, bool captured, uint16_t rpm,
+    uint16_t expected
+)
+{
+        bool stalled = !captured;
+        bool slow = !stalled && rpm + UNDERSPEED_MARGIN_ < expected;
+        bool good = !stalled && rpm + RECOVER_MARGIN_ >= expected;
+
+        stalled = held_(stalled, &f->stall_since, now, STALL_MS_);
+        slow = held_(slow, &f->slow_since, now, UNDERSPEED_MS_);
+        good = held_(good, &f->good_since, now, RECOVER_MS_);
+
+        if (stalled && !(f->flags & FAULT_STALL)) {
+                f->flags |= FAULT_STALL;
+                f->counters.stalls++;
+        }
+
+        if (slow) {
+                if (!(f->flags & FAULT_UNDERSPEED)) {
+                        f->counters.underspeeds++;
+                }
+
+                /* Edges are seen again, so the fan is no longer stalled */
+                f->flags = (f->flags & ~FAULT_STALL) | FAULT_UNDERSPEED;
+        }
+
+        if (good && f->flags != 0) {
+                f->flags = 0;
+                f->counters.recoveries++;
+        }
+}
+
+void fault_update(
+    uint8_t fan_index, bool captured, uint16_t rpm, uint16_t expected
+)
+{
+        if (fan_index >= FAN_COUNT) {
+                return;
+        }
+
+        struct state_* f = &faults_[fan_index];
+        uint8_t prev = f->flags;
+        uint32_t now = clock_ms();
+
+        /* Nothing is known of a fan that was off, or not supervised for a
+         * while such as during a calibration, so every condition starts
+         * over */
+        if (expected == 0 || now - f->update_ms > STALL_MS_) {
+                f->stall_since = f->slow_since = f->good_since = now;
+        }
+
+        f->update_ms = now;
+
+        if (expected == 0) {
+                /* Fan is off, nothing to supervise */
+                f->flags = 0;
+        } else {
+                update_(f, now, captured, rpm, expected);
+        }
+
+        if (f->flags == prev) {
+                return;
+        }
+
+        alert_raise(ALERT_FAULT, (uint16_t)1 << fan_index);
+
+        uint8_t raised = f->flags & ~prev;
+
+        if (raised & FAULT_STALL) {
+                evlog_add(EVLOG_SYS_FAN, EVLOG_FAN_STALL, fan_index, 0);
+        }
+        if (raised & FAULT_UNDERSPEED) {
+                evlog_add(
+                    EVLOG_SYS_FAN, EVLOG_FAN_UNDERSPEED, fan_index, expected
+                );
+        }
+        if (f->flags == 0) {
+                evlog_add(EVLOG_SYS_FAN, EVLOG_FAN_RECOVERED, fan_index, 0);
+        }
+}
+
+uint8_t fault_get(uint8_t fan_index)
+{
+        return fan_index < FAN_COUNT ? faults_[fan_index].flags : 0;
+}
+
+const struct fault_counters* fault_counters(uint8_t fan_index)
+{
+        return &faults_[fan_index].counters;
+}
+
+void fault_reset_counters(void)
+{
+        for (uint8_t i = 0; i < FAN_COUNT; i++) {
+                (void)memset(
+                    &faults_[i].counters, 0, sizeof(faults_[i].counters)
+                );
+        }
+}
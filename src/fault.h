@@ -0,0 +1,52 @@
+#ifndef FAULT_H__
+#define FAULT_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+enum fault_flag {
+        FAULT_STALL = 1 << 0,
+        FAULT_UNDERSPEED = 1 << 1,
+};
+
+struct fault_counters {
+        uint16_t stalls;
+        uint16_t underspeeds;
+        uint16_t recoveries;
+};
+
+/**
+ * @brief Feed the result of one tacho measurement window for fan
+ * @p fan_index into the fault engine
+ *
+ * @param fan_index
+ * @param captured Whether any tacho edge was captured during the window
+ * @param rpm Last measured speed
+ * @param expected Nominal speed for the current output, 0 if the fan is off
+ */
+void fault_update(
+    uint8_t fan_index, bool captured, uint16_t rpm, uint16_t expected
+);
+
+/**
+ * @brief Get the active faults of fan @p fan_index
+ *
+ * @param fan_index
+ * @return uint8_t Bitmap of `enum fault_flag`
+ */
+uint8_t fault_get(uint8_t fan_index);
+
+/**
+ * @brief Get the fault counters of fan @p fan_index
+ *
+ * @param fan_index
+ * @return const struct fault_counters*
+ */
+const struct fault_counters* fault_counters(uint8_t fan_index);
+
+/**
+ * @brief Reset the fault counters of all fans. Active faults are kept.
+ */
+void fault_reset_counters(void);
+
+#endif /* FAULT_H__ */
@@ -0,0 +1,224 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include "clock.h"
+#include "fan.h"
+#include "fault.h"
+#include "history.h"
+#include "store.h"
+#include "zone.h"
+
+#define SIZE_ (HISTORY_BLOCK * HISTORY_BLOCKS)
+
+struct __attribute__((packed)) key_ {
+        uint8_t tag;
+        uint32_t stamp;
+        uint16_t rpm[FAN_COUNT];
+        uint8_t duty[FAN_COUNT];
+        uint8_t faults[FAN_COUNT];
+        int16_t temp[ZONE_COUNT];
+};
+
+struct __attribute__((packed)) delta_ {
+        uint8_t tag;
+        uint16_t dt;
+        int8_t rpm[FAN_COUNT];
+        int8_t temp[ZONE_COUNT];
+};
+
+_Static_assert(
+    sizeof(struct key_) <= HISTORY_BLOCK, "Key record must fit in a block"
+);
+
+static uint8_t ring_[SIZE_];
+/* Offset one past the newest byte written */
+static uint32_t end_;
+
+/* Last sample as a decoder will have reconstructed it, which deltas are taken
+ * against so rounding errors do not add up */
+static struct key_ last_;
+static bool have_last_;
+
+/**
+ * @brief Append @p size bytes from @p rec, padding out the current block first
+ * if the record does not fit in it
+ *
+ * @param rec
+ * @param size
+ */
+static void append_(const void* rec, uint8_t size)
+{
+        uint8_t used = end_ % HISTORY_BLOCK;
+
+        if (used + size > HISTORY_BLOCK) {
+                (void)memset(
+                    ring_ + end_ % SIZE_, HISTORY_PAD, HISTORY_BLOCK - used
+                );
+                end_ += HISTORY_BLOCK - used;
+        }
+
+        (void)memcpy(ring_ + end_ % SIZE_, rec, size);
+        end_ += size;
+}
+
+/**
+ * @brief Convert temperature @p temp from mC to 0.1 C, saturating at the
+ * limits of the record field
+ */
+static int16_t temp_(int32_t temp)
+{
+        temp /= 100;
+
+        if (temp <= HISTORY_NO_TEMP) {
+                return HISTORY_NO_TEMP + 1;
+        } else if (temp > INT16_MAX) {
+                return INT16_MAX;
+        }
+
+        return (int16_t)temp;
+}
+
+/**
+ * @brief Take a sample of every fan and zone into @p k
+ */
+static void sample_(struct key_* k)
+{
+        struct fan_snapshot snap;
+
+        k->tag = HISTORY_KEY;
+        k->stamp = clock_ms();
+
+        fan_snapshot(&snap);
+        (void)memcpy(k->rpm, snap.rpm, sizeof(k->rpm));
+
+        for (uint8_t i = 0; i < FAN_COUNT; i++) {
+                k->duty[i] = fan_get_duty(i);
+                k->faults[i] = fault_get(i);
+        }
+
+        for (uint8_t i = 0; i < ZONE_COUNT; i++) {
+                int32_t temp;
+
+                k->temp[i] = zone_get(i, &temp) == 0 ? temp_(temp)
+                                                     : HISTORY_NO_TEMP;
+        }
+}
+
+/**
+ * @brief Encode @p k as a delta against the last sample into @p d, updating
+ * the last sample to what a decoder will reconstruct
+ *
+ * @param k
+ * @param d
+ * @return bool
+ * @retval true Success
+ * @retval false @p k can not be expressed as a delta
+ */
+static bool encode_delta_(const struct key_* k, struct delta_* d)
+{
+        uint32_t dt = k->stamp - last_.stamp;
+
+        if (!have_last_ || dt > UINT16_MAX ||
+            memcmp(k->duty, last_.duty, sizeof(k->duty)) != 0 ||
+            memcmp(k->faults, last_.faults, sizeof(k->faults)) != 0) {
+                return false;
+        }
+
+        d->tag = HISTORY_DELTA;
+        d->dt = (uint16_t)dt;
+
+        for (uint8_t i = 0; i < FAN_COUNT; i++) {
+                int32_t diff = ((int32_t)k->rpm[i] - last_.rpm[i]) /
+                               HISTORY_RPM_UNIT;
+
+                if (diff < INT8_MIN || diff > INT8_MAX) {
+                        return false;
+                }
+
+                d->rpm[i] = (int8_t)diff;
+        }
+
+        for (uint8_t i = 0; i < ZONE_COUNT; i++) {
+                int32_t diff = (int32_t)k->temp[i] - last_.temp[i];
+
+                if ((k->temp[i] == HISTORY_NO_TEMP) !=
+                        (last_.temp[i] == HISTORY_NO_TEMP) ||
+                    diff < INT8_MIN || diff > INT8_MAX) {
+                        return false;
+                }
+
+                d->temp[i] = (int8_t)diff;
+        }
+
+        last_.stamp = k->stamp;
+
+        for (uint8_t i = 0; i < FAN_COUNT; i++) {
+                last_.rpm[i] += d->rpm[i] * HISTORY_RPM_UNIT;
+        }
+
+        for (uint8_t i = 0; i < ZONE_COUNT; i++) {
+                last_.temp[i] += d->temp[i];
+        }
+
+        return true;
+}
+
+void history_tick(void)
+{
+        static uint32_t last_sample;
+        uint32_t interval = store_get(history_interval) * 1000UL;
+        uint32_t now = clock_ms();
+        struct key_ k;
+        struct delta_ d;
+
+        if (interval == 0 || (have_last_ && now - last_sample < interval)) {
+                return;
+        }
+
+        last_sample = now;
+
+        sample_(&k);
+
+        /* Every block must start with a key record */
+        uint8_t used = end_ % HISTORY_BLOCK;
+        bool fits = used != 0 && used + sizeof(d) <= HISTORY_BLOCK;
+
+        if (fits && encode_delta_(&k, &d)) {
+                append_(&d, sizeof(d));
+                return;
+        }
+
+        append_(&k, sizeof(k));
+
+        last_ = k;
+        have_last_ = true;
+}
+
+void history_range(uint32_t* start, uint32_t* end)
+{
+        /* The block being written has overwritten the oldest block */
+        uint32_t block_end = (end_ / HISTORY_BLOCK + 1) * HISTORY_BLOCK;
+
+        *start = block_end > SIZE_ ? block_end - SIZE_ : 0;
+        *end = end_;
+}
+
+size_t history_read(uint32_t* offset, uint8_t* buf, size_t max)
+{
+        uint32_t start, end;
+        size_t i = 0;
+
+        history_range(&start, &end);
+
+        if (*offset < start) {
+                *offset = start;
+        } else if (*offset > end) {
+                *offset = end;
+        }
+
+        for (; i < max && *offset + i < end; i++) {
+                buf[i] = ring_[(*offset + i) % SIZE_];
+        }
+
+        return i;
+}
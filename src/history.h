@@ -0,0 +1,73 @@
+#ifndef HISTORY_H__
+#define HISTORY_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Size of one block of the history ring. Every block starts with a key
+ * record, so decoding can start at any block boundary. */
+#define HISTORY_BLOCK (128)
+/* Number of blocks in the history ring */
+#define HISTORY_BLOCKS (32)
+
+/* Record tags. The rest of a block that can not fit another record is filled
+ * with `HISTORY_PAD`. */
+#define HISTORY_KEY (0xA5)
+#define HISTORY_DELTA (0x5A)
+#define HISTORY_PAD (0xFF)
+
+/* Unit of the speed deltas, in RPM */
+#define HISTORY_RPM_UNIT (16)
+/* Temperature of a zone without fresh readings */
+#define HISTORY_NO_TEMP (INT16_MIN)
+
+/*
+ * Records are little-endian, and laid out as follows.
+ *
+ * Key record, a complete sample:
+ *   uint8_t tag = HISTORY_KEY
+ *   uint32_t stamp         Time of the sample, from `clock_ms`
+ *   uint16_t rpm[FAN_COUNT]
+ *   uint8_t duty[FAN_COUNT]     In percent
+ *   uint8_t faults[FAN_COUNT]   Bitmap of `enum fault_flag`
+ *   int16_t temp[ZONE_COUNT]    In 0.1 C, `HISTORY_NO_TEMP` if unknown
+ *
+ * Delta record, the change since the previous sample:
+ *   uint8_t tag = HISTORY_DELTA
+ *   uint16_t dt            Time since the previous sample, in ms
+ *   int8_t rpm[FAN_COUNT]      In units of `HISTORY_RPM_UNIT`
+ *   int8_t temp[ZONE_COUNT]    In 0.1 C
+ *
+ * Duty cycles and fault bits are unchanged by a delta record. A key record is
+ * written instead whenever they change, or a delta does not fit.
+ */
+
+/**
+ * @brief Record a sample, if the configured interval has passed since the
+ * last one. This should be called from the main loop.
+ */
+void history_tick(void);
+
+/**
+ * @brief Get the range of offsets currently held by the history. Offsets
+ * count every byte ever written to the history, so they stay valid for
+ * resuming a download until the data is overwritten.
+ *
+ * @param start Offset of the oldest byte, at the start of a block
+ * @param end Offset one past the newest byte
+ */
+void history_range(uint32_t* start, uint32_t* end);
+
+/**
+ * @brief Read at most @p max bytes of history into @p buf, starting at offset
+ * @p offset. If the data at @p offset has been overwritten, reading starts at
+ * the oldest byte instead, and @p offset is updated to match.
+ *
+ * @param offset
+ * @param buf
+ * @param max
+ * @return size_t Bytes read, 0 once the end of the history is reached
+ */
+size_t history_read(uint32_t* offset, uint8_t* buf, size_t max);
+
+#endif /* HISTORY_H__ */
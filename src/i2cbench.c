@@ -0,0 +1,98 @@
+#include <stddef.h>
+#include <string.h>
+
+#include <avr/io.h>
+
+#include "clock.h"
+#include "drivers/i2c.h"
+#include "error.h"
+#include "i2cbench.h"
+
+/* TCB1 runs at CLK_PER / 2, and wraps after about 32 ms at 4 MHz. Transfers
+ * that take more than this many clock ticks are timed by the clock instead,
+ * so that the counter can not have wrapped more than once. */
+#define TIMER_MAX_TICKS_ (CLOCK_HZ / 64)
+
+/**
+ * @brief Convert @p ticks of the clock to us
+ */
+static uint32_t ticks_us_(uint32_t ticks)
+{
+        return (uint64_t)ticks * 1000000UL / CLOCK_HZ;
+}
+
+/**
+ * @brief Run one transfer, and record its result in @p out
+ */
+static void transfer_(
+    volatile TWI_t* twi, uint8_t addr, uint8_t* buf, uint8_t bytes,
+    struct i2cbench_result* out
+)
+{
+        uint32_t ticks = clock_ticks();
+        uint16_t start = TCB1.CNT;
+        ptrdiff_t status = bytes > 0 ? i2c_master_recv(twi, addr, buf, bytes)
+                                     : i2c_master_send(twi, addr, buf, 0);
+        uint16_t end = TCB1.CNT;
+
+        ticks = clock_ticks() - ticks;
+
+        switch (status) {
+        case -E_NODEV:
+                out->nodev++;
+                return;
+        case -E_BUSY:
+                out->busy++;
+                return;
+        case -E_IO:
+                out->io++;
+                return;
+        default:
+                break;
+        }
+
+        uint32_t us = ticks < TIMER_MAX_TICKS_
+                          ? (uint32_t)(uint16_t)(end - start) * 2 /
+                                (F_CPU / 1000000UL)
+                          : ticks_us_(ticks);
+
+        if (out->ok == 0 || us < out->lat_min) {
+                out->lat_min = us;
+        }
+        if (us > out->lat_max) {
+                out->lat_max = us;
+        }
+
+        out->lat_total += us;
+        out->ok++;
+}
+
+int i2cbench_run(
+    volatile TWI_t* twi, uint8_t addr, uint8_t bytes, uint16_t iterations,
+    struct i2cbench_result* out
+)
+{
+        uint8_t buf[I2CBENCH_MAX_BYTES];
+
+        if (bytes > sizeof(buf)) {
+                return -E_INVAL;
+        }
+
+        (void)memset(out, 0, sizeof(*out));
+
+        TCB1.CCMP = 0xFFFF;
+        TCB1.CTRLB = TCB_CNTMODE_INT_gc;
+        TCB1.CTRLA = TCB_CLKSEL_DIV2_gc | TCB_ENABLE_bm;
+
+        uint32_t start = clock_ticks();
+
+        for (uint16_t i = 0; i < iterations; i++) {
+                transfer_(twi, addr, buf, bytes, out);
+        }
+
+        out->elapsed_us = ticks_us_(clock_ticks() - start);
+
+        TCB1.CTRLA = 0;
+
+        return 0;
+}
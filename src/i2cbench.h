@@ -0,0 +1,48 @@
+#ifndef I2CBENCH_H__
+#define I2CBENCH_H__
+
+#include <stdint.h>
+
+#include <avr/io.h>
+
+/* Largest transfer that can be benchmarked, in bytes */
+#define I2CBENCH_MAX_BYTES (64)
+
+/**
+ * @brief Result of one benchmark run
+ */
+struct i2cbench_result {
+        /* Transfers that completed */
+        uint16_t ok;
+        uint16_t nodev;
+        uint16_t busy;
+        uint16_t io;
+        /* Time the whole run took, in us */
+        uint32_t elapsed_us;
+        /* Latency of the transfers that completed, in us */
+        uint32_t lat_min;
+        uint32_t lat_max;
+        uint32_t lat_total;
+};
+
+/**
+ * @brief Run @p iterations back-to-back transfers with @p addr as master on
+ * TWI instance @p twi, timed by TCB1. Each transfer reads @p bytes bytes, or
+ * with 0 bytes only sends the address. This blocks until every transfer is
+ * done.
+ *
+ * @param twi
+ * @param addr
+ * @param bytes
+ * @param iterations
+ * @param out
+ * @return int
+ * @retval -EINVAL @p bytes is more than `I2CBENCH_MAX_BYTES`
+ * @retval 0 Success, see @p out for the transfers that failed
+ */
+int i2cbench_run(
+    volatile TWI_t* twi, uint8_t addr, uint8_t bytes, uint16_t iterations,
+    struct i2cbench_result* out
+);
+
+#endif /* I2CBENCH_H__ */
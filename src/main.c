@@ -6,40 +6,83 @@
 #include <avr/io.h>
 #include <util/delay.h>
 
+#include "alert.h"
+#include "clock.h"
 #include "cmd.h"
 #include "drivers/i2c.h"
 #include "drivers/usart.h"
 #include "fan.h"
+#include "history.h"
+#include "perf.h"
+#include "rs485.h"
 #include "store.h"
+#include "zone.h"
 
 extern void shell_tick(void);
 extern void fan_tick(void);
 
 int main(void)
 {
+        clock_init();
+
+        /* The fans are brought to their saved operating point before anything
+         * else is set up, see `fan_boot_ticks` */
+        store_init();
+        fan_init();
+
+        perf_init();
+
         /* Setup I2C controller pins */
         PORTA.DIRSET = PIN2_bm | PIN3_bm;
         PORTA.PINCONFIG = PORT_PULLUPEN_bm;
         PORTA.PINCTRLUPD = PIN2_bm | PIN3_bm;
 
-        /* Setup USART3 controller */
-        PORTB.DIR = 1 << 0;
+        /* Setup sensor bus pins, TWI1 is on PF2 and PF3 */
+        PORTF.PINCONFIG = PORT_PULLUPEN_bm;
+        PORTF.PINCTRLUPD = PIN2_bm | PIN3_bm;
 
-        store_init();
+        /* Setup USART3 controller. The fans on PORTB are already running, so
+         * only the TX pin is changed. */
+        PORTB.DIRSET = PIN0_bm;
 
         usart_init(&USART3, 9600);
         usart_setup_stdout();
+        rs485_init();
 
-        fan_init();
+        alert_init();
 
-        i2c_master_init(100000, I2C_MODE_STANDARD);
+        i2c_master_init(&ZONE_TWI, 100000, I2C_MODE_STANDARD);
 
-        i2c_slave_init(store_get(i2c_slave_addr));
+        i2c_slave_init(&CMD_TWI, store_get(i2c_slave_addr));
+        i2c_slave_set_gcall(&CMD_TWI, store_get(i2c_gcall));
+
+        /* Tacho capture is the only level 1 interrupt, so that it preempts
+         * the I2C, USART, RTC and EEPROM handlers, which all run at level 0.
+         * A capture that waits too long is overwritten by the next. */
+        CPUINT.LVL1VEC = TCB0_INT_vect_num;
         sei();
 
         while (1) {
+                PERF_BEGIN(PERF_LOOP);
+
+                PERF_BEGIN(PERF_SHELL);
                 shell_tick();
+                PERF_END(PERF_SHELL);
+
+                PERF_BEGIN(PERF_CMD);
                 cmd_tick();
+                PERF_END(PERF_CMD);
+
+                PERF_BEGIN(PERF_FAN);
                 fan_tick();
+                PERF_END(PERF_FAN);
+
+                PERF_BEGIN(PERF_ZONE);
+                zone_tick();
+                PERF_END(PERF_ZONE);
+
+                history_tick();
+
+                PERF_END(PERF_LOOP);
         }
 }
\ No newline at end of file
@@ -0,0 +1,64 @@
+#include <string.h>
+
+#include <avr/interrupt.h>
+#include <avr/io.h>
+
+#include "perf.h"
+
+#ifdef PERF_ENABLE
+
+static struct perf_entry entries_[PERF_PROBES];
+
+static const char* const names_[PERF_PROBES] = {
+    [PERF_LOOP] = "loop",
+    [PERF_SHELL] = "shell_tick",
+    [PERF_CMD] = "cmd_tick",
+    [PERF_FAN] = "fan_tick",
+    [PERF_ZONE] = "zone_tick",
+    [PERF_ISR_TCB0] = "TCB0 ISR",
+    [PERF_ISR_TWI0] = "TWI0 ISR",
+    [PERF_ISR_TWI1] = "TWI1 ISR",
+    [PERF_ISR_USART] = "USART ISR",
+};
+
+void perf_init(void)
+{
+        TCB2.CCMP = 0xFFFF;
+        TCB2.CTRLB = TCB_CNTMODE_INT_gc;
+        TCB2.CTRLA = TCB_CLKSEL_DIV1_gc | TCB_ENABLE_bm;
+}
+
+void perf_record(enum perf_probe probe, uint16_t cycles)
+{
+        struct perf_entry* e = &entries_[probe];
+
+        if (e->count == 0 || cycles < e->min) {
+                e->min = cycles;
+        }
+        if (cycles > e->max) {
+                e->max = cycles;
+        }
+
+        e->count++;
+        e->total += cycles;
+}
+
+void perf_take(enum perf_probe probe, struct perf_entry* out)
+{
+        uint8_t sreg = SREG;
+
+        /* Interrupt probes may update the entry while it is copied */
+        cli();
+
+        *out = entries_[probe];
+        (void)memset(&entries_[probe], 0, sizeof(entries_[probe]));
+
+        SREG = sreg;
+}
+
+const char* perf_name(enum perf_probe probe)
+{
+        return names_[probe];
+}
+
+#endif /* PERF_ENABLE */
@@ -0,0 +1,79 @@
+/* Cycle instrumentation of the main loop and interrupt handlers.
+ *
+ * Only compiled in when PERF_ENABLE is defined. Otherwise every macro below
+ * expands to nothing, and no timer or memory is used.
+ */
+#ifndef PERF_H__
+#define PERF_H__
+
+#include <stdint.h>
+
+enum perf_probe {
+        PERF_LOOP = 0,
+        PERF_SHELL,
+        PERF_CMD,
+        PERF_FAN,
+        PERF_ZONE,
+        PERF_ISR_TCB0,
+        PERF_ISR_TWI0,
+        PERF_ISR_TWI1,
+        PERF_ISR_USART,
+        PERF_PROBES,
+};
+
+struct perf_entry {
+        uint32_t count;
+        uint16_t min;
+        uint16_t max;
+        uint64_t total;
+};
+
+#ifdef PERF_ENABLE
+
+#include <avr/io.h>
+
+/**
+ * @brief Start TCB2 as a free running cycle counter. A section that takes more
+ * than 65535 cycles (about 16 ms at 4 MHz) is recorded modulo that.
+ */
+void perf_init(void);
+
+/**
+ * @brief Record one run of probe @p probe that took @p cycles
+ *
+ * @param probe
+ * @param cycles
+ */
+void perf_record(enum perf_probe probe, uint16_t cycles);
+
+/**
+ * @brief Copy the entry of probe @p probe into @p out, and reset it
+ *
+ * @param probe
+ * @param out
+ */
+void perf_take(enum perf_probe probe, struct perf_entry* out);
+
+/**
+ * @brief Get the name of probe @p probe
+ *
+ * @param probe
+ * @return const char*
+ */
+const char* perf_name(enum perf_probe probe);
+
+#define PERF_NOW() ((uint16_t)TCB2.CNT)
+
+#define PERF_BEGIN(probe) uint16_t perf_start_##probe##__ = PERF_NOW()
+#define PERF_END(probe)                                                        \
+        perf_record(probe, PERF_NOW() - perf_start_##probe##__)
+
+#else
+
+#define perf_init()
+#define PERF_BEGIN(probe)
+#define PERF_END(probe)
+
+#endif /* PERF_ENABLE */
+
+#endif /* PERF_H__ */
@@ -0,0 +1,149 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <avr/io.h>
+
+#include "alert.h"
+#include "drivers/usart.h"
+#include "fan.h"
+#include "fan_channels.h"
+#include "fault.h"
+#include "rs485.h"
+#include "store.h"
+#include "zone.h"
+
+#ifdef RS485_ENABLE
+
+/* XDIR of USART3, on its default pins. USART3 has no alternate route with
+ * XDIR on the 48 pin package. */
+#define XDIR_PORT_ PORTB
+#define XDIR_PIN_bm_ PIN3_bm
+
+/* Fail the build if a fan channel uses the XDIR pin, as both the USART and
+ * the fan would then drive it. Identifiers left undefined are 0 in `#if`. */
+#define XDIR_PORTB_3_ 1
+#define USES_XDIR_(tca, cmp, port, pin, tacho_port, tacho_pin, tacho_gen)      \
+        XDIR_##port##_##pin##_ + XDIR_##tacho_port##_##tacho_pin##_ +
+
+#if FAN_CHANNELS(USES_XDIR_) 0
+#error "A fan channel uses the XDIR pin of the console USART"
+#endif
+
+#endif /* RS485_ENABLE */
+
+static bool enabled_;
+
+/**
+ * @brief Update the CRC-8 @p crc with the @p size bytes at @p data
+ *
+ * @param crc
+ * @param data
+ * @param size
+ * @return uint8_t
+ */
+static uint8_t crc8_(uint8_t crc, const uint8_t* data, uint8_t size)
+{
+        while (size--) {
+                crc ^= *data++;
+
+                for (uint8_t i = 0; i < 8; i++) {
+                        crc = crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1;
+                }
+        }
+
+        return crc;
+}
+
+void rs485_init(void)
+{
+#ifdef RS485_ENABLE
+        enabled_ = store_get(rs485);
+
+        if (!enabled_) {
+                return;
+        }
+
+        XDIR_PORT_.OUTCLR = XDIR_PIN_bm_;
+        XDIR_PORT_.DIRSET = XDIR_PIN_bm_;
+
+        usart_set_rs485(true);
+#endif /* RS485_ENABLE */
+}
+
+bool rs485_enabled(void)
+{
+        return enabled_;
+}
+
+char* rs485_match(char* line)
+{
+        char* end;
+
+        if (line[0] != RS485_ADDR) {
+                return NULL;
+        }
+
+        unsigned long node = strtoul(line + 1, &end, 10);
+
+        if (end == line + 1 || node != store_get(node_id) ||
+            (*end != ' ' && *end != '\0')) {
+                return NULL;
+        }
+
+        while (*end == ' ') {
+                end++;
+        }
+
+        return end;
+}
+
+bool rs485_query(const uint8_t* query)
+{
+        uint8_t node = store_get(node_id);
+
+        if (query[0] != RS485_QUERY || query[1] != node ||
+            query[2] != (uint8_t)~node) {
+                return false;
+        }
+
+        struct fan_snapshot snap;
+        struct rs485_status status;
+        uint8_t head[] = {RS485_REPLY, node, sizeof(status)};
+
+        fan_snapshot(&snap);
+        (void)memcpy(status.rpm, snap.rpm, sizeof(status.rpm));
+
+        for (uint8_t i = 0; i < FAN_COUNT; i++) {
+                status.duty[i] = fan_get_duty(i);
+                status.faults[i] = fault_get(i);
+        }
+
+        for (uint8_t i = 0; i < ZONE_COUNT; i++) {
+                int32_t temp;
+
+                status.temp[i] = zone_get(i, &temp) == 0 ? temp : INT32_MIN;
+        }
+
+        uint16_t fans;
+
+        status.alert_events = alert_pending(&fans);
+        status.alert_fans = fans;
+
+        uint8_t crc = crc8_(0, head, sizeof(head));
+
+        crc = crc8_(crc, (const uint8_t*)&status, sizeof(status));
+
+        usart_write((const char*)head, sizeof(head));
+        usart_write((const char*)&status, sizeof(status));
+        usart_write((const char*)&crc, 1);
+
+        return true;
+}
+
+void rs485_end_reply(void)
+{
+        const char eot = RS485_EOT;
+
+        usart_write(&eot, 1);
+}
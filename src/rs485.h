@@ -0,0 +1,95 @@
+/* Console on a half-duplex RS-485 bus shared by many boards.
+ *
+ * In RS-485 mode the console USART drives XDIR (PB3) while sending, to enable
+ * the driver of the bus transceiver, and a board only answers what is
+ * addressed to its node ID:
+ *
+ * - A text command is a shell line prefixed with "@<node id> ". It is not
+ *   echoed, and the reply ends with `RS485_EOT`. Lines without an address, or
+ *   addressed to another node, are ignored. A line starts at its "@", and
+ *   anything received before it, such as the reply of another board, is
+ *   dropped.
+ * - A binary status query is `RS485_QUERY`, the node ID, and the node ID
+ *   inverted. The reply is `RS485_REPLY`, the node ID, the length of the
+ *   payload, the payload (`struct rs485_status`), and a CRC-8 (polynomial
+ *   0x07, initial value 0) of everything before it.
+ *
+ * Only compiled in when RS485_ENABLE is defined, which also moves the PWM
+ * output of fan 8 from PB3 to PB4, see fan_channels.h. Otherwise the console
+ * stays point to point and the rs485 command is left out.
+ */
+#ifndef RS485_H__
+#define RS485_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "fan.h"
+#include "zone.h"
+
+#define RS485_QUERY (0x01)
+#define RS485_REPLY (0x02)
+#define RS485_EOT (0x04)
+/* Starts the address of a text command */
+#define RS485_ADDR ('@')
+
+/* Bytes in a binary status query */
+#define RS485_QUERY_SIZE (3)
+
+/* Highest node ID */
+#define RS485_NODE_MAX (127)
+
+/**
+ * @brief Payload of the reply to a status query
+ */
+struct __attribute__((packed)) rs485_status {
+        uint16_t rpm[FAN_COUNT];
+        /* Duty cycle in percent */
+        uint8_t duty[FAN_COUNT];
+        /* Bitmap of `enum fault_flag` */
+        uint8_t faults[FAN_COUNT];
+        /* Temperature in mC, INT32_MIN for a zone without data */
+        int32_t temp[ZONE_COUNT];
+        /* Pending alert events, and the fans they relate to, as reported by
+         * `alert_pending` */
+        uint8_t alert_events;
+        uint16_t alert_fans;
+};
+
+/**
+ * @brief Switch the console to RS-485 mode, if enabled in the store. This must
+ * be called after the console USART has been initialized.
+ */
+void rs485_init(void);
+
+/**
+ * @brief Check whether the console is in RS-485 mode
+ *
+ * @return bool
+ */
+bool rs485_enabled(void);
+
+/**
+ * @brief Check whether the text line @p line is addressed to this board
+ *
+ * @param line
+ * @return char* The command following the address, or NULL if the line is
+ * not for this board
+ */
+char* rs485_match(char* line);
+
+/**
+ * @brief Handle the status query @p query of `RS485_QUERY_SIZE` bytes,
+ * replying if it is addressed to this board
+ *
+ * @param query
+ * @return bool Whether @p query was a query addressed to this board
+ */
+bool rs485_query(const uint8_t* query);
+
+/**
+ * @brief End the reply to a text command
+ */
+void rs485_end_reply(void);
+
+#endif /* RS485_H__ */
@@ -6,11 +6,23 @@
 #include <avr/interrupt.h>
 #include <avr/io.h>
 
+#include "alert.h"
+#include "clock.h"
+#include "cmd.h"
 #include "drivers/i2c.h"
 #include "drivers/usart.h"
 #include "error.h"
+#include "evlog.h"
 #include "fan.h"
+#include "fanstats.h"
+#include "fault.h"
+#include "history.h"
+#include "i2cbench.h"
+#include "perf.h"
+#include "rs485.h"
 #include "store.h"
+#include "trace.h"
+#include "zone.h"
 
 #define BUF_SIZE_ (64)
 #define TERM_CHAR_ ('\r')
@@ -20,8 +32,14 @@
 
 static struct {
         char tmpbuf[BUF_SIZE_];
-        char* args[5];
+        /* Tokens of the line, followed by NULL */
+        char* args[6];
         uint8_t tmpidx;
+        /* Binary frame being received in RS-485 mode, with its first bytes
+         * kept to check a status query once complete */
+        uint8_t query[RS485_QUERY_SIZE];
+        uint16_t frame;
+        uint16_t frame_size;
 } sh_buf_;
 
 static int say_hello(int argc, char** argv)
@@ -41,7 +59,7 @@ static int i2c_addr_set_(int argc, char** argv)
         uint8_t addr = atoi(argv[1]);
         store_update(i2c_slave_addr, &addr);
 
-        i2c_slave_set_addr(addr);
+        i2c_slave_set_addr(&CMD_TWI, addr);
 
         (void)printf("I2C slave address set to %i\r\n", (int)addr);
 
@@ -54,6 +72,100 @@ static int i2c_addr_get_(int argc, char** argv)
         return 0;
 }
 
+static int i2c_gcall_(int argc, char** argv)
+{
+        if (argc >= 2) {
+                uint8_t enable;
+
+                if (strcmp(argv[1], "on") == 0) {
+                        enable = 1;
+                } else if (strcmp(argv[1], "off") == 0) {
+                        enable = 0;
+                } else {
+                        return E_INVAL;
+                }
+
+                store_update(i2c_gcall, &enable);
+                i2c_slave_set_gcall(&CMD_TWI, enable);
+        }
+
+        (void)printf(
+            "General call %s\r\n", store_get(i2c_gcall) ? "on" : "off"
+        );
+
+        return 0;
+}
+
+#ifdef RS485_ENABLE
+static int rs485_(int argc, char** argv)
+{
+        if (argc >= 2) {
+                uint8_t enable;
+
+                if (strcmp(argv[1], "on") == 0) {
+                        enable = 1;
+                } else if (strcmp(argv[1], "off") == 0) {
+                        enable = 0;
+                } else {
+                        return E_INVAL;
+                }
+
+                store_update(rs485, &enable);
+        }
+
+        (void)printf(
+            "RS-485 %s, %s after reboot\r\n", rs485_enabled() ? "on" : "off",
+            store_get(rs485) ? "on" : "off"
+        );
+
+        return 0;
+}
+#endif /* RS485_ENABLE */
+
+static int node_id_(int argc, char** argv)
+{
+        if (argc >= 2) {
+                int node = atoi(argv[1]);
+
+                if (node < 1 || node > RS485_NODE_MAX) {
+                        (void)printf(
+                            "Invalid node ID %i, valid range is 1-%i\r\n",
+                            node, RS485_NODE_MAX
+                        );
+
+                        return -E_INVAL;
+                }
+
+                uint8_t id = node;
+                store_update(node_id, &id);
+        }
+
+        (void)printf("%i\r\n", (int)store_get(node_id));
+
+        return 0;
+}
+
+/**
+ * @brief Parse the optional sensor slot argument at @p argv[ @p index ]
+ *
+ * @return int Sensor slot, or -E_INVAL if invalid
+ */
+static int sensor_arg_(int argc, char** argv, int index)
+{
+        int sensor = argc > index ? atoi(argv[index]) : 0;
+
+        if (sensor < 0 || sensor >= ZONE_SENSORS) {
+                (void)printf(
+                    "Invalid sensor %i, valid range is 0-%i\r\n", sensor,
+                    ZONE_SENSORS - 1
+                );
+
+                return -E_INVAL;
+        }
+
+        return sensor;
+}
+
 static int i2c_temp_addr_set_(int argc, char** argv)
 {
         if (argc < 2) {
@@ -61,40 +173,438 @@ static int i2c_temp_addr_set_(int argc, char** argv)
                 return E_INVAL;
         }
 
-        uint8_t addr = atoi(argv[1]);
-        store_update(i2c_temp_addr, &addr);
+        int sensor = sensor_arg_(argc, argv, 2);
+        if (sensor < 0) {
+                return sensor;
+        }
+
+        uint8_t addrs[ZONE_SENSORS];
+        store_read(temp_addr, &addrs);
 
-        (void)printf("I2C temp slave address set to %i\r\n", (int)addr);
+        addrs[sensor] = atoi(argv[1]);
+        store_update(temp_addr, &addrs);
+
+        (void)printf(
+            "I2C temp slave address %i set to %i\r\n", sensor,
+            (int)addrs[sensor]
+        );
 
         return 0;
 }
 
 static int i2c_temp_addr_get_(int argc, char** argv)
 {
-        (void)printf("%i\r\n", (int)store_get(i2c_temp_addr));
+        int sensor = sensor_arg_(argc, argv, 1);
+        if (sensor < 0) {
+                return sensor;
+        }
+
+        (void)printf("%i\r\n", (int)store_get(temp_addr)[sensor]);
         return 0;
 }
 
+static int i2cbench_(int argc, char** argv)
+{
+        struct i2cbench_result r;
+
+        if (argc < 4) {
+                (void)printf("Expected 4 arguments, got %i\r\n", argc);
+                return E_INVAL;
+        }
+
+        int bytes = atoi(argv[2]);
+        if (bytes < 0 || bytes > I2CBENCH_MAX_BYTES) {
+                (void)printf(
+                    "Invalid size %i, valid range is 0-%i\r\n", bytes,
+                    I2CBENCH_MAX_BYTES
+                );
+
+                return -E_INVAL;
+        }
+
+        long iterations = atol(argv[3]);
+        if (iterations < 1 || iterations > UINT16_MAX) {
+                (void)printf(
+                    "Invalid iterations %li, valid range is 1-%u\r\n",
+                    iterations, (unsigned int)UINT16_MAX
+                );
+
+                return -E_INVAL;
+        }
+
+        (void)i2cbench_run(&ZONE_TWI, atoi(argv[1]), bytes, iterations, &r);
+
+        uint32_t elapsed = r.elapsed_us ? r.elapsed_us : 1;
+
+        (void)printf(
+            "%u of %u transfers done in %lu us\r\n", (unsigned int)r.ok,
+            (unsigned int)iterations, (unsigned long)r.elapsed_us
+        );
+        (void)printf(
+            "\t%lu transfers/s, %lu bytes/s\r\n",
+            (unsigned long)((uint64_t)r.ok * 1000000UL / elapsed),
+            (unsigned long)((uint64_t)r.ok * bytes * 1000000UL / elapsed)
+        );
+        (void)printf(
+            "\tlatency min/avg/max %lu/%lu/%lu us\r\n",
+            (unsigned long)r.lat_min,
+            (unsigned long)(r.ok ? r.lat_total / r.ok : 0),
+            (unsigned long)r.lat_max
+        );
+        (void)printf(
+            "\tENODEV %u, EBUSY %u, EIO %u\r\n", (unsigned int)r.nodev,
+            (unsigned int)r.busy, (unsigned int)r.io
+        );
+
+        return 0;
+}
+
+static int alert_rpm_delta_set_(int argc, char** argv)
+{
+        if (argc < 2) {
+                (void)printf("Expected 2 arguments, got %i\r\n", argc);
+                return E_INVAL;
+        }
+
+        uint16_t delta = atoi(argv[1]);
+        store_update(alert_rpm_delta, &delta);
+
+        (void)printf("Alert RPM delta set to %u\r\n", (unsigned int)delta);
+
+        return 0;
+}
+
+static int alert_temp_set_(int argc, char** argv)
+{
+        if (argc < 2) {
+                (void)printf("Expected 2 arguments, got %i\r\n", argc);
+                return E_INVAL;
+        }
+
+        int32_t threshold = atol(argv[1]);
+        store_update(alert_temp_threshold, &threshold);
+
+        (void)printf("Alert temperature set to %limC\r\n", (long)threshold);
+
+        return 0;
+}
+
+static int alert_(int argc, char** argv)
+{
+        uint16_t fans;
+        uint8_t events;
+
+        if (argc >= 2 && strcmp(argv[1], "clear") == 0) {
+                events = alert_take(&fans);
+        } else {
+                events = alert_pending(&fans);
+        }
+
+        (void)printf(
+            "Pending:%s%s%s fans=0x%04x\r\n",
+            (events & ALERT_FAULT) ? " fault" : "",
+            (events & ALERT_TEMP) ? " temp" : "",
+            (events & ALERT_RPM) ? " rpm" : "", (unsigned int)fans
+        );
+        (void)printf(
+            "RPM delta: %u, temperature: %limC\r\n",
+            (unsigned int)store_get(alert_rpm_delta),
+            (long)store_get(alert_temp_threshold)
+        );
+
+        return 0;
+}
+
+/**
+ * @brief Print @p age, which is either a time in ms or UINT32_MAX
+ */
+static void print_age_(uint32_t age)
+{
+        if (age == UINT32_MAX) {
+                (void)printf(" (never read)\r\n");
+        } else {
+                (void)printf(" (%lums ago)\r\n", (unsigned long)age);
+        }
+}
+
 static int temp_(int argc, char** argv)
 {
         (void)argc;
         (void)argv;
 
-        uint32_t t = 0;
-        ptrdiff_t status =
-            i2c_master_recv(store_get(i2c_temp_addr), (uint8_t*)&t, sizeof(t));
-        if (status != sizeof(t)) {
-                return status < 0 ? -status : E_IO;
+        for (uint8_t i = 0; i < ZONE_COUNT; i++) {
+                int32_t t;
+
+                if (store_get(zones)[i].sensors == 0) {
+                        continue;
+                }
+
+                if (zone_get(i, &t) != 0) {
+                        (void)printf("Zone %i: no data\r\n", (int)i);
+                        continue;
+                }
+
+                (void)printf("Zone %i: %limC", (int)i, (long)t);
+                print_age_(zone_age(i));
+        }
+
+        return 0;
+}
+
+static int temps_(int argc, char** argv)
+{
+        int sensor = sensor_arg_(argc, argv, 1);
+        if (sensor < 0) {
+                return sensor;
+        }
+
+        const struct zone_sensor* s = zone_sensor(sensor);
+
+        (void)printf(
+            "Sensor %i, sequence %lu, errors %u", sensor, (unsigned long)s->seq,
+            (unsigned int)s->errors
+        );
+        print_age_(zone_sensor_age(sensor));
+
+        for (uint8_t i = 0; i < ZONE_CHANNELS; i++) {
+                (void)printf(
+                    "Channel %i: %limC\r\n", (int)i, (long)s->temp[i]
+                );
+        }
+
+        return 0;
+}
+
+static int boot_(int argc, char** argv)
+{
+        uint32_t us = (uint64_t)fan_boot_ticks() * 1000000 / CLOCK_HZ;
+
+        (void)printf(
+            "Fans at saved profile %luus after clock start\r\n",
+            (unsigned long)us
+        );
+
+        return 0;
+}
+
+static int fancal_(int argc, char** argv)
+{
+        uint8_t step;
+
+        if (argc >= 2) {
+                if (strcmp(argv[1], "start") == 0) {
+                        return fan_cal_start();
+                } else if (strcmp(argv[1], "abort") == 0) {
+                        fan_cal_abort();
+                } else if (strcmp(argv[1], "clear") == 0) {
+                        fan_cal_clear();
+                } else {
+                        (void)printf("Invalid argument %s\r\n", argv[1]);
+                        return -E_INVAL;
+                }
+
+                return 0;
+        }
+
+        if (fan_cal_running(&step)) {
+                (void)printf(
+                    "Calibrating, step %i of %i\r\n",
+                    (int)(FAN_CURVE_POINTS - step), (int)FAN_CURVE_POINTS
+                );
+        }
+
+        for (uint8_t i = 0; i < FAN_COUNT; i++) {
+                const uint8_t* curve = fan_curve(i);
+
+                (void)printf("Fan %i:", (int)i);
+
+                if (curve == NULL) {
+                        (void)printf(" not calibrated\r\n");
+                        continue;
+                }
+
+                for (uint8_t j = 0; j < FAN_CURVE_POINTS; j++) {
+                        (void)printf(
+                            " %u", (unsigned int)curve[j] * FAN_CURVE_UNIT
+                        );
+                }
+
+                (void)printf(" RPM\r\n");
+        }
+
+        return 0;
+}
+
+static int log_(int argc, char** argv)
+{
+        struct evlog_entry e;
+        uint16_t dropped = evlog_take_dropped();
+
+        if (dropped != 0) {
+                (void)printf("%u events dropped\r\n", (unsigned int)dropped);
         }
 
-        (void)printf("Temperature: %imC\r\n", (int)t);
+        while (evlog_take(&e) == 0) {
+                if (argc >= 2 && strcmp(argv[1], "clear") == 0) {
+                        continue;
+                }
+
+                (void)printf(
+                    "%lums %s %s %u %u", (unsigned long)e.stamp,
+                    evlog_sys_name(e.sys), evlog_code_name(e.code),
+                    (unsigned int)e.a, (unsigned int)e.b
+                );
+
+                if (e.repeats != 0) {
+                        (void)printf(" (repeated %u)", (unsigned int)e.repeats);
+                }
+
+                (void)printf("\r\n");
+        }
+
+        return 0;
+}
+
+static int irqlat_(int argc, char** argv)
+{
+        struct fan_irq_latency lat;
+
+        if (argc >= 2 && strcmp(argv[1], "reset") == 0) {
+                fan_irq_latency_reset();
+                return 0;
+        }
+
+        fan_irq_latency(&lat);
+
+        (void)printf(
+            "Captures %lu, max %u cycles\r\n\thist:",
+            (unsigned long)lat.count, (unsigned int)lat.peak
+        );
+
+        for (uint8_t i = 0; i < FAN_IRQ_BUCKETS; i++) {
+                (void)printf(" %u", (unsigned int)lat.hist[i]);
+        }
+
+        (void)printf("\r\n");
+
+        return 0;
+}
+
+/* Bytes of history printed by one history command */
+#define HISTORY_DUMP_ (128)
+
+static int history_(int argc, char** argv)
+{
+        uint32_t start, end;
+        uint32_t offset = argc >= 2 ? strtoul(argv[1], NULL, 0) : 0;
+        uint8_t buf[16];
+        size_t len;
+
+        history_range(&start, &end);
+        (void)printf(
+            "History %lu-%lu\r\n", (unsigned long)start, (unsigned long)end
+        );
+
+        for (size_t total = 0; total < HISTORY_DUMP_; total += len) {
+                len = history_read(&offset, buf, sizeof(buf));
+                if (len == 0) {
+                        break;
+                }
+
+                (void)printf("%08lx:", (unsigned long)offset);
+
+                for (size_t i = 0; i < len; i++) {
+                        (void)printf(" %02x", (unsigned int)buf[i]);
+                }
+
+                (void)printf("\r\n");
+                offset += len;
+        }
+
+        (void)printf("Next %lu\r\n", (unsigned long)offset);
+
+        return 0;
+}
+
+static int history_interval_(int argc, char** argv)
+{
+        if (argc >= 2) {
+                int interval = atoi(argv[1]);
+
+                if (interval < 0 || interval > UINT8_MAX) {
+                        return E_INVAL;
+                }
+
+                uint8_t value = interval;
+                store_update(history_interval, &value);
+        }
+
+        (void)printf(
+            "History interval %us\r\n",
+            (unsigned int)store_get(history_interval)
+        );
+
+        return 0;
+}
+
+static int zone_(int argc, char** argv)
+{
+        if (argc < 2) {
+                for (uint8_t i = 0; i < ZONE_COUNT; i++) {
+                        const struct zone_cfg* cfg = &store_get(zones)[i];
+
+                        (void)printf(
+                            "Zone %i: %s sensors=0x%02x channels=0x%02x\r\n",
+                            (int)i, cfg->rule == ZONE_RULE_AVG ? "avg" : "max",
+                            (unsigned int)cfg->sensors,
+                            (unsigned int)cfg->channels
+                        );
+                }
+
+                return 0;
+        }
+
+        if (argc < 5) {
+                (void)printf("Expected 5 arguments, got %i\r\n", argc);
+                return -E_INVAL;
+        }
+
+        uint8_t index = atoi(argv[1]);
+        if (index >= ZONE_COUNT) {
+                (void)printf(
+                    "Invalid zone %i, valid range is 0-%i\r\n", (int)index,
+                    ZONE_COUNT - 1
+                );
+
+                return -E_INVAL;
+        }
+
+        struct zone_cfg zones[ZONE_COUNT];
+        store_read(zones, &zones);
+
+        if (strcmp(argv[2], "max") == 0) {
+                zones[index].rule = ZONE_RULE_MAX;
+        } else if (strcmp(argv[2], "avg") == 0) {
+                zones[index].rule = ZONE_RULE_AVG;
+        } else {
+                (void)printf("Invalid rule\r\n");
+                return -E_INVAL;
+        }
+
+        zones[index].sensors = strtoul(argv[3], NULL, 0);
+        zones[index].channels = strtoul(argv[4], NULL, 0);
+
+        store_update(zones, &zones);
 
         return 0;
 }
 
 static int fan_invalid_(uint8_t index)
 {
-        (void)printf("Invalid fan %i, valid range is 0-7\r\n", (int)index);
+        (void)printf(
+            "Invalid fan %i, valid range is 0-%i\r\n", (int)index,
+            FAN_COUNT - 1
+        );
 
         return -E_INVAL;
 }
@@ -115,7 +625,7 @@ static int fanctrl_(int argc, char** argv)
 
                 return -E_INVAL;
         }
-        if (index >= 8) {
+        if (index >= FAN_COUNT) {
                 return fan_invalid_(index);
         }
 
@@ -124,10 +634,17 @@ static int fanctrl_(int argc, char** argv)
         return 0;
 }
 
+static int fansave_(int argc, char** argv)
+{
+        fan_save_profiles();
+
+        return 0;
+}
+
 static int fancheck_(int argc, char** argv)
 {
         if (argc < 2) {
-                for (uint8_t i = 0; i < 8; i++) {
+                for (uint8_t i = 0; i < FAN_COUNT; i++) {
                         fan_check_speed(i);
                 }
 
@@ -135,7 +652,7 @@ static int fancheck_(int argc, char** argv)
         }
 
         uint8_t index = atoi(argv[1]);
-        if (index >= 8) {
+        if (index >= FAN_COUNT) {
                 return fan_invalid_(index);
         }
 
@@ -144,6 +661,130 @@ static int fancheck_(int argc, char** argv)
         return 0;
 }
 
+static int fanzone_(int argc, char** argv)
+{
+        if (argc < 2) {
+                for (uint8_t i = 0; i < FAN_COUNT; i++) {
+                        (void)printf(
+                            "Fan %i: zone %i\r\n", (int)i,
+                            (int)store_get(fan_zone)[i]
+                        );
+                }
+
+                return 0;
+        }
+
+        if (argc < 3) {
+                (void)printf("Expected 3 arguments, got %i\r\n", argc);
+                return -E_INVAL;
+        }
+
+        uint8_t index = atoi(argv[1]);
+        uint8_t zone = atoi(argv[2]);
+
+        if (index >= FAN_COUNT) {
+                return fan_invalid_(index);
+        }
+        if (zone >= ZONE_COUNT) {
+                (void)printf("Invalid zone %i\r\n", (int)zone);
+                return -E_INVAL;
+        }
+
+        uint8_t fan_zone[FAN_COUNT];
+        store_read(fan_zone, &fan_zone);
+
+        fan_zone[index] = zone;
+        store_update(fan_zone, &fan_zone);
+
+        return 0;
+}
+
+static void fanfault_one_(uint8_t index)
+{
+        uint8_t faults = fault_get(index);
+        const struct fault_counters* c = fault_counters(index);
+
+        (void)printf(
+            "Fan %i: %s%s%s stalls=%u underspeeds=%u recoveries=%u\r\n",
+            (int)index, faults == 0 ? "ok" : "",
+            (faults & FAULT_STALL) ? "stall " : "",
+            (faults & FAULT_UNDERSPEED) ? "underspeed" : "",
+            (unsigned int)c->stalls, (unsigned int)c->underspeeds,
+            (unsigned int)c->recoveries
+        );
+}
+
+static int fanfault_(int argc, char** argv)
+{
+        if (argc < 2) {
+                for (uint8_t i = 0; i < FAN_COUNT; i++) {
+                        fanfault_one_(i);
+                }
+
+                return 0;
+        }
+
+        if (strcmp(argv[1], "reset") == 0) {
+                fault_reset_counters();
+                return 0;
+        }
+
+        uint8_t index = atoi(argv[1]);
+        if (index >= FAN_COUNT) {
+                return fan_invalid_(index);
+        }
+
+        fanfault_one_(index);
+
+        return 0;
+}
+
+static void fanstats_one_(uint8_t index)
+{
+        struct fanstats s;
+        fanstats_get(index, &s);
+
+        (void)printf(
+            "Fan %i: min=%u max=%u mean=%u var=%lu captures=%lu stalls=%u "
+            "rotation=%lums\r\n\thist:",
+            (int)index, (unsigned int)s.min, (unsigned int)s.max,
+            (unsigned int)s.mean, (unsigned long)s.variance,
+            (unsigned long)s.captures, (unsigned int)s.stalls,
+            (unsigned long)s.rotation_ms
+        );
+
+        for (uint8_t i = 0; i < FANSTATS_BUCKETS; i++) {
+                (void)printf(" %u", (unsigned int)s.hist[i]);
+        }
+
+        (void)printf("\r\n");
+}
+
+static int fanstats_(int argc, char** argv)
+{
+        if (argc < 2) {
+                for (uint8_t i = 0; i < FAN_COUNT; i++) {
+                        fanstats_one_(i);
+                }
+
+                return 0;
+        }
+
+        if (strcmp(argv[1], "reset") == 0) {
+                fanstats_reset();
+                return 0;
+        }
+
+        uint8_t index = atoi(argv[1]);
+        if (index >= FAN_COUNT) {
+                return fan_invalid_(index);
+        }
+
+        fanstats_one_(index);
+
+        return 0;
+}
+
 static void fanspeed_one_(uint8_t index)
 {
         uint16_t speed = fan_get_speed(index);
@@ -154,7 +795,7 @@ static void fanspeed_one_(uint8_t index)
 static int fanspeed_(int argc, char** argv)
 {
         if (argc < 2) {
-                for (uint8_t i = 0; i < 8; i++) {
+                for (uint8_t i = 0; i < FAN_COUNT; i++) {
                         fanspeed_one_(i);
                 }
 
@@ -162,7 +803,7 @@ static int fanspeed_(int argc, char** argv)
         }
 
         uint8_t index = atoi(argv[1]);
-        if (index >= 8) {
+        if (index >= FAN_COUNT) {
                 return fan_invalid_(index);
         }
 
@@ -171,11 +812,71 @@ static int fanspeed_(int argc, char** argv)
         return 0;
 }
 
+#ifdef PERF_ENABLE
+static int perf_(int argc, char** argv)
+{
+        (void)argc;
+        (void)argv;
+
+        (void)printf("Probe - count min/avg/max cycles\r\n");
+
+        for (uint8_t i = 0; i < PERF_PROBES; i++) {
+                struct perf_entry e;
+                perf_take(i, &e);
+
+                (void)printf(
+                    "\t%s - %lu %u/%lu/%u\r\n", perf_name(i),
+                    (unsigned long)e.count, (unsigned int)e.min,
+                    (unsigned long)(e.count ? e.total / e.count : 0),
+                    (unsigned int)e.max
+                );
+
+                if (i == PERF_LOOP && e.total > 0) {
+                        (void)printf(
+                            "\tloop frequency - %lu Hz\r\n",
+                            (unsigned long)((uint64_t)F_CPU * e.count /
+                                            e.total)
+                        );
+                }
+        }
+
+        return 0;
+}
+#endif /* PERF_ENABLE */
+
+#ifdef TRACE_ENABLE
+static int trace_(int argc, char** argv)
+{
+        struct trace_record r;
+
+        if (argc >= 2 && strcmp(argv[1], "start") == 0) {
+                trace_start();
+                return 0;
+        }
+
+        trace_stop();
+
+        (void)printf("Trace - %lu lost\r\n", (unsigned long)trace_lost());
+
+        for (uint16_t i = 0; trace_get(i, &r) == 0; i++) {
+                (void)printf(
+                    "%lu %u %u %u\r\n", (unsigned long)r.stamp,
+                    (unsigned int)r.type, (unsigned int)r.a,
+                    (unsigned int)r.b
+                );
+        }
+
+        return 0;
+}
+#endif /* TRACE_ENABLE */
+
 static int reboot_(int argc, char** argv)
 {
         (void)argc;
         (void)argv;
 
+        store_flush();
+
         RSTCTRL.SWRR = RSTCTRL_SWRST_bm;
         return 0;
 }
@@ -201,30 +902,145 @@ static struct {
         "Get I2C slave address",
         "",
     },
+    {
+        "i2c_gcall",
+        i2c_gcall_,
+        "Accept broadcast commands sent to the general call address, or\r\n\t\t"
+        "show whether they are accepted",
+        "[on|off]",
+    },
+#ifdef RS485_ENABLE
+    {
+        "rs485",
+        rs485_,
+        "Run the console on a shared RS-485 bus from the next boot,\r\n\t\t"
+        "answering only lines prefixed with \"@<node id> \", or show\r\n\t\t"
+        "whether it does",
+        "[on|off]",
+    },
+#endif /* RS485_ENABLE */
+    {
+        "node_id",
+        node_id_,
+        "Set or get the address of the board on the RS-485 bus",
+        "[<id>]",
+    },
     {
         "i2c_temp_addr_set",
         i2c_temp_addr_set_,
-        "Set I2C temperature slave address",
-        "<address>",
+        "Set I2C address of temperature sensor slot (default 0).\r\n\t\t"
+        "Address 0 disables the slot.",
+        "<address> [<sensor>]",
     },
     {
         "i2c_temp_addr_get",
         i2c_temp_addr_get_,
-        "Get I2C temperature slave address",
-        "<address>",
+        "Get I2C address of temperature sensor slot (default 0)",
+        "[<sensor>]",
+    },
+    {
+        "i2cbench",
+        i2cbench_,
+        "Time back-to-back reads of size bytes from a device on the\r\n\t\t"
+        "sensor bus. Size 0 only sends the address. Fans are not\r\n\t\t"
+        "monitored while this runs.",
+        "<address> <size> <iterations>",
+    },
+    {
+        "alert",
+        alert_,
+        "Show pending alert events and alert settings.\r\n\t\t"
+        "\"clear\" clears the events and releases the alert line.",
+        "[clear]",
+    },
+    {
+        "alert_rpm_delta_set",
+        alert_rpm_delta_set_,
+        "Set RPM change that raises an alert, 0 to disable",
+        "<rpm>",
+    },
+    {
+        "alert_temp_set",
+        alert_temp_set_,
+        "Set temperature threshold that raises an alert (in mC)",
+        "<temperature>",
     },
     {
         "temp",
         temp_,
-        "Get temperature (in mC)",
+        "Get temperature of each zone (in mC)",
         "",
     },
+    {
+        "temps",
+        temps_,
+        "Get last reading of every channel of a sensor (in mC)",
+        "[<sensor>]",
+    },
+    {
+        "zone",
+        zone_,
+        "Configure zone, or show all zones.\r\n\t\t"
+        "Masks select the sensor slots and channels used.",
+        "[<zone> <max|avg> <sensor_mask> <channel_mask>]",
+    },
+    {
+        "boot",
+        boot_,
+        "Show time from clock start until every fan ran at its saved profile",
+        "",
+    },
+    {
+        "log",
+        log_,
+        "Print and empty the event log, or only empty it",
+        "[clear]",
+    },
+    {
+        "fancal",
+        fancal_,
+        "Show the calibrated speed of each fan at every PWM step, or\r\n\t\t"
+        "sweep all fans to calibrate them, abort it, or clear the curves.",
+        "[start|abort|clear]",
+    },
+    {
+        "irqlat",
+        irqlat_,
+        "Show cycles from tacho capture to interrupt service, as a\r\n\t\t"
+        "histogram from <32 doubling to >=2048. \"reset\" clears it.",
+        "[reset]",
+    },
+    {
+        "history",
+        history_,
+        "Dump recorded history from offset (default oldest).\r\n\t\t"
+        "Repeat with the printed offset to continue.",
+        "[<offset>]",
+    },
+    {
+        "history_interval",
+        history_interval_,
+        "Set seconds between history samples (0 disables), or show it",
+        "[<seconds>]",
+    },
+    {
+        "fanzone",
+        fanzone_,
+        "Assign fan to zone, or show all assignments",
+        "[<fan_index> <zone>]",
+    },
     {
         "fanctrl",
         fanctrl_,
         "Set speed of fan",
         "<fan_index> <off|low|medium|max>",
     },
+    {
+        "fansave",
+        fansave_,
+        "Save the current setting of every fan, to be restored at boot",
+        "",
+    },
     {
         "fancheck",
         fancheck_,
@@ -233,6 +1049,20 @@ static struct {
         "If no index is supplied, all fans will be checked",
         "[<fan_index>]",
     },
+    {
+        "fanfault",
+        fanfault_,
+        "Show fault state and counters of fan.\r\n\t\tIf no index is "
+        "supplied, all fans will be shown. \"reset\" clears the counters.",
+        "[<fan_index>|reset]",
+    },
+    {
+        "fanstats",
+        fanstats_,
+        "Show speed statistics of fan.\r\n\t\tIf no index is supplied, "
+        "all fans will be shown. \"reset\" clears all statistics.",
+        "[<fan_index>|reset]",
+    },
     {
         "fanspeed",
         fanspeed_,
@@ -240,6 +1070,23 @@ static struct {
         "printed.",
         "[<fan_index>]",
     },
+#ifdef PERF_ENABLE
+    {
+        "perf",
+        perf_,
+        "Show and reset cycle counts of the main loop and interrupts",
+        "",
+    },
+#endif /* PERF_ENABLE */
+#ifdef TRACE_ENABLE
+    {
+        "trace",
+        trace_,
+        "Stop recording inputs and print the trace.\r\n\t\t\"start\" "
+        "clears the trace and records again.",
+        "[start]",
+    },
+#endif /* TRACE_ENABLE */
     {
         "reboot",
         reboot_,
@@ -273,14 +1120,15 @@ static void flush_incoming_(void)
         }
 }
 
-static int parse_args_(void)
+static int parse_args_(char* line)
 {
         int len = 0;
-        char* tok = strtok(sh_buf_.tmpbuf, " ");
+        char* tok = strtok(line, " ");
 
         sh_buf_.args[0] = tok;
 
-        for (; tok != NULL && len < ARR_LEN_(sh_buf_.args);) {
+        /* Tokens that do not fit are ignored */
+        for (; tok != NULL && len + 1 < ARR_LEN_(sh_buf_.args);) {
                 tok = strtok(NULL, " ");
                 sh_buf_.args[++len] = tok;
         }
@@ -299,11 +1147,90 @@ static int process_cmd_(int argc)
         return -E_NOENT;
 }
 
+/**
+ * @brief Run the command line @p line
+ */
+static void run_line_(char* line)
+{
+        int argc = parse_args_(line);
+
+        if (sh_buf_.args[0] == NULL) {
+                return;
+        }
+
+        int ret = process_cmd_(argc);
+
+        if (ret != 0) {
+                (void)printf(
+                    "%s: %s\r\n", sh_buf_.args[0], e_str(ret < 0 ? -ret : ret)
+                );
+        }
+}
+
+/**
+ * @brief Handle byte @p c in RS-485 mode. The bus also carries the replies of
+ * other boards, so binary frames are followed through their length and only
+ * a complete status query is answered, and a text line always starts over at
+ * its address. Anything outside of a line is dropped.
+ *
+ * @param c
+ * @return bool Whether @p c was taken, and is not part of a line
+ */
+static bool take_rs485_(char c)
+{
+        if (!rs485_enabled()) {
+                return false;
+        }
+
+        /* A frame only starts at the boundary of the previous one */
+        if (sh_buf_.frame == 0) {
+                if (c == RS485_QUERY) {
+                        sh_buf_.frame_size = RS485_QUERY_SIZE;
+                } else if (c == RS485_REPLY) {
+                        /* Known once the length byte is in */
+                        sh_buf_.frame_size = UINT16_MAX;
+                } else if (c == RS485_ADDR) {
+                        sh_buf_.tmpbuf[0] = c;
+                        sh_buf_.tmpidx = 0;
+
+                        return false;
+                } else {
+                        return sh_buf_.tmpidx == 0;
+                }
+
+                sh_buf_.tmpidx = 0;
+        }
+
+        if (sh_buf_.frame < sizeof(sh_buf_.query)) {
+                sh_buf_.query[sh_buf_.frame] = c;
+        }
+
+        /* A reply goes on with its node ID and the length of the payload,
+         * which is followed by a CRC */
+        if (sh_buf_.query[0] == RS485_REPLY && sh_buf_.frame == 2) {
+                sh_buf_.frame_size = sh_buf_.frame + 1 + (uint8_t)c + 1;
+        }
+
+        if (++sh_buf_.frame == sh_buf_.frame_size) {
+                sh_buf_.frame = 0;
+
+                if (sh_buf_.query[0] == RS485_QUERY) {
+                        (void)rs485_query(sh_buf_.query);
+                }
+        }
+
+        return true;
+}
+
 void shell_tick(void)
 {
         while (usart_read(sh_buf_.tmpbuf + sh_buf_.tmpidx, 1) > 0) {
                 char c = sh_buf_.tmpbuf[sh_buf_.tmpidx];
 
+                if (take_rs485_(c)) {
+                        continue;
+                }
+
                 if (c == DEL_CHAR_) {
                         if (sh_buf_.tmpidx > 0) {
                                 sh_buf_.tmpidx--;
@@ -312,33 +1239,41 @@ void shell_tick(void)
                         sh_buf_.tmpidx++;
                 }
 
-                /* Data too long, unable to process it */
+                /* Data too long, unable to process it. On a shared bus the
+                 * rest of the line is dropped as it arrives instead, so that
+                 * a query queued behind it is not lost. */
                 if (sh_buf_.tmpidx >= sizeof(sh_buf_.tmpbuf)) {
-                        flush_incoming_();
+                        if (!rs485_enabled()) {
+                                flush_incoming_();
+                        }
                         sh_buf_.tmpidx = 0;
 
                         break;
                 }
 
                 if (c == TERM_CHAR_) {
-                        /* Echo newline */
-                        (void)printf("\r\n");
-
                         sh_buf_.tmpbuf[sh_buf_.tmpidx - 1] = 0;
+                        sh_buf_.tmpidx = 0;
 
-                        int argc = parse_args_();
-                        int ret = process_cmd_(argc);
+                        if (!rs485_enabled()) {
+                                /* Echo newline */
+                                (void)printf("\r\n");
 
-                        if (ret != 0) {
-                                (void)printf(
-                                    "%s: %s\r\n", sh_buf_.args[0],
-                                    e_str(ret < 0 ? -ret : ret)
-                                );
+                                run_line_(sh_buf_.tmpbuf);
+                                break;
+                        }
+
+                        /* On a shared bus only lines addressed to this board
+                         * are answered, and the end of the reply is marked */
+                        char* line = rs485_match(sh_buf_.tmpbuf);
+
+                        if (line != NULL) {
+                                run_line_(line);
+                                rs485_end_reply();
                         }
 
-                        sh_buf_.tmpidx = 0;
                         break;
-                } else {
+                } else if (!rs485_enabled()) {
                         /* Echo entered characters */
                         (void)printf("%c", c);
                 }
@@ -1,16 +1,54 @@
 
+#include <stdbool.h>
 #include <string.h>
 
 #include <avr/eeprom.h>
+#include <avr/interrupt.h>
+#include <avr/io.h>
 
 #include "store.h"
 
+/* Written to the first byte of the EEPROM once the store has been saved. This
+ * must be bumped whenever the layout of `struct store` changes, so that data
+ * saved by an older firmware is not loaded into the wrong fields. */
+#define STORE_VERSION_ (0x8)
+
 static struct store store_ = {
     /* Default values, will be overwritten */
     .i2c_slave_addr = 9,
-    .i2c_temp_addr = 5,
+    .temp_addr = {5},
+    .alert_rpm_delta = 500,
+    .alert_temp_threshold = 60000,
+    .zones =
+        {
+            [0] = {.sensors = 0x1, .channels = 0x1, .rule = ZONE_RULE_MAX},
+        },
+    .history_interval = 5,
+    /* All fans start at low */
+    .fan_profile =
+        {
+            [0 ... FAN_COUNT - 1] = {.mode = FAN_MODE_DUTY, .duty = 40},
+        },
+    .node_id = 1,
 };
 
+/**
+ * @brief Range of bytes in the store that have been updated in RAM, but not yet
+ * committed to EEPROM. The range is [lo, hi), and is empty when lo == hi.
+ *
+ * These are modified from the NVMCTRL interrupt, so any access outside of it
+ * must be done with interrupts disabled.
+ */
+static volatile struct {
+        uint16_t lo;
+        uint16_t hi;
+        bool marker;
+} dirty_;
+
+/* Whether the EEPROM does not hold a store of the current version, in which
+ * case the whole store must be written before the marker is */
+static bool stale_;
+
 /**
  * @brief Get the real address of the field member located @p addr_offset into
  * the store
@@ -31,23 +69,103 @@ void store_init(void)
 {
         uint8_t byte = eeprom_read_byte((void*)EEPROM_START);
 
-        /* If the first byte is not 0x1, then the store has not been saved yet
-         * and we should instead use the default values. */
-        if (byte == 0x1) {
+        /* If the first byte is not the current version, then the store has not
+         * been saved yet (or was saved with a different layout) and we should
+         * instead use the default values. */
+        if (byte == STORE_VERSION_) {
                 void* addr = (void*)(EEPROM_START + 1);
 
                 eeprom_read_block(&store_, addr, sizeof(store_));
+        } else {
+                stale_ = true;
+        }
+}
+
+/**
+ * @brief Commit the next dirty byte of the store to EEPROM. The marker byte is
+ * written last, once all data has been committed. When nothing is left to
+ * write, the EEPROM ready interrupt is disabled.
+ *
+ * NOTE: This must only be called when the EEPROM is ready, or from a context
+ * where waiting for it is acceptable.
+ *
+ * @return bool
+ * @retval true A byte was committed
+ * @retval false The store is clean
+ */
+static bool commit_one_(void)
+{
+        if (dirty_.lo < dirty_.hi) {
+                uint16_t offset = dirty_.lo++;
+
+                eeprom_update_byte(
+                    (void*)(EEPROM_START + 1 + offset),
+                    *(uint8_t*)store_addr_(offset)
+                );
+
+                return true;
+        }
+
+        if (dirty_.marker) {
+                dirty_.marker = false;
+                eeprom_update_byte((void*)EEPROM_START, STORE_VERSION_);
+
+                return true;
         }
+
+        NVMCTRL.INTCTRL &= ~NVMCTRL_EEREADY_bm;
+
+        return false;
+}
+
+/* Fires whenever the EEPROM is ready to accept a new write, so each invocation
+ * commits one byte without ever blocking on the NVM controller. */
+ISR(NVMCTRL_EE_vect)
+{
+        (void)commit_one_();
 }
 
 void store_update__(uint16_t addr_offset, const void* value, size_t size)
 {
         (void)memcpy(store_addr_(addr_offset), value, size);
 
-        void* eeprom_addr = (void*)(EEPROM_START + 1 + addr_offset);
+        uint16_t end = addr_offset + size;
+
+        cli();
+
+        if (stale_) {
+                /* Every other field only holds its default value in RAM */
+                stale_ = false;
+                dirty_.lo = 0;
+                dirty_.hi = sizeof(store_);
+        } else if (dirty_.lo == dirty_.hi) {
+                dirty_.lo = addr_offset;
+                dirty_.hi = end;
+        } else {
+                if (addr_offset < dirty_.lo) {
+                        dirty_.lo = addr_offset;
+                }
+                if (end > dirty_.hi) {
+                        dirty_.hi = end;
+                }
+        }
+
+        dirty_.marker = true;
+        NVMCTRL.INTCTRL |= NVMCTRL_EEREADY_bm;
+
+        sei();
+}
+
+void store_flush(void)
+{
+        /* Take over from the interrupt, and commit the remaining bytes
+         * synchronously */
+        NVMCTRL.INTCTRL &= ~NVMCTRL_EEREADY_bm;
+
+        while (commit_one_()) {
+        }
 
-        eeprom_update_block(value, eeprom_addr, size);
-        eeprom_update_byte((void*)EEPROM_START, 0x1);
+        eeprom_busy_wait();
 }
 
 void store_read__(uint16_t addr_offset, void* buf, size_t size)
@@ -2,9 +2,36 @@
 #ifndef STORE_H__
 #define STORE_H__
 
+#include <stddef.h>
+#include <stdint.h>
+
+#include "fan.h"
+#include "zone.h"
+
 struct store {
         uint8_t i2c_slave_addr;
-        uint8_t i2c_temp_addr;
+        /* Whether commands sent to the general call address are accepted */
+        uint8_t i2c_gcall;
+        /* Addresses of the temperature targets, 0 if the slot is unused */
+        uint8_t temp_addr[ZONE_SENSORS];
+        /* RPM change that raises an alert, 0 to disable */
+        uint16_t alert_rpm_delta;
+        /* Temperature (in mC) that raises an alert when crossed */
+        int32_t alert_temp_threshold;
+        struct zone_cfg zones[ZONE_COUNT];
+        /* Zone each fan is assigned to */
+        uint8_t fan_zone[FAN_COUNT];
+        /* Time between history samples in seconds, 0 to disable */
+        uint8_t history_interval;
+        /* Operating point of each fan, applied at boot */
+        struct fan_profile fan_profile[FAN_COUNT];
+        /* Calibrated speed curve of each fan, see `fan_curve`. A fan whose
+         * last point is 0 has not been calibrated. */
+        uint8_t fan_curve[FAN_COUNT][FAN_CURVE_POINTS];
+        /* Whether the console runs on an RS-485 bus, applied at boot */
+        uint8_t rs485;
+        /* Address of the board on the RS-485 bus, 1-127 */
+        uint8_t node_id;
 };
 
 /**
@@ -16,12 +43,21 @@ void store_init(void);
 /**
  * @brief Update the value of the store field @p value to @p value
  *
+ * The RAM copy is updated immediately, while the EEPROM is written in the
+ * background. See `store_flush` to wait for the write to complete.
+ *
  * @param field
  * @param value
  */
 #define store_update(field, value)                                             \
         store_update__(offsetof(struct store, field), value, sizeof(*value))
 
+/**
+ * @brief Block until all pending store updates have been committed to EEPROM.
+ * This must be called before resetting the MCU, or the update may be lost.
+ */
+void store_flush(void);
+
 /**
  * @brief Read the contents of store field @p field into @p buffer
  *
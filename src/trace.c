@@ -0,0 +1,86 @@
+#include <stdbool.h>
+
+#include <avr/interrupt.h>
+#include <avr/io.h>
+
+#include "clock.h"
+#include "error.h"
+#include "trace.h"
+
+#ifdef TRACE_ENABLE
+
+static struct {
+        struct trace_record records[TRACE_ENTRIES];
+        uint16_t head;
+        uint16_t count;
+        uint32_t lost;
+        bool stopped;
+} trace_;
+
+void trace_add(enum trace_type type, uint8_t a, uint16_t b)
+{
+        uint8_t sreg = SREG;
+
+        /* The capture interrupt may preempt a level 0 handler that is
+         * recording */
+        cli();
+
+        if (trace_.stopped) {
+                SREG = sreg;
+                return;
+        }
+
+        struct trace_record* r =
+            &trace_.records[(trace_.head + trace_.count) % TRACE_ENTRIES];
+
+        if (trace_.count < TRACE_ENTRIES) {
+                trace_.count++;
+        } else {
+                trace_.head = (trace_.head + 1) % TRACE_ENTRIES;
+                trace_.lost++;
+        }
+
+        r->stamp = clock_ticks();
+        r->type = type;
+        r->a = a;
+        r->b = b;
+
+        SREG = sreg;
+}
+
+void trace_stop(void)
+{
+        trace_.stopped = true;
+}
+
+void trace_start(void)
+{
+        uint8_t sreg = SREG;
+
+        cli();
+
+        trace_.head = 0;
+        trace_.count = 0;
+        trace_.lost = 0;
+        trace_.stopped = false;
+
+        SREG = sreg;
+}
+
+int trace_get(uint16_t index, struct trace_record* out)
+{
+        if (index >= trace_.count) {
+                return -E_NODATA;
+        }
+
+        *out = trace_.records[(trace_.head + index) % TRACE_ENTRIES];
+
+        return 0;
+}
+
+uint32_t trace_lost(void)
+{
+        return trace_.lost;
+}
+
+#endif /* TRACE_ENABLE */
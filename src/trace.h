@@ -0,0 +1,83 @@
+/* Recorder of the peripheral input of the firmware, for replay on the host
+ * with sim/replay.c.
+ *
+ * Only compiled in when TRACE_ENABLE is defined. Otherwise `TRACE` expands to
+ * nothing, and no memory is used. Recording starts at reset, and keeps the
+ * latest `TRACE_ENTRIES` records.
+ */
+#ifndef TRACE_H__
+#define TRACE_H__
+
+#include <stdint.h>
+
+/* Number of records held, 8 bytes each */
+#define TRACE_ENTRIES (512)
+
+enum trace_type {
+        /* Tacho capture, a is the fan measured, b is the captured count */
+        TRACE_CAPTURE = 0,
+        /* Slave interrupt of TWI instance b >> 8, a is SSTATUS, and the low
+         * byte of b is the byte received, if any */
+        TRACE_TWI,
+        /* Byte a received on the console USART */
+        TRACE_RX,
+};
+
+struct __attribute__((packed)) trace_record {
+        /* Time of the input, in `clock_ticks` */
+        uint32_t stamp;
+        uint8_t type;
+        uint8_t a;
+        uint16_t b;
+};
+
+#ifdef TRACE_ENABLE
+
+/**
+ * @brief Record an input. This may be called from any interrupt level.
+ *
+ * @param type
+ * @param a
+ * @param b
+ */
+void trace_add(enum trace_type type, uint8_t a, uint16_t b);
+
+/**
+ * @brief Stop recording, so that the trace can be read out without inputs
+ * being added meanwhile
+ */
+void trace_stop(void);
+
+/**
+ * @brief Clear the trace, and start recording again
+ */
+void trace_start(void);
+
+/**
+ * @brief Get record @p index of the trace, oldest first. Only valid while
+ * recording is stopped.
+ *
+ * @param index
+ * @param out
+ * @return int
+ * @retval -ENODATA @p index is past the end of the trace
+ * @retval 0 Success
+ */
+int trace_get(uint16_t index, struct trace_record* out);
+
+/**
+ * @brief Get the number of records overwritten since recording started
+ *
+ * @return uint32_t
+ */
+uint32_t trace_lost(void);
+
+#define TRACE(type, a, b) trace_add(type, a, b)
+
+#else
+
+#define TRACE(type, a, b)
+
+#endif /* TRACE_ENABLE */
+
+#endif /* TRACE_H__ */
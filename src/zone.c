@@ -0,0 +1,196 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "alert.h"
+#include "clock.h"
+#include "drivers/i2c.h"
+#include "error.h"
+#include "evlog.h"
+#include "store.h"
+#include "zone.h"
+
+/* Interval between polls. Sensors are polled one at a time, so each sensor is
+ * read every `ZONE_SENSORS * POLL_MS_` */
+#define POLL_MS_ (250)
+/* Readings older than this are not used */
+#define STALE_MS_ (5000)
+
+/**
+ * @brief Register map of a temperature target
+ */
+struct __attribute__((packed)) regs_ {
+        int32_t temp[ZONE_CHANNELS];
+        uint32_t seq;
+};
+
+static struct zone_sensor sensors_[ZONE_SENSORS];
+
+/**
+ * @brief Read every channel of sensor slot @p sensor in one transaction
+ *
+ * @param sensor
+ */
+static void poll_(uint8_t sensor)
+{
+        uint8_t addr = store_get(temp_addr)[sensor];
+        struct zone_sensor* s = &sensors_[sensor];
+        struct regs_ regs;
+        uint8_t offset = 0;
+
+        if (addr == 0) {
+                /* Slot not in use */
+                s->valid = false;
+                return;
+        }
+
+        ptrdiff_t status = i2c_master_xfer(
+            &ZONE_TWI, addr, &offset, sizeof(offset), (uint8_t*)&regs,
+            sizeof(regs)
+        );
+        if (status != sizeof(regs)) {
+                s->errors++;
+                evlog_add(
+                    EVLOG_SYS_ZONE, EVLOG_ZONE_POLL, sensor,
+                    status < 0 ? -status : E_IO
+                );
+                return;
+        }
+
+        (void)memcpy(s->temp, regs.temp, sizeof(s->temp));
+        s->seq = regs.seq;
+        s->stamp = clock_ms();
+        s->valid = true;
+}
+
+/**
+ * @brief Check the hottest zone against the alert threshold
+ */
+static void check_alert_(void)
+{
+        int32_t hottest = INT32_MIN;
+        bool any = false;
+
+        for (uint8_t i = 0; i < ZONE_COUNT; i++) {
+                int32_t temp;
+
+                if (zone_get(i, &temp) == 0 && temp > hottest) {
+                        hottest = temp;
+                        any = true;
+                }
+        }
+
+        if (any) {
+                alert_temp(hottest);
+        }
+}
+
+void zone_tick(void)
+{
+        static uint32_t last;
+        static uint8_t next;
+
+        uint32_t now = clock_ms();
+        if (now - last < POLL_MS_) {
+                return;
+        }
+
+        last = now;
+
+        poll_(next);
+        next = (next + 1) % ZONE_SENSORS;
+
+        check_alert_();
+}
+
+const struct zone_sensor* zone_sensor(uint8_t sensor)
+{
+        return &sensors_[sensor];
+}
+
+uint32_t zone_sensor_age(uint8_t sensor)
+{
+        if (!sensors_[sensor].valid) {
+                return UINT32_MAX;
+        }
+
+        return clock_ms() - sensors_[sensor].stamp;
+}
+
+/**
+ * @brief Iterate over the fresh channels of zone @p zone, aggregating them
+ *
+ * @param zone
+ * @param temp Aggregated temperature
+ * @param age Age of the oldest reading used
+ * @return int
+ * @retval -E_INVAL Invalid zone
+ * @retval -E_NODATA No fresh readings available for the zone
+ * @retval 0 Success
+ */
+static int aggregate_(uint8_t zone, int32_t* temp, uint32_t* age)
+{
+        if (zone >= ZONE_COUNT) {
+                return -E_INVAL;
+        }
+
+        const struct zone_cfg* cfg = &store_get(zones)[zone];
+        int32_t result = INT32_MIN;
+        int32_t sum = 0;
+        uint8_t count = 0;
+
+        *age = 0;
+
+        for (uint8_t i = 0; i < ZONE_SENSORS; i++) {
+                uint32_t sensor_age = zone_sensor_age(i);
+
+                if (!(cfg->sensors & (1 << i)) || sensor_age > STALE_MS_) {
+                        continue;
+                }
+
+                if (sensor_age > *age) {
+                        *age = sensor_age;
+                }
+
+                for (uint8_t ch = 0; ch < ZONE_CHANNELS; ch++) {
+                        int32_t t = sensors_[i].temp[ch];
+
+                        if (!(cfg->channels & (1 << ch))) {
+                                continue;
+                        }
+
+                        if (t > result) {
+                                result = t;
+                        }
+
+                        sum += t;
+                        count++;
+                }
+        }
+
+        if (count == 0) {
+                return -E_NODATA;
+        }
+
+        *temp = cfg->rule == ZONE_RULE_AVG ? sum / count : result;
+
+        return 0;
+}
+
+int zone_get(uint8_t zone, int32_t* temp)
+{
+        uint32_t age;
+
+        return aggregate_(zone, temp, &age);
+}
+
+uint32_t zone_age(uint8_t zone)
+{
+        int32_t temp;
+        uint32_t age;
+
+        if (aggregate_(zone, &temp, &age) != 0) {
+                return UINT32_MAX;
+        }
+
+        return age;
+}
@@ -0,0 +1,91 @@
+#ifndef ZONE_H__
+#define ZONE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Number of temperature targets that can be polled */
+#define ZONE_SENSORS (4)
+/* Number of channels served by each temperature target */
+#define ZONE_CHANNELS (6)
+/* Number of thermal zones */
+#define ZONE_COUNT (4)
+
+/* TWI instance the temperature targets are polled on. This is kept apart from
+ * the controller bus, so that a blocking poll does not hold up the slave. Set
+ * it to `CMD_TWI` to put the targets on the controller bus instead. */
+#define ZONE_TWI (TWI1)
+
+enum zone_rule {
+        ZONE_RULE_MAX = 0,
+        ZONE_RULE_AVG,
+};
+
+/**
+ * @brief Configuration of a zone, as saved in the store
+ */
+struct zone_cfg {
+        /* Bitmap of sensor slots that belong to the zone */
+        uint8_t sensors;
+        /* Bitmap of the channels to use from each sensor */
+        uint8_t channels;
+        /* One of `enum zone_rule` */
+        uint8_t rule;
+};
+
+/**
+ * @brief Last reading of a temperature target
+ */
+struct zone_sensor {
+        int32_t temp[ZONE_CHANNELS];
+        uint32_t seq;
+        /* Time of the last successful poll, from `clock_ms` */
+        uint32_t stamp;
+        uint16_t errors;
+        bool valid;
+};
+
+/**
+ * @brief Poll the next configured temperature target, if it is time to do so.
+ * This should be called from the main loop.
+ */
+void zone_tick(void);
+
+/**
+ * @brief Get the cached reading of sensor slot @p sensor
+ *
+ * @param sensor
+ * @return const struct zone_sensor*
+ */
+const struct zone_sensor* zone_sensor(uint8_t sensor);
+
+/**
+ * @brief Get the age of the cached reading of sensor slot @p sensor
+ *
+ * @param sensor
+ * @return uint32_t Age in ms, UINT32_MAX if the sensor has never been read
+ */
+uint32_t zone_sensor_age(uint8_t sensor);
+
+/**
+ * @brief Get the temperature of zone @p zone, aggregated from the cached
+ * readings of its sensors. Readings that are too old are ignored.
+ *
+ * @param zone
+ * @param temp Temperature in mC
+ * @return int
+ * @retval -E_INVAL Invalid zone
+ * @retval -E_NODATA No fresh readings available for the zone
+ * @retval 0 Success
+ */
+int zone_get(uint8_t zone, int32_t* temp);
+
+/**
+ * @brief Get the age of the oldest reading used by zone @p zone
+ *
+ * @param zone
+ * @return uint32_t Age in ms, UINT32_MAX if there is no fresh reading
+ */
+uint32_t zone_age(uint8_t zone);
+
+#endif /* ZONE_H__ */